@@ -1,20 +1,24 @@
-from util import get_valid_ciruits, run_circuit, bcolors
+from util import get_valid_ciruits, run_circuit, bcolors, NETWORK_PROFILES
 import csv
 import sys
 
 
 bench_name = sys.argv[1]
+profile = sys.argv[2] if len(sys.argv) > 2 else 'localhost'
+if profile not in NETWORK_PROFILES:
+    sys.exit(f"unknown profile {profile}, expected one of {', '.join(NETWORK_PROFILES)}")
+suffix = '' if profile == 'localhost' else f'-{profile}'
 TRIES = 20
 circuits = get_valid_ciruits('..')
 
-with open(f'{bench_name}-bench.csv', 'w', newline='') as f:
+with open(f'{bench_name}{suffix}-bench.csv', 'w', newline='') as f:
     w = csv.writer(f)
     w.writerow(['case', 'runtime'])
     for c in circuits:
         print(f"{bcolors.OKGREEN}Benchmarking Circuit{bcolors.ENDC}: {bcolors.OKBLUE}{c}{bcolors.ENDC} {bcolors.WARNING}", end='', flush=True)
         timings = []
         for _ in range(TRIES):
-            res = run_circuit(c, '..', bench_name)
+            res = run_circuit(c, '..', bench_name, profile)
             timings.append(res.time)
             print('.',  end='', flush=True)
         print(bcolors.ENDC, end='')
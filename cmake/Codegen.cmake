@@ -0,0 +1,47 @@
+# --------------------------------------------------------------------------------
+#                         Circuit kernels.
+# --------------------------------------------------------------------------------
+# yaos_generate_kernels(<sources variable> <suffix> <circuit file>...)
+#
+# Compile each circuit to a straight-line kernel with yaos_codegen, setting
+# <sources variable> to the generated sources. Each kernel registers itself
+# when its source is linked in.
+function(yaos_generate_kernels sources_var suffix)
+  set(kernel_sources)
+  foreach(circuit IN LISTS ARGN)
+    get_filename_component(circuit_path ${circuit} ABSOLUTE BASE_DIR ${PROJECT_SOURCE_DIR})
+    get_filename_component(circuit_name ${circuit} NAME_WE)
+    string(MAKE_C_IDENTIFIER ${circuit_name} circuit_name)
+    set(kernel_source ${CMAKE_CURRENT_BINARY_DIR}/kernels/${suffix}/${circuit_name}_kernel.cxx)
+    add_custom_command(
+      OUTPUT ${kernel_source}
+      COMMAND ${CMAKE_COMMAND} -E make_directory ${CMAKE_CURRENT_BINARY_DIR}/kernels/${suffix}
+      COMMAND ${CODEGEN_EXEC_NAME} ${circuit_path} ${kernel_source} ${circuit_name}
+      DEPENDS ${CODEGEN_EXEC_NAME} ${circuit_path}
+      COMMENT "Generating circuit kernel for ${circuit}"
+      VERBATIM
+    )
+    list(APPEND kernel_sources ${kernel_source})
+  endforeach()
+  set(${sources_var} ${kernel_sources} PARENT_SCOPE)
+endfunction()
+
+# yaos_specialize(<suffix> <circuit file>...)
+#
+# Build yaos_garbler_<suffix> and yaos_evaluator_<suffix> with kernels for the
+# circuits linked in. The binaries take the same arguments as the generic
+# ones, and fall back to the interpreter for circuits without a kernel.
+function(yaos_specialize suffix)
+  yaos_generate_kernels(kernel_sources ${suffix} ${ARGN})
+  add_executable(${GARBLER_EXEC_NAME}_${suffix} src/cmd/garbler.cxx ${kernel_sources})
+  add_executable(${EVALUATOR_EXEC_NAME}_${suffix} src/cmd/evaluator.cxx ${kernel_sources})
+  foreach(target ${GARBLER_EXEC_NAME}_${suffix} ${EVALUATOR_EXEC_NAME}_${suffix})
+    target_link_libraries(${target} PRIVATE ${LIBRARY_NAME})
+    set_target_properties(${target}
+      PROPERTIES
+        CXX_STANDARD 20
+        CXX_STANDARD_REQUIRED YES
+        CXX_EXTENSIONS YES
+    )
+  endforeach()
+endfunction()
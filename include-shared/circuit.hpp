@@ -1,6 +1,9 @@
 #pragma once
 
+#include <cstdint>
 #include <fstream>
+#include <map>
+#include <memory>
 #include <stdio.h>
 #include <string>
 #include <vector>
@@ -14,27 +17,82 @@
 // ================================================
 
 namespace GateType {
-enum T { AND_GATE = 1, XOR_GATE = 2, NOT_GATE = 3 };
+enum T {
+  AND_GATE = 1,
+  XOR_GATE = 2,
+  NOT_GATE = 3,
+  BRANCH_GATE = 4,
+  LUT_GATE = 5
+};
 };
 
+// BRANCH_GATE and LUT_GATE reuse lhs for their index into the circuit's
+// branches or lookup_tables rather than growing every gate by a field, so lhs
+// is a wire index only for the other types. Branches leave rhs and output
+// unused, and take their wires from the Branch.
 struct Gate {
   GateType::T type;
-  int lhs;    // wire index of lhs
+  int lhs;    // wire index of lhs; for BRANCH_GATE and LUT_GATE, index into
+              // branches and lookup_tables
   int rhs;    // wire index of rhs
   int output; // wire index of output
 };
 
+// A conditional: the evaluator input wires in `selector` (least significant
+// first) pick one of 2^selector.size() sub-circuits, which maps the `inputs`
+// wires to the `outputs` wires. Each sub-circuit has inputs.size() garbler
+// inputs, no evaluator inputs and outputs.size() outputs, and no branches.
+// The selector must be evaluator input: stacking saves material only when the
+// evaluator knows which alternative runs (Kolesnikov's Free IF), so branches
+// on computed or garbler-known wires are rejected rather than garbled.
+struct Circuit;
+struct Branch {
+  std::vector<int> selector;
+  std::vector<int> inputs;
+  std::vector<int> outputs;
+  std::vector<Circuit> circuits;
+};
+
+// An n-input gate given by its truth table: the output for inputs x_i is bit
+// sum(x_i << i) of truth_table, so the first input is least significant.
+struct LookupTable {
+  std::vector<int> inputs;
+  uint64_t truth_table;
+};
+
 struct Circuit {
   int num_gate, num_wire, garbler_input_length, evaluator_input_length,
       output_length;
   std::vector<Gate> gates;
+  std::vector<Branch> branches;
+  std::vector<LookupTable> lookup_tables;
 };
 Circuit parse_circuit(std::string filename);
+uint64_t circuit_fingerprint(const Circuit &circuit);
+
+// One evaluation of a session: a circuit and this party's input to it.
+struct EvaluationJob {
+  std::string circuit_name; // file name of the circuit, without directories
+  std::shared_ptr<const Circuit> circuit;
+  std::vector<int> input;
+};
+std::vector<EvaluationJob> parse_jobs(std::string filename);
 
 // ================================================
 // GARBLED CIRCUIT
 // ================================================
 
+// How AND and NOT gates are garbled; garbler and evaluator must agree.
+// GRR3: row-reduced point-and-permute, 3 entries per AND and 1 per NOT.
+// HALF_GATES: Zahur-Rosulek-Evans half gates, 2 entries per AND, free NOT.
+// CLASSIC: point-and-permute without row reduction, 4 per AND and 2 per NOT.
+// THREE_HALVES: Rosulek-Roy three halves, 1.5 labels and a byte per AND, free
+// NOT.
+// All keep XOR free.
+namespace SchemeType {
+enum T { GRR3 = 1, HALF_GATES = 2, CLASSIC = 3, THREE_HALVES = 4 };
+};
+
 struct GarbledWire {
   CryptoPP::SecByteBlock value;
 };
@@ -43,9 +101,33 @@ struct GarbledGate {
   std::vector<CryptoPP::SecByteBlock> entries;
 };
 
+class PRG;
 struct GarbledLabels {
   std::vector<GarbledWire> zeros;
   std::vector<GarbledWire> ones;
+
+  // Set for labels derived from a seed: zeros then only holds the output
+  // wires, ones is empty, and every other label is re-derived on demand
+  // from this PRG, keyed with the seed once per instance.
+  std::shared_ptr<const PRG> prg;
+  CryptoPP::SecByteBlock delta;
+};
+
+// Every gate's table back to back as a generated kernel writes them: gate i
+// has sizes[i] entries of entry_length bytes. Sent as is, never split into
+// GarbledGates.
+struct PackedTables {
+  size_t entry_length = 0;
+  std::vector<size_t> sizes;
+  std::vector<unsigned char> entries;
+};
+
+class TableStore;
+struct GarbledInstance {
+  GarbledLabels labels;
+  std::vector<GarbledGate> tables;
+  PackedTables packed_tables;                 // instead of tables, if sized
+  std::shared_ptr<TableStore> spilled_tables; // instead of tables, if set
 };
 
 struct GarbledCircuit {
@@ -31,6 +31,14 @@ enum T {
   GarblerToEvaluator_GarblerInputs_Message = 7,
   EvaluatorToGarbler_FinalLabels_Message = 8,
   GarblerToEvaluator_FinalOutput_Message = 9,
+  ReceiverToSender_OTChoiceCorrections_Message = 10,
+  SenderToReceiver_OTMaskedValues_Message = 11,
+  SenderToReceiver_OTPublicValues_Message = 12,
+  ReceiverToSender_OTPublicValues_Message = 13,
+  SenderToReceiver_OTEncryptedValuesBatch_Message = 14,
+  ReceiverToSender_OTExtensionColumns_Message = 15,
+  GarblerToEvaluator_EvaluationHeader_Message = 16,
+  GarblerToEvaluator_GarbledTablesChunk_Message = 17,
 };
 };
 MessageType::T get_message_type(std::vector<unsigned char> &data);
@@ -41,19 +49,21 @@ MessageType::T get_message_type(std::vector<unsigned char> &data);
 
 struct Serializable {
   virtual void serialize(std::vector<unsigned char> &data) = 0;
-  virtual int deserialize(std::vector<unsigned char> &data) = 0;
+  virtual size_t deserialize(std::vector<unsigned char> &data) = 0;
 };
 
 // serializers.
-int put_bool(bool b, std::vector<unsigned char> &data);
-int put_string(std::string s, std::vector<unsigned char> &data);
-int put_integer(CryptoPP::Integer i, std::vector<unsigned char> &data);
+size_t put_bool(bool b, std::vector<unsigned char> &data);
+size_t put_string(std::string s, std::vector<unsigned char> &data);
+size_t put_bytes(const unsigned char *bytes, size_t length,
+                 std::vector<unsigned char> &data);
+size_t put_integer(CryptoPP::Integer i, std::vector<unsigned char> &data);
 
 // deserializers
-int get_bool(bool *b, std::vector<unsigned char> &data, int idx);
-int get_string(std::string *s, std::vector<unsigned char> &data, int idx);
-int get_integer(CryptoPP::Integer *i, std::vector<unsigned char> &data,
-                int idx);
+size_t get_bool(bool *b, std::vector<unsigned char> &data, size_t idx);
+size_t get_string(std::string *s, std::vector<unsigned char> &data, size_t idx);
+size_t get_integer(CryptoPP::Integer *i, std::vector<unsigned char> &data,
+                size_t idx);
 
 // ================================================
 // WRAPPERS
@@ -65,7 +75,7 @@ struct HMACTagged_Wrapper : public Serializable {
   std::string mac;
 
   void serialize(std::vector<unsigned char> &data);
-  int deserialize(std::vector<unsigned char> &data);
+  size_t deserialize(std::vector<unsigned char> &data);
 };
 
 // ================================================
@@ -76,7 +86,7 @@ struct DHPublicValue_Message : public Serializable {
   CryptoPP::SecByteBlock public_value;
 
   void serialize(std::vector<unsigned char> &data);
-  int deserialize(std::vector<unsigned char> &data);
+  size_t deserialize(std::vector<unsigned char> &data);
 };
 
 // ================================================
@@ -87,14 +97,14 @@ struct SenderToReceiver_OTPublicValue_Message : public Serializable {
   CryptoPP::SecByteBlock public_value;
 
   void serialize(std::vector<unsigned char> &data);
-  int deserialize(std::vector<unsigned char> &data);
+  size_t deserialize(std::vector<unsigned char> &data);
 };
 
 struct ReceiverToSender_OTPublicValue_Message : public Serializable {
   CryptoPP::SecByteBlock public_value;
 
   void serialize(std::vector<unsigned char> &data);
-  int deserialize(std::vector<unsigned char> &data);
+  size_t deserialize(std::vector<unsigned char> &data);
 };
 
 struct SenderToReceiver_OTEncryptedValues_Message : public Serializable {
@@ -105,7 +115,56 @@ struct SenderToReceiver_OTEncryptedValues_Message : public Serializable {
   CryptoPP::SecByteBlock iv1;
 
   void serialize(std::vector<unsigned char> &data);
-  int deserialize(std::vector<unsigned char> &data);
+  size_t deserialize(std::vector<unsigned char> &data);
+};
+
+struct SenderToReceiver_OTPublicValues_Message : public Serializable {
+  std::vector<CryptoPP::SecByteBlock> public_values;
+
+  void serialize(std::vector<unsigned char> &data);
+  size_t deserialize(std::vector<unsigned char> &data);
+};
+
+struct ReceiverToSender_OTPublicValues_Message : public Serializable {
+  std::vector<CryptoPP::SecByteBlock> public_values;
+
+  void serialize(std::vector<unsigned char> &data);
+  size_t deserialize(std::vector<unsigned char> &data);
+};
+
+struct SenderToReceiver_OTEncryptedValuesBatch_Message : public Serializable {
+  std::vector<std::string> e0;
+  std::vector<std::string> e1;
+  std::vector<CryptoPP::SecByteBlock> iv0;
+  std::vector<CryptoPP::SecByteBlock> iv1;
+
+  void serialize(std::vector<unsigned char> &data);
+  size_t deserialize(std::vector<unsigned char> &data);
+};
+
+struct ReceiverToSender_OTChoiceCorrections_Message : public Serializable {
+  // choice bit XOR the random choice bit of the precomputed OT
+  std::vector<bool> corrections;
+
+  void serialize(std::vector<unsigned char> &data);
+  size_t deserialize(std::vector<unsigned char> &data);
+};
+
+struct SenderToReceiver_OTMaskedValues_Message : public Serializable {
+  // messages XORed with the precomputed random OT pads
+  std::vector<std::string> e0;
+  std::vector<std::string> e1;
+
+  void serialize(std::vector<unsigned char> &data);
+  size_t deserialize(std::vector<unsigned char> &data);
+};
+
+struct ReceiverToSender_OTExtensionColumns_Message : public Serializable {
+  // u^i = G(k_i^0) ^ G(k_i^1) ^ r for every column i of the IKNP matrix
+  std::vector<std::string> columns;
+
+  void serialize(std::vector<unsigned char> &data);
+  size_t deserialize(std::vector<unsigned char> &data);
 };
 
 // ================================================
@@ -114,28 +173,48 @@ struct SenderToReceiver_OTEncryptedValues_Message : public Serializable {
 
 struct GarblerToEvaluator_GarbledTables_Message : public Serializable {
   std::vector<GarbledGate> garbled_tables;
+  // Sent instead of garbled_tables if it has tables; received as those.
+  PackedTables packed_tables;
 
   void serialize(std::vector<unsigned char> &data);
-  int deserialize(std::vector<unsigned char> &data);
+  size_t deserialize(std::vector<unsigned char> &data);
 };
 
 struct GarblerToEvaluator_GarblerInputs_Message : public Serializable {
   std::vector<GarbledWire> garbler_inputs;
 
   void serialize(std::vector<unsigned char> &data);
-  int deserialize(std::vector<unsigned char> &data);
+  size_t deserialize(std::vector<unsigned char> &data);
 };
 
 struct EvaluatorToGarbler_FinalLabels_Message : public Serializable {
   std::vector<GarbledWire> final_labels;
 
   void serialize(std::vector<unsigned char> &data);
-  int deserialize(std::vector<unsigned char> &data);
+  size_t deserialize(std::vector<unsigned char> &data);
 };
 
 struct GarblerToEvaluator_FinalOutput_Message : public Serializable {
   std::string final_output;
 
   void serialize(std::vector<unsigned char> &data);
-  int deserialize(std::vector<unsigned char> &data);
+  size_t deserialize(std::vector<unsigned char> &data);
+};
+
+// Sent before each evaluation of a session; `done` ends the session.
+struct GarblerToEvaluator_EvaluationHeader_Message : public Serializable {
+  std::string circuit_name;
+  bool done;
+
+  void serialize(std::vector<unsigned char> &data);
+  size_t deserialize(std::vector<unsigned char> &data);
+};
+
+// A slice of spilled garbled tables in TableStore format; `last` ends them.
+struct GarblerToEvaluator_GarbledTablesChunk_Message : public Serializable {
+  std::vector<unsigned char> tables;
+  bool last;
+
+  void serialize(std::vector<unsigned char> &data);
+  size_t deserialize(std::vector<unsigned char> &data);
 };
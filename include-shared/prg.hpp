@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstdint>
+
+#include <crypto++/aes.h>
+#include <crypto++/cryptlib.h>
+#include <crypto++/secblock.h>
+
+/**
+ * AES-CTR pseudorandom generator keyed by a seed. Output is addressed by
+ * index, so any block can be re-derived later without keeping it around;
+ * generate() additionally reads it as one sequential stream.
+ */
+class PRG {
+public:
+  PRG(const CryptoPP::SecByteBlock &seed);
+  CryptoPP::SecByteBlock derive(uint64_t index, size_t length) const;
+  void generate(CryptoPP::byte *output, size_t length);
+  static CryptoPP::SecByteBlock generate_seed();
+
+private:
+  CryptoPP::AES::Encryption aes;
+  uint64_t stream_block;
+};
+
+/**
+ * Cryptographically secure generator of the calling thread: a PRG seeded
+ * once from the OS, buffered so that small requests don't each pay for a
+ * round of AES. Usable wherever Crypto++ wants a RandomNumberGenerator.
+ */
+class ThreadRNG : public CryptoPP::RandomNumberGenerator {
+public:
+  static ThreadRNG &get();
+  void GenerateBlock(CryptoPP::byte *output, size_t size) override;
+  bool random_bit();
+
+private:
+  ThreadRNG();
+
+  PRG prg;
+  CryptoPP::SecByteBlock buffer;
+  size_t buffer_offset;
+  CryptoPP::byte bits;
+  int bits_left;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "../include-shared/constants.hpp"
+
+/**
+ * Garbled tables spilled to disk, for circuits whose tables don't fit in
+ * memory. Tables are appended to an unlinked file in `spill_dir` through a
+ * write buffer, then mapped read-only and consumed once, front to back, with
+ * the kernel reading ahead of the cursor and pages behind it released.
+ *
+ * Each gate is stored as its number of entries (one byte) followed by the
+ * entries, entry_length bytes each: table_entry_length(scheme) for the
+ * protocol's tables, which differs between garbling schemes.
+ */
+class TableStore {
+public:
+  TableStore(std::string spill_dir, size_t entry_length);
+  ~TableStore();
+  TableStore(const TableStore &) = delete;
+  TableStore &operator=(const TableStore &) = delete;
+
+  void append_entries(const unsigned char *entries, size_t num_entries);
+  void append_bytes(const unsigned char *data, size_t length);
+  void finish();
+  size_t size();
+  size_t entry_length() const;
+
+  std::pair<const unsigned char *, size_t> next_entries();
+  std::pair<const unsigned char *, size_t> next_chunk(size_t max_length);
+
+private:
+  void flush();
+  void advance(size_t length);
+
+  int fd;
+  size_t entry_size;
+  size_t length;
+  std::vector<unsigned char> write_buffer;
+
+  // Read side, valid after finish().
+  unsigned char *mapping;
+  size_t read_offset;
+  size_t advised_offset;
+  size_t released_offset;
+};
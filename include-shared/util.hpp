@@ -43,5 +43,6 @@ std::vector<std::string> string_split(std::string str, char delimiter);
 
 // Input parser.
 std::vector<int> parse_input(std::string input_file);
+std::vector<std::vector<int>> parse_inputs(std::string inputs_file);
 
 byte first_bit(CryptoPP::SecBlock<byte> label);
\ No newline at end of file
@@ -1,10 +1,15 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <cstdlib>
+#include <deque>
 #include <iostream>
+#include <mutex>
 #include <string>
+#include <thread>
 
 #include <crypto++/cryptlib.h>
 #include <crypto++/dh.h>
@@ -17,6 +22,7 @@
 #include <crypto++/hkdf.h>
 #include <crypto++/hmac.h>
 #include <crypto++/integer.h>
+#include <crypto++/modarith.h>
 #include <crypto++/modes.h>
 #include <crypto++/nbtheory.h>
 #include <crypto++/osrng.h>
@@ -29,14 +35,26 @@ using namespace CryptoPP;
 
 class CryptoDriver {
 public:
+  CryptoDriver();
+  ~CryptoDriver();
+
   std::vector<unsigned char> encrypt_and_tag(SecByteBlock AES_key,
                                              SecByteBlock HMAC_key,
                                              Serializable *message);
+  std::vector<unsigned char>
+  encrypt_and_tag(SecByteBlock AES_key, SecByteBlock HMAC_key,
+                  const std::vector<unsigned char> &plaintext);
   std::pair<std::vector<unsigned char>, bool>
   decrypt_and_verify(SecByteBlock AES_key, SecByteBlock HMAC_key,
                      std::vector<unsigned char> ciphertext_data);
 
+  void DH_precompute(int count);
   std::tuple<DH, SecByteBlock, SecByteBlock> DH_initialize();
+  std::tuple<DH, std::vector<SecByteBlock>, std::vector<SecByteBlock>>
+  DH_initialize_batch(size_t count);
+  std::vector<SecByteBlock>
+  DL_divide_batch(const std::vector<SecByteBlock> &numerators,
+                  const std::vector<SecByteBlock> &denominators);
   SecByteBlock
   DH_generate_shared_key(const DH &DH_obj, const SecByteBlock &DH_private_value,
                          const SecByteBlock &DH_other_public_value);
@@ -51,5 +69,12 @@ public:
   std::string HMAC_generate(SecByteBlock key, std::string ciphertext);
   bool HMAC_verify(SecByteBlock key, std::string ciphertext, std::string hmac);
 
-  CryptoPP::SecByteBlock hash_inputs(CryptoPP::SecByteBlock &lhs, CryptoPP::SecByteBlock &rhs);
+  CryptoPP::SecByteBlock hash_inputs(const CryptoPP::SecByteBlock &lhs, const CryptoPP::SecByteBlock &rhs);
+
+private:
+  // (private, public) DH keypairs generated ahead of time by DH_precompute.
+  std::deque<std::pair<SecByteBlock, SecByteBlock>> DH_pool;
+  std::mutex DH_pool_mutex;
+  std::vector<std::thread> DH_pool_threads;
+  std::atomic<bool> DH_pool_stop;
 };
@@ -0,0 +1,44 @@
+#pragma once
+#include <chrono>
+#include <memory>
+#include <random>
+#include <string>
+
+#include "../../include/drivers/network_driver.hpp"
+
+// Link characteristics in one direction.
+struct NetworkProfile {
+  double latency_ms;     // one-way propagation delay
+  double bandwidth_mbps; // 0 for unlimited
+  double jitter_ms;      // extra delay drawn uniformly from [0, jitter_ms]
+};
+NetworkProfile parse_network_profile(std::string spec);
+
+/**
+ * Wraps another driver and delays messages as if they crossed a link with
+ * the given profile. Each side shapes its own outgoing traffic: the sender
+ * stamps every message with the time it would arrive and the receiver holds
+ * it until then. Both processes must share a host so steady_clock agrees.
+ */
+class EmulatedNetworkDriver : public NetworkDriver {
+public:
+  using NetworkDriver::send;
+  EmulatedNetworkDriver(std::shared_ptr<NetworkDriver> inner,
+                        NetworkProfile profile);
+  void listen(int port);
+  void connect(std::string address, int port);
+  void disconnect();
+  void send(const std::vector<unsigned char> &data);
+  std::vector<unsigned char> read();
+  std::string get_remote_info();
+
+private:
+  std::shared_ptr<NetworkDriver> inner;
+  NetworkProfile profile;
+  std::mt19937_64 jitter_rng;
+
+  // When the link finishes transmitting what has been sent so far, and when
+  // the last message arrives; messages never overtake each other.
+  std::chrono::steady_clock::time_point link_free_at;
+  std::chrono::steady_clock::time_point last_delivery;
+};
@@ -1,34 +1,252 @@
 #pragma once
+#include <algorithm>
+#include <chrono>
 #include <cstring>
+#include <deque>
+#include <endian.h>
+#include <future>
 #include <iostream>
+#include <mutex>
+#include <thread>
 
 #include <boost/asio.hpp>
 #include <boost/system/error_code.hpp>
 
+#include "../../include-shared/constants.hpp"
 #include "../../include-shared/messages.hpp"
 
+// ================================================
+// FRAMING
+// ================================================
+
+#define NETWORK_CHUNK_SIZE (1 << 20) /* bytes per chunk of a striped message */
+
+// Every message is sent as a 64-bit big-endian length followed by the payload.
+std::vector<boost::asio::const_buffer>
+gather_frames(const std::vector<const std::vector<unsigned char> *> &frames,
+              std::vector<uint64_t> &headers);
+
+// Writes at least this large are sent with MSG_ZEROCOPY where supported;
+// below it, pinning pages costs more than the copy it saves.
+#define ZEROCOPY_THRESHOLD (1 << 16)
+
+// Per-socket MSG_ZEROCOPY bookkeeping.
+struct ZerocopyState {
+  bool enabled = false;     // SO_ZEROCOPY set on the socket
+  bool unavailable = false; // not supported, or the kernel copies anyway
+  uint32_t next_id = 0;     // id the kernel assigns to the next zerocopy send
+};
+bool write_frames_zerocopy(int fd,
+                           const std::vector<std::vector<unsigned char>> &frames,
+                           ZerocopyState &state);
+
+/**
+ * Writes all frames to the stream with a single gathered write.
+ */
+template <typename SyncWriteStream>
+void write_frames(SyncWriteStream &stream,
+                  const std::vector<const std::vector<unsigned char> *> &frames) {
+  std::vector<uint64_t> headers;
+  boost::asio::write(stream, gather_frames(frames, headers));
+}
+
+/**
+ * A TCP socket whose reads and writes fail with timed_out once it has been
+ * idle for `timeout`: each waits at most that long for the socket to become
+ * ready. asio's blocking calls retry past SO_RCVTIMEO, so the wait is done
+ * here instead.
+ */
+class TimedSocket {
+public:
+  TimedSocket(boost::asio::ip::tcp::socket &socket,
+              std::chrono::milliseconds timeout)
+      : socket(socket), timeout(timeout) {}
+
+  template <typename MutableBufferSequence>
+  size_t read_some(const MutableBufferSequence &buffers,
+                   boost::system::error_code &error) {
+    if (!this->wait_ready(false, error)) {
+      return 0;
+    }
+    return this->socket.read_some(buffers, error);
+  }
+
+  template <typename ConstBufferSequence>
+  size_t write_some(const ConstBufferSequence &buffers,
+                    boost::system::error_code &error) {
+    if (!this->wait_ready(true, error)) {
+      return 0;
+    }
+    return this->socket.write_some(buffers, error);
+  }
+
+private:
+  bool wait_ready(bool write, boost::system::error_code &error);
+
+  boost::asio::ip::tcp::socket &socket;
+  std::chrono::milliseconds timeout;
+};
+
+/**
+ * Reads the length header of the next frame from the stream.
+ * @throws error when eof or timed out.
+ */
+template <typename SyncReadStream>
+uint64_t read_frame_header(SyncReadStream &stream) {
+  uint64_t length;
+  boost::system::error_code error;
+  boost::asio::read(stream, boost::asio::buffer(&length, sizeof(uint64_t)),
+                    boost::asio::transfer_exactly(sizeof(uint64_t)), error);
+  if (error == boost::asio::error::timed_out) {
+    throw std::runtime_error("Timed out.");
+  }
+  if (error) {
+    throw std::runtime_error("Received EOF.");
+  }
+  return be64toh(length);
+}
+
+/**
+ * Reads the next frame from the stream.
+ * @throws error when eof or timed out, or if the frame is longer than
+ * MAX_FRAME_LENGTH.
+ */
+template <typename SyncReadStream>
+std::vector<unsigned char> read_frame(SyncReadStream &stream) {
+  // read length, refusing to allocate whatever the peer claims
+  uint64_t length = read_frame_header(stream);
+  if (length > MAX_FRAME_LENGTH) {
+    throw std::runtime_error("Frame too long.");
+  }
+
+  // read message
+  std::vector<unsigned char> data;
+  data.resize(length);
+  boost::system::error_code error;
+  boost::asio::read(stream, boost::asio::buffer(data),
+                    boost::asio::transfer_exactly(length), error);
+  if (error == boost::asio::error::timed_out) {
+    throw std::runtime_error("Timed out.");
+  }
+  if (error) {
+    throw std::runtime_error("Received EOF.");
+  }
+  return data;
+}
+
+// ================================================
+// DRIVERS
+// ================================================
+
 class NetworkDriver {
 public:
   virtual void listen(int port) = 0;
   virtual void connect(std::string address, int port) = 0;
   virtual void disconnect() = 0;
-  virtual void send(std::vector<unsigned char> data) = 0;
+  virtual void send(const std::vector<unsigned char> &data) = 0;
+  virtual void send(std::vector<unsigned char> &&data);
+  virtual void send_frames(const std::vector<std::vector<unsigned char>> &frames);
+  virtual void send_frames(std::vector<std::vector<unsigned char>> &&frames);
+  virtual void send_zerocopy(std::vector<std::vector<unsigned char>> frames);
   virtual std::vector<unsigned char> read() = 0;
   virtual std::string get_remote_info() = 0;
 };
 
 class NetworkDriverImpl : public NetworkDriver {
 public:
+  using NetworkDriver::send;
+  using NetworkDriver::send_frames;
   NetworkDriverImpl();
   void listen(int port);
+  void accept(boost::asio::ip::tcp::acceptor &acceptor);
   void connect(std::string address, int port);
   void disconnect();
-  void send(std::vector<unsigned char> data);
+  void send(const std::vector<unsigned char> &data);
+  void send_frames(const std::vector<std::vector<unsigned char>> &frames);
+  void send_zerocopy(std::vector<std::vector<unsigned char>> frames);
   std::vector<unsigned char> read();
   std::string get_remote_info();
+  void set_timeout(std::chrono::milliseconds timeout);
 
 private:
   int port;
   boost::asio::io_context io_context;
   std::shared_ptr<boost::asio::ip::tcp::socket> socket;
+  ZerocopyState zerocopy;
+  std::chrono::milliseconds timeout; // 0 to wait forever
+};
+
+// Same framing as NetworkDriverImpl over an AF_UNIX stream socket bound to a
+// filesystem path. The port and address arguments are ignored.
+class UnixNetworkDriverImpl : public NetworkDriver {
+public:
+  using NetworkDriver::send;
+  using NetworkDriver::send_frames;
+  UnixNetworkDriverImpl(std::string path);
+  void listen(int port);
+  void connect(std::string address, int port);
+  void disconnect();
+  void send(const std::vector<unsigned char> &data);
+  void send_frames(const std::vector<std::vector<unsigned char>> &frames);
+  std::vector<unsigned char> read();
+  std::string get_remote_info();
+
+private:
+  std::string path;
+  boost::asio::io_context io_context;
+  std::shared_ptr<boost::asio::local::stream_protocol::socket> socket;
+};
+
+class AsyncNetworkDriverImpl : public NetworkDriver {
+public:
+  AsyncNetworkDriverImpl();
+  ~AsyncNetworkDriverImpl();
+  void listen(int port);
+  void connect(std::string address, int port);
+  void disconnect();
+  void send(const std::vector<unsigned char> &data);
+  void send(std::vector<unsigned char> &&data);
+  void send_frames(const std::vector<std::vector<unsigned char>> &frames);
+  void send_frames(std::vector<std::vector<unsigned char>> &&frames);
+  void send_zerocopy(std::vector<std::vector<unsigned char>> frames);
+  std::vector<unsigned char> read();
+  std::string get_remote_info();
+
+  std::shared_future<void> send_async(std::vector<unsigned char> data);
+  std::future<std::vector<unsigned char>> read_async();
+
+private:
+  struct OutgoingFrame {
+    std::vector<unsigned char> data;
+    std::promise<void> done;
+  };
+
+  void start();
+  void do_write();
+  void do_read_header();
+  void do_read_body();
+  void fail_reads(boost::system::error_code error);
+
+  boost::asio::io_context io_context;
+  boost::asio::executor_work_guard<boost::asio::io_context::executor_type>
+      work_guard;
+  std::shared_ptr<boost::asio::ip::tcp::socket> socket;
+  std::thread io_thread;
+
+  // Only touched on the I/O thread.
+  std::deque<std::shared_ptr<OutgoingFrame>> send_queue;
+  std::vector<uint64_t> write_headers;
+  uint64_t incoming_length;
+  std::vector<unsigned char> incoming_data;
+
+  // Shared between the I/O thread and callers.
+  std::mutex mutex;
+  std::shared_future<void> last_send;
+  std::deque<std::vector<unsigned char>> receive_queue;
+  std::deque<std::promise<std::vector<unsigned char>>> pending_reads;
+  std::string read_error; // set once the receive loop stops
+  std::string send_error; // set once a write fails
+
+  // Only touched by the caller of send_zerocopy.
+  ZerocopyState zerocopy;
 };
@@ -3,6 +3,7 @@
 #include <chrono>
 #include <cmath>
 #include <cstdlib>
+#include <deque>
 #include <iostream>
 #include <string>
 
@@ -37,6 +38,30 @@ public:
   void OT_send(std::string m0, std::string m1);
   std::string OT_recv(int choice_bit);
 
+  void OT_send_batch(std::vector<std::pair<std::string, std::string>> messages);
+  std::vector<std::string> OT_recv_batch(std::vector<int> choice_bits);
+
+  void OT_precompute_send(int count);
+  void OT_precompute_recv(int count);
+  void OT_send_precomputed(
+      std::vector<std::pair<std::string, std::string>> messages);
+  std::vector<std::string> OT_recv_precomputed(std::vector<int> choice_bits);
+
+  // The two halves of OT_send_precomputed / OT_recv_precomputed, so that a
+  // batch can exchange all corrections in one message up front.
+  std::vector<bool> OT_recv_corrections(size_t count);
+  void OT_send_masked(
+      const std::vector<std::pair<std::string, std::string>> &messages,
+      const std::vector<bool> &corrections);
+  std::vector<CryptoPP::SecByteBlock>
+  OT_send_corrections(const std::vector<int> &choice_bits);
+  std::vector<std::string>
+  OT_recv_masked(const std::vector<int> &choice_bits,
+                 const std::vector<CryptoPP::SecByteBlock> &pads);
+
+  void OT_extension_setup_send();
+  void OT_extension_setup_recv();
+
 private:
   std::shared_ptr<CryptoDriver> crypto_driver;
   std::shared_ptr<NetworkDriver> network_driver;
@@ -44,4 +69,20 @@ private:
 
   CryptoPP::SecByteBlock AES_key;
   CryptoPP::SecByteBlock HMAC_key;
+
+  // Random OTs from the offline phase, consumed in order by the online phase.
+  std::deque<std::pair<CryptoPP::SecByteBlock, CryptoPP::SecByteBlock>>
+      send_pool;
+  std::deque<std::pair<int, CryptoPP::SecByteBlock>> recv_pool;
+
+  // IKNP OT extension. Once set up, the offline phase extends the base OTs
+  // instead of running public-key OTs.
+  void OT_extend_send(int count);
+  void OT_extend_recv(int count);
+  bool extension_ready = false;
+  CryptoPP::SecByteBlock extension_delta; // sender: base choice bits s
+  std::vector<CryptoPP::SecByteBlock> extension_seeds0; // sender: k_i^{s_i}
+  std::vector<CryptoPP::SecByteBlock> extension_seeds1; // receiver: k_i^1
+  uint64_t extension_batches = 0; // PRG nonce, one per batch
+  uint64_t extension_count = 0;   // index of the next extended OT
 };
@@ -0,0 +1,132 @@
+#pragma once
+#include <atomic>
+#include <cstring>
+#include <memory>
+
+#include "../../include/drivers/network_driver.hpp"
+
+#define SHM_RING_CAPACITY (1 << 22) /* bytes per direction */
+#define SHM_MAGIC 0x59414f53        /* "YAOS" */
+#define SHM_SPIN_LIMIT 4096         /* polls before sleeping on the futex */
+#define SHM_WAIT_INTERVAL_MS 100    /* how often a sleeper checks its peer */
+
+// ================================================
+// RING BUFFER
+// ================================================
+
+// Positions are running byte counts; the ring is empty when head == tail and
+// full when head - tail == capacity. head and tail live on separate cache
+// lines so the producer and consumer don't false-share. A side that has
+// spun too long sleeps on the futex `event`, which the other side bumps
+// after every move when `sleepers` is nonzero.
+struct RingHeader {
+  alignas(64) std::atomic<uint64_t> head;
+  alignas(64) std::atomic<uint64_t> tail;
+  alignas(64) std::atomic<uint32_t> event;
+  std::atomic<uint32_t> sleepers;
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "ring positions must be lock free to live in shared memory");
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "futex words must be plain 32-bit integers");
+
+// Layout of a channel: the header followed by the data of both rings.
+// Ring 0 carries listener -> connector, ring 1 connector -> listener.
+// pids holds the process of each end so a sleeper can tell when its peer died
+// without closing the channel; 0 for ends that can't die on their own.
+struct ChannelHeader {
+  std::atomic<uint32_t> magic;
+  std::atomic<uint32_t> connected; // futex word, set once by the connector
+  std::atomic<uint32_t> closed;
+  std::atomic<int32_t> pids[2];
+  RingHeader rings[2];
+};
+#define CHANNEL_SIZE (sizeof(ChannelHeader) + 2 * (size_t)SHM_RING_CAPACITY)
+
+/**
+ * Lock-free single-producer/single-consumer byte ring. Exactly one thread may
+ * write and exactly one thread may read. A blocked side spins briefly, then
+ * sleeps until the other side makes progress, the channel is closed or the
+ * peer process is gone.
+ */
+class SpscRing {
+public:
+  SpscRing();
+  SpscRing(RingHeader *header, unsigned char *data,
+           std::atomic<uint32_t> *closed, std::atomic<int32_t> *peer_pid);
+  void write(const unsigned char *src, size_t length);
+  void read(unsigned char *dst, size_t length);
+  void notify();
+
+private:
+  template <typename Predicate> void wait_until(Predicate ready);
+  bool peer_gone();
+
+  RingHeader *header;
+  unsigned char *data;
+  std::atomic<uint32_t> *closed;
+  std::atomic<int32_t> *peer_pid;
+};
+
+// ================================================
+// DRIVERS
+// ================================================
+
+/**
+ * Sends length-prefixed messages over a pair of rings in a ChannelHeader.
+ * Subclasses decide where the channel lives.
+ */
+class RingNetworkDriver : public NetworkDriver {
+public:
+  using NetworkDriver::send;
+  void send(const std::vector<unsigned char> &data);
+  std::vector<unsigned char> read();
+
+protected:
+  void attach(ChannelHeader *channel, bool is_listener);
+  void close_channel();
+
+  // Null once closed on this end. Atomic since a thread may close the
+  // channel while others use it.
+  std::atomic<ChannelHeader *> channel = nullptr;
+  SpscRing outgoing;
+  SpscRing incoming;
+};
+
+/**
+ * Transport for two processes on the same host, backed by a POSIX shared
+ * memory object named after the port (/dev/shm/yaos-<port>).
+ */
+class ShmNetworkDriverImpl : public RingNetworkDriver {
+public:
+  ShmNetworkDriverImpl();
+  ~ShmNetworkDriverImpl();
+  void listen(int port);
+  void connect(std::string address, int port);
+  void disconnect();
+  std::string get_remote_info();
+
+private:
+  std::string name;
+  void *mapping;
+};
+
+/**
+ * Transport for two parties on threads of one process. Create both ends with
+ * make_pair(); listen and connect are no-ops.
+ */
+class InProcessNetworkDriverImpl : public RingNetworkDriver {
+public:
+  static std::pair<std::shared_ptr<InProcessNetworkDriverImpl>,
+                   std::shared_ptr<InProcessNetworkDriverImpl>>
+  make_pair();
+  ~InProcessNetworkDriverImpl();
+  void listen(int port);
+  void connect(std::string address, int port);
+  void disconnect();
+  std::string get_remote_info();
+
+private:
+  // Shared by both ends; freed with the last one.
+  std::shared_ptr<unsigned char[]> storage;
+};
@@ -0,0 +1,41 @@
+#pragma once
+#include <cstring>
+#include <future>
+#include <iostream>
+
+#include <boost/asio.hpp>
+#include <boost/system/error_code.hpp>
+
+#include "../../include/drivers/network_driver.hpp"
+
+// Header in front of every chunk: sequence number, length of the whole
+// message and length of this chunk, all 64-bit big-endian.
+struct StripeChunkHeader {
+  uint64_t seq;
+  uint64_t message_length;
+  uint64_t chunk_length;
+};
+
+class StripedNetworkDriverImpl : public NetworkDriver {
+public:
+  using NetworkDriver::send;
+  StripedNetworkDriverImpl(int num_connections);
+  void listen(int port);
+  void connect(std::string address, int port);
+  void disconnect();
+  void send(const std::vector<unsigned char> &data);
+  std::vector<unsigned char> read();
+  std::string get_remote_info();
+
+private:
+  void shutdown_sockets();
+
+  int num_connections;
+  boost::asio::io_context io_context;
+  std::vector<std::shared_ptr<boost::asio::ip::tcp::socket>> sockets;
+
+  // Sequence number of the next chunk in each direction. Chunk `seq` travels
+  // over connection `seq % num_connections`.
+  uint64_t send_seq;
+  uint64_t recv_seq;
+};
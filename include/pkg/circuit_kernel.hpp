@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+
+#include "../../include-shared/circuit.hpp"
+#include "../../include-shared/constants.hpp"
+#include "../../include/pkg/garbling_scheme.hpp"
+
+// ================================================
+// KERNELS
+// ================================================
+
+// Generated kernels are GRR3 at the protocol's label width, so kernel and
+// interpreter interoperate.
+using KernelScheme = Grr3Scheme<LABEL_LENGTH>;
+using KernelLabel = KernelScheme::Label;
+using KernelContext = KernelScheme::Context;
+
+/**
+ * Straight-line garbling and evaluation code for one fixed circuit,
+ * generated by yaos_codegen as a sequence of KernelScheme calls. Both
+ * functions work on an array of num_wire 0 labels whose input wires are
+ * filled in, and a table array with 3 entries per AND gate, 1 per NOT gate
+ * and 2^n - 1 per n-input lookup table, in gate order.
+ */
+struct CircuitKernel {
+  const char *name;
+  uint64_t fingerprint;
+  int num_gate;
+  int num_wire;
+  int num_table_entries;
+  void (*garble)(const KernelContext &ctx, KernelLabel *wires,
+                 KernelLabel *tables);
+  void (*evaluate)(const KernelContext &ctx, KernelLabel *wires,
+                   const KernelLabel *tables);
+};
+
+/**
+ * Makes a kernel available to find_circuit_kernel for as long as it lives.
+ * Generated kernels hold one in a static; tests can scope one to themselves.
+ * Registrations for one fingerprint nest: the latest wins until it goes.
+ */
+class CircuitKernelRegistration {
+public:
+  explicit CircuitKernelRegistration(const CircuitKernel *kernel);
+  ~CircuitKernelRegistration();
+  CircuitKernelRegistration(const CircuitKernelRegistration &) = delete;
+  CircuitKernelRegistration &
+  operator=(const CircuitKernelRegistration &) = delete;
+
+private:
+  const CircuitKernel *kernel;
+  const CircuitKernel *shadowed;
+};
+
+const CircuitKernel *find_circuit_kernel(const Circuit &circuit);
+
+GarbledInstance garble_with_kernel(const CircuitKernel &kernel,
+                                   const Circuit &circuit);
+std::vector<GarbledWire>
+evaluate_with_kernel(const CircuitKernel &kernel, const Circuit &circuit,
+                     const std::vector<GarbledGate> &tables,
+                     const std::vector<GarbledWire> &garbler_inputs,
+                     const std::vector<GarbledWire> &evaluator_inputs);
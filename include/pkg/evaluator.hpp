@@ -1,23 +1,47 @@
 #pragma once
 
 #include "../../include-shared/circuit.hpp"
+#include "../../include-shared/table_store.hpp"
 #include "../../include/drivers/cli_driver.hpp"
 #include "../../include/drivers/crypto_driver.hpp"
 #include "../../include/drivers/network_driver.hpp"
 #include "../../include/drivers/ot_driver.hpp"
 
+// A garbled circuit as received: its tables, in memory or spilled to disk,
+// and the garbler's input labels.
+struct ReceivedCircuit {
+  std::vector<GarbledGate> tables;
+  std::shared_ptr<TableStore> spilled_tables;
+  std::vector<GarbledWire> garbler_inputs;
+};
+
 class EvaluatorClient {
 public:
   EvaluatorClient(Circuit circuit, std::shared_ptr<NetworkDriver> network_driver,
-               std::shared_ptr<CryptoDriver> crypto_driver);
+                  std::shared_ptr<CryptoDriver> crypto_driver);
+  EvaluatorClient(std::shared_ptr<const Circuit> circuit,
+                  std::shared_ptr<NetworkDriver> network_driver,
+                  std::shared_ptr<CryptoDriver> crypto_driver);
   std::pair<CryptoPP::SecByteBlock, CryptoPP::SecByteBlock> HandleKeyExchange();
   std::string run(std::vector<int> input);
-  GarbledWire evaluate_gate(GarbledGate gate, GarbledWire lhs, GarbledWire rhs);
-  bool verify_decryption(CryptoPP::SecByteBlock decryption);
-  CryptoPP::SecByteBlock snip_decryption(CryptoPP::SecByteBlock decryption);
+  std::vector<std::string> run_session(const std::vector<EvaluationJob> &jobs);
+  void set_circuit(std::shared_ptr<const Circuit> circuit);
+  void set_spill_dir(std::string spill_dir);
+  void set_scheme(SchemeType::T scheme);
+  std::string evaluate(std::vector<int> input);
+  std::vector<std::string>
+  run_batch(const std::vector<std::vector<int>> &inputs);
 
 private:
-  Circuit circuit;
+  void prepare_evaluation();
+  void check_spilling(std::vector<unsigned char> &data);
+  ReceivedCircuit receive_garbled_circuit();
+  std::vector<GarbledWire>
+  evaluate_circuit(ReceivedCircuit &garbled_circuit,
+                   const std::vector<GarbledWire> &evaluator_inputs);
+  std::string receive_output();
+
+  std::shared_ptr<const Circuit> circuit;
   std::shared_ptr<NetworkDriver> network_driver;
   std::shared_ptr<CryptoDriver> crypto_driver;
   std::shared_ptr<OTDriver> ot_driver;
@@ -25,4 +49,10 @@ private:
 
   CryptoPP::SecByteBlock AES_key;
   CryptoPP::SecByteBlock HMAC_key;
+
+  // Directory for spilled garbled tables, empty to keep them in memory.
+  std::string spill_dir;
+
+  // How AND and NOT gates were garbled; must match the garbler.
+  SchemeType::T scheme = SchemeType::GRR3;
 };
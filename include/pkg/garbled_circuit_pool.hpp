@@ -0,0 +1,60 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "../../include-shared/circuit.hpp"
+
+/**
+ * A circuit garbled ahead of time: its labels and its serialized
+ * GarblerToEvaluator_GarbledTables_Message, ready to be encrypted and sent.
+ * Move-only, so an instance can't be handed out twice.
+ */
+struct PregarbledInstance {
+  GarbledLabels labels;
+  std::vector<unsigned char> tables;
+
+  PregarbledInstance() = default;
+  PregarbledInstance(const PregarbledInstance &) = delete;
+  PregarbledInstance &operator=(const PregarbledInstance &) = delete;
+  PregarbledInstance(PregarbledInstance &&) = default;
+  PregarbledInstance &operator=(PregarbledInstance &&) = default;
+};
+
+/**
+ * Keeps up to depth garbled instances of one circuit ready, refilled by
+ * background producer threads. Garbling doesn't depend on inputs, so the
+ * online path only has to take an instance and send it.
+ */
+class GarbledCircuitPool {
+public:
+  GarbledCircuitPool(std::shared_ptr<const Circuit> circuit, size_t depth,
+                     size_t memory_limit, int num_producers);
+  ~GarbledCircuitPool();
+  std::shared_ptr<const Circuit> get_circuit();
+  size_t get_depth();
+  std::unique_ptr<PregarbledInstance> take();
+  static size_t instance_memory(const Circuit &circuit);
+
+private:
+  void produce();
+
+  std::shared_ptr<const Circuit> circuit;
+  size_t depth;
+
+  // Ready instances, and instances being garbled; together never more than
+  // depth. A producer failure is handed to the next take() that finds no
+  // instance, and production pauses until it has been.
+  std::mutex mutex;
+  std::condition_variable instance_ready;
+  std::condition_variable slot_free;
+  std::deque<std::unique_ptr<PregarbledInstance>> instances;
+  size_t in_production;
+  bool stopping;
+  std::exception_ptr error;
+  std::vector<std::thread> producers;
+};
@@ -1,28 +1,50 @@
 #pragma once
 
+#include <deque>
+#include <future>
+
 #include "../../include-shared/circuit.hpp"
+#include "../../include-shared/table_store.hpp"
 #include "../../include/drivers/cli_driver.hpp"
 #include "../../include/drivers/crypto_driver.hpp"
 #include "../../include/drivers/network_driver.hpp"
 #include "../../include/drivers/ot_driver.hpp"
+#include "../../include/pkg/garbled_circuit_pool.hpp"
 
 class GarblerClient {
 public:
   GarblerClient(Circuit circuit, std::shared_ptr<NetworkDriver> network_driver,
                 std::shared_ptr<CryptoDriver> crypto_driver);
+  GarblerClient(std::shared_ptr<const Circuit> circuit,
+                std::shared_ptr<NetworkDriver> network_driver,
+                std::shared_ptr<CryptoDriver> crypto_driver);
   std::pair<CryptoPP::SecByteBlock, CryptoPP::SecByteBlock> HandleKeyExchange();
   std::string run(std::vector<int> input);
-  GarbledLabels generate_labels(Circuit circuit);
-  std::vector<GarbledGate> generate_gates(Circuit circuit,
-                                          GarbledLabels labels);
-  CryptoPP::SecByteBlock encrypt_label(GarbledWire lhs, GarbledWire rhs,
-                                       GarbledWire output);
-  CryptoPP::SecByteBlock generate_label(byte select_bit);
-  std::vector<GarbledWire> get_garbled_wires(GarbledLabels labels,
+  std::vector<std::string> run_session(const std::vector<EvaluationJob> &jobs);
+  void set_circuit(std::shared_ptr<const Circuit> circuit);
+  std::string evaluate(std::vector<int> input);
+  std::vector<std::string>
+  run_batch(const std::vector<std::vector<int>> &inputs);
+  void start_garbling();
+  void set_pool(std::shared_ptr<GarbledCircuitPool> pool);
+  void set_seeded_labels(bool seeded_labels);
+  void set_spill_dir(std::string spill_dir);
+  void set_scheme(SchemeType::T scheme);
+  GarbledInstance garble();
+  std::vector<GarbledWire> get_garbled_wires(const GarbledLabels &labels,
                                              std::vector<int> input, int begin);
+  GarbledWire get_label(const GarbledLabels &labels, int wire, int bit);
 
 private:
-  Circuit circuit;
+  void prepare_evaluation();
+  void drop_pending_garbling();
+  std::vector<std::pair<std::string, std::string>>
+  evaluator_label_pairs(const GarbledLabels &labels);
+  std::string decode_output(const GarbledLabels &labels);
+  void send_spilled_tables(TableStore &tables);
+
+  // Read-only, so sessions of a server can share one parsed circuit.
+  std::shared_ptr<const Circuit> circuit;
   std::shared_ptr<NetworkDriver> network_driver;
   std::shared_ptr<CryptoDriver> crypto_driver;
   std::shared_ptr<OTDriver> ot_driver;
@@ -30,4 +52,19 @@ private:
 
   CryptoPP::SecByteBlock AES_key;
   CryptoPP::SecByteBlock HMAC_key;
+
+  // Garbled circuit being produced in the background by start_garbling.
+  std::future<GarbledInstance> pending_garbling;
+
+  // Source of pregarbled instances of this->circuit, if any.
+  std::shared_ptr<GarbledCircuitPool> pool;
+
+  // Derive labels from a per-instance seed instead of storing all of them.
+  bool seeded_labels = false;
+
+  // Directory for spilled garbled tables, empty to keep them in memory.
+  std::string spill_dir;
+
+  // How AND and NOT gates are garbled; the evaluator must use the same.
+  SchemeType::T scheme = SchemeType::GRR3;
 };
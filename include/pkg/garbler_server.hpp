@@ -0,0 +1,51 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+#include "../../include-shared/circuit.hpp"
+#include "../../include-shared/constants.hpp"
+#include "../../include/drivers/cli_driver.hpp"
+#include "../../include/drivers/network_driver.hpp"
+#include "../../include/pkg/garbled_circuit_pool.hpp"
+
+/**
+ * Long-running garbler that accepts evaluator connections on one port and
+ * runs each session on a fixed pool of worker threads. Every session shares
+ * the parsed circuit and the garbler's input, and optionally a pool of
+ * circuits garbled ahead of time. A session whose peer stays silent for
+ * session_timeout fails, so stalled peers can't hold every worker.
+ */
+class GarblerServer {
+public:
+  GarblerServer(std::shared_ptr<const Circuit> circuit, std::vector<int> input,
+                int max_sessions, size_t memory_limit, size_t pool_depth = 0,
+                size_t pool_memory_limit = 0,
+                std::chrono::milliseconds session_timeout =
+                    std::chrono::milliseconds(SESSION_TIMEOUT_MS));
+  void serve(int port);
+  static size_t session_memory(const Circuit &circuit);
+
+private:
+  void worker();
+  void run_session(std::shared_ptr<NetworkDriverImpl> network_driver);
+
+  std::shared_ptr<const Circuit> circuit;
+  std::vector<int> input;
+  int max_sessions;
+  std::chrono::milliseconds session_timeout;
+  std::shared_ptr<CLIDriver> cli_driver;
+  std::shared_ptr<GarbledCircuitPool> pool;
+
+  // Accepted connections waiting for a worker, and the number of sessions
+  // accepted but not yet finished; never more than max_sessions.
+  std::mutex mutex;
+  std::condition_variable session_ready;
+  std::condition_variable slot_free;
+  std::deque<std::shared_ptr<NetworkDriverImpl>> pending_sessions;
+  int in_flight;
+  std::vector<std::thread> workers;
+};
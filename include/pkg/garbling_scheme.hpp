@@ -0,0 +1,1470 @@
+#pragma once
+
+#include <algorithm>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include <crypto++/sha.h>
+
+#include "../../include-shared/circuit.hpp"
+#include "../../include-shared/constants.hpp"
+#include "../../include-shared/prg.hpp"
+#include "../../include-shared/table_store.hpp"
+
+// ================================================
+// LABELS
+// ================================================
+
+static_assert(LABEL_TAG_LENGTH == 0, "schemes assume untagged table entries");
+
+// A label or table entry of W bytes, by value and without allocation.
+template <size_t W> struct Block {
+  static_assert(W <= CryptoPP::SHA256::DIGESTSIZE, "labels are hash outputs");
+  CryptoPP::byte bytes[W];
+};
+
+// Per-instance constants: the free-XOR offset (garbler only) and the NOT
+// gates' rhs.
+template <size_t W> struct SchemeContext {
+  Block<W> delta;
+  Block<W> dummy_rhs;
+};
+
+/**
+ * Operations on blocks shared by the schemes. hash truncates SHA256, so at
+ * W = LABEL_LENGTH it is exactly CryptoDriver::hash_inputs.
+ */
+namespace block {
+template <size_t W> inline int first_bit(const Block<W> &label) {
+  return label.bytes[0] >> 7;
+}
+
+template <size_t W>
+inline Block<W> xor_blocks(const Block<W> &a, const Block<W> &b) {
+  Block<W> out;
+  for (size_t i = 0; i < W; i++) {
+    out.bytes[i] = a.bytes[i] ^ b.bytes[i];
+  }
+  return out;
+}
+
+template <size_t W>
+inline Block<W> select(int bit, const Block<W> &a, const Block<W> &b) {
+  return bit ? b : a;
+}
+
+template <size_t W>
+inline Block<W> hash(const Block<W> &lhs, const Block<W> &rhs) {
+  CryptoPP::SHA256 sha;
+  sha.Update(lhs.bytes, W);
+  sha.Update(rhs.bytes, W);
+  Block<W> out;
+  sha.TruncatedFinal(out.bytes, W);
+  return out;
+}
+
+template <size_t W>
+inline Block<W> hash_tweaked(const Block<W> &label, uint64_t tweak) {
+  CryptoPP::byte encoded_tweak[8];
+  for (int i = 0; i < 8; i++) {
+    encoded_tweak[i] = tweak >> (56 - 8 * i);
+  }
+  CryptoPP::SHA256 sha;
+  sha.Update(label.bytes, W);
+  sha.Update(encoded_tweak, sizeof(encoded_tweak));
+  Block<W> out;
+  sha.TruncatedFinal(out.bytes, W);
+  return out;
+}
+
+template <size_t W>
+inline Block<W> hash_labels(const Block<W> *labels, int n, uint64_t tweak) {
+  CryptoPP::byte encoded_tweak[8];
+  for (int i = 0; i < 8; i++) {
+    encoded_tweak[i] = tweak >> (56 - 8 * i);
+  }
+  CryptoPP::SHA256 sha;
+  for (int i = 0; i < n; i++) {
+    sha.Update(labels[i].bytes, W);
+  }
+  sha.Update(encoded_tweak, sizeof(encoded_tweak));
+  Block<W> out;
+  sha.TruncatedFinal(out.bytes, W);
+  return out;
+}
+
+template <size_t W> inline Block<W> random_block() {
+  Block<W> out;
+  ThreadRNG::get().GenerateBlock(out.bytes, W);
+  return out;
+}
+} // namespace block
+
+/**
+ * Context with a zero offset and the NOT gates' rhs. The garbler fills in
+ * delta; the evaluator never needs it.
+ */
+template <size_t W> SchemeContext<W> make_scheme_context() {
+  SchemeContext<W> ctx = {};
+  std::memcpy(ctx.dummy_rhs.bytes, DUMMY_RHS.BytePtr(), W);
+  return ctx;
+}
+
+// ================================================
+// SCHEMES
+// ================================================
+
+/**
+ * A garbling scheme over free-XOR labels of a fixed width: the size of each
+ * gate type's table, and garbling and evaluation of each gate type on 0
+ * labels (the 1 label is always the 0 label XOR delta). Garbling writes the
+ * output wire's 0 label and table_size(type) entries; the tweak is the gate's
+ * output wire, unique per gate. Lookup tables take their n input labels as
+ * an array and have lut_table_size(n) entries. Input labels and offsets are
+ * the scheme's too, fresh (random_*) or re-derivable from a PRG by index
+ * (derive_*). Table entries are Entry, entry_width bytes: a label in most
+ * schemes. Schemes are policy classes with static members, so the engine
+ * below is specialized per scheme at compile time.
+ */
+template <class S>
+concept GarblingScheme = requires(const typename S::Context &ctx,
+                                  typename S::Label &label,
+                                  const typename S::Label *inputs,
+                                  typename S::Entry *table,
+                                  const typename S::Entry *const_table,
+                                  const PRG &prg, uint64_t tweak,
+                                  GateType::T type, int n) {
+  { S::width } -> std::convertible_to<size_t>;
+  { S::entry_width } -> std::convertible_to<size_t>;
+  { S::type } -> std::convertible_to<SchemeType::T>;
+  { S::table_size(type) } -> std::same_as<int>;
+  { S::lut_table_size(n) } -> std::same_as<int>;
+  { S::random_label() } -> std::same_as<typename S::Label>;
+  { S::random_context() } -> std::same_as<typename S::Context>;
+  { S::derive_label(prg, tweak) } -> std::same_as<typename S::Label>;
+  { S::derive_context(prg, tweak) } -> std::same_as<typename S::Context>;
+  S::garble_xor(ctx, label, label, label);
+  S::garble_and(ctx, label, label, label, table, tweak);
+  S::garble_not(ctx, label, label, table, tweak);
+  S::evaluate_xor(ctx, label, label, label);
+  S::evaluate_and(ctx, label, label, label, const_table, tweak);
+  S::evaluate_not(ctx, label, label, const_table, tweak);
+  S::garble_lut(ctx, inputs, n, tweak, label, table, tweak);
+  S::evaluate_lut(ctx, inputs, n, label, const_table, tweak);
+};
+
+/**
+ * XOR is free in every scheme here, so labels are uniform and the offset only
+ * has its permute bit set. Lookup tables are row reduced like GRR3 in every
+ * scheme that doesn't override them: row r is for the inputs whose labels
+ * have permute bits r, and the row for permute bits 0 is dropped and its hash
+ * is the output label, leaving 2^n - 1 entries.
+ */
+template <size_t W> struct FreeXor {
+  static constexpr size_t width = W;
+  static constexpr size_t entry_width = W;
+  using Label = Block<W>;
+  using Entry = Block<W>;
+  using Context = SchemeContext<W>;
+
+  static Label random_label() { return block::random_block<W>(); }
+  static Context random_context() {
+    Context ctx = make_scheme_context<W>();
+    ctx.delta = random_label();
+    ctx.delta.bytes[0] |= 0x80;
+    return ctx;
+  }
+
+  // Block `index` of `prg`, so the label can be re-derived instead of kept.
+  static Label derive_label(const PRG &prg, uint64_t index) {
+    Label label;
+    std::memcpy(label.bytes, prg.derive(index, W).BytePtr(), W);
+    return label;
+  }
+  static Context derive_context(const PRG &prg, uint64_t index) {
+    Context ctx = make_scheme_context<W>();
+    ctx.delta = derive_label(prg, index);
+    ctx.delta.bytes[0] |= 0x80;
+    return ctx;
+  }
+
+  static void garble_xor(const Context &, const Label &lhs, const Label &rhs,
+                         Label &out) {
+    out = block::xor_blocks(lhs, rhs);
+  }
+  static void evaluate_xor(const Context &, const Label &lhs,
+                           const Label &rhs, Label &out) {
+    out = block::xor_blocks(lhs, rhs);
+  }
+
+  static constexpr int lut_table_size(int n) { return (1 << n) - 1; }
+
+  static void garble_lut(const Context &ctx, const Label *inputs, int n,
+                         uint64_t truth_table, Label &out, Label *table,
+                         uint64_t tweak) {
+    int permute = 0;
+    for (int i = 0; i < n; i++) {
+      permute |= block::first_bit(inputs[i]) << i;
+    }
+    Label labels[LUT_MAX_INPUTS];
+    for (int row = 0; row < (1 << n); row++) {
+      int x = row ^ permute;
+      for (int i = 0; i < n; i++) {
+        labels[i] = (x >> i) & 1 ? block::xor_blocks(inputs[i], ctx.delta)
+                                 : inputs[i];
+      }
+      Label hash = block::hash_labels(labels, n, tweak);
+      if (row == 0) {
+        out = (truth_table >> x) & 1 ? block::xor_blocks(hash, ctx.delta)
+                                     : hash;
+        continue;
+      }
+      Label out_label = (truth_table >> x) & 1
+                            ? block::xor_blocks(out, ctx.delta)
+                            : out;
+      table[row - 1] = block::xor_blocks(hash, out_label);
+    }
+  }
+
+  static void evaluate_lut(const Context &, const Label *inputs, int n,
+                           Label &out, const Label *table, uint64_t tweak) {
+    int row = 0;
+    for (int i = 0; i < n; i++) {
+      row |= block::first_bit(inputs[i]) << i;
+    }
+    out = block::hash_labels(inputs, n, tweak);
+    if (row != 0) {
+      out = block::xor_blocks(out, table[row - 1]);
+    }
+  }
+};
+
+/**
+ * Point-and-permute without row reduction: a fresh random output label and
+ * all 4 rows for AND, both rows for NOT and all 2^n rows for lookup tables.
+ */
+template <size_t W> struct ClassicScheme : FreeXor<W> {
+  using typename FreeXor<W>::Label;
+  using typename FreeXor<W>::Context;
+  static constexpr SchemeType::T type = SchemeType::CLASSIC;
+
+  static constexpr int table_size(GateType::T type) {
+    return type == GateType::AND_GATE ? 4 : type == GateType::NOT_GATE ? 2 : 0;
+  }
+
+  static void garble_and(const Context &ctx, const Label &lhs,
+                         const Label &rhs, Label &out, Label *table,
+                         uint64_t) {
+    Label lhs_labels[2] = {lhs, block::xor_blocks(lhs, ctx.delta)};
+    Label rhs_labels[2] = {rhs, block::xor_blocks(rhs, ctx.delta)};
+    out = FreeXor<W>::random_label();
+    Label out_labels[2] = {out, block::xor_blocks(out, ctx.delta)};
+    for (int x = 0; x < 2; x++) {
+      for (int y = 0; y < 2; y++) {
+        int index = 2 * block::first_bit(lhs_labels[x]) +
+                    block::first_bit(rhs_labels[y]);
+        table[index] = block::xor_blocks(
+            block::hash(lhs_labels[x], rhs_labels[y]), out_labels[x & y]);
+      }
+    }
+  }
+
+  static void garble_not(const Context &ctx, const Label &lhs, Label &out,
+                         Label *table, uint64_t) {
+    Label lhs_labels[2] = {lhs, block::xor_blocks(lhs, ctx.delta)};
+    out = FreeXor<W>::random_label();
+    Label out_labels[2] = {out, block::xor_blocks(out, ctx.delta)};
+    for (int x = 0; x < 2; x++) {
+      table[block::first_bit(lhs_labels[x])] = block::xor_blocks(
+          block::hash(lhs_labels[x], ctx.dummy_rhs), out_labels[1 - x]);
+    }
+  }
+
+  static void evaluate_and(const Context &, const Label &lhs, const Label &rhs,
+                           Label &out, const Label *table, uint64_t) {
+    int index = 2 * block::first_bit(lhs) + block::first_bit(rhs);
+    out = block::xor_blocks(block::hash(lhs, rhs), table[index]);
+  }
+
+  static void evaluate_not(const Context &ctx, const Label &lhs, Label &out,
+                           const Label *table, uint64_t) {
+    out = block::xor_blocks(block::hash(lhs, ctx.dummy_rhs),
+                            table[block::first_bit(lhs)]);
+  }
+
+  static constexpr int lut_table_size(int n) { return 1 << n; }
+
+  static void garble_lut(const Context &ctx, const Label *inputs, int n,
+                         uint64_t truth_table, Label &out, Label *table,
+                         uint64_t tweak) {
+    out = FreeXor<W>::random_label();
+    Label labels[LUT_MAX_INPUTS];
+    for (int x = 0; x < (1 << n); x++) {
+      int row = 0;
+      for (int i = 0; i < n; i++) {
+        labels[i] = (x >> i) & 1 ? block::xor_blocks(inputs[i], ctx.delta)
+                                 : inputs[i];
+        row |= block::first_bit(labels[i]) << i;
+      }
+      Label out_label = (truth_table >> x) & 1
+                            ? block::xor_blocks(out, ctx.delta)
+                            : out;
+      table[row] =
+          block::xor_blocks(block::hash_labels(labels, n, tweak), out_label);
+    }
+  }
+
+  static void evaluate_lut(const Context &, const Label *inputs, int n,
+                           Label &out, const Label *table, uint64_t tweak) {
+    int row = 0;
+    for (int i = 0; i < n; i++) {
+      row |= block::first_bit(inputs[i]) << i;
+    }
+    out = block::xor_blocks(block::hash_labels(inputs, n, tweak), table[row]);
+  }
+};
+
+/**
+ * Row reduction (GRR3): the row whose labels both have permute bit 0 is
+ * dropped and its hash is the output label.
+ */
+template <size_t W> struct Grr3Scheme : FreeXor<W> {
+  using typename FreeXor<W>::Label;
+  using typename FreeXor<W>::Context;
+  static constexpr SchemeType::T type = SchemeType::GRR3;
+
+  static constexpr int table_size(GateType::T type) {
+    return type == GateType::AND_GATE ? 3 : type == GateType::NOT_GATE ? 1 : 0;
+  }
+
+  static void garble_and(const Context &ctx, const Label &lhs,
+                         const Label &rhs, Label &out, Label *table,
+                         uint64_t) {
+    Label lhs_labels[2] = {lhs, block::xor_blocks(lhs, ctx.delta)};
+    Label rhs_labels[2] = {rhs, block::xor_blocks(rhs, ctx.delta)};
+    int a = block::first_bit(lhs);
+    int b = block::first_bit(rhs);
+    Label dropped = block::hash(lhs_labels[a], rhs_labels[b]);
+    out = (a & b) ? block::xor_blocks(dropped, ctx.delta) : dropped;
+    Label out_labels[2] = {out, block::xor_blocks(out, ctx.delta)};
+    for (int x = 0; x < 2; x++) {
+      for (int y = 0; y < 2; y++) {
+        int index = 2 * block::first_bit(lhs_labels[x]) +
+                    block::first_bit(rhs_labels[y]);
+        if (index > 0) {
+          table[index - 1] = block::xor_blocks(
+              block::hash(lhs_labels[x], rhs_labels[y]), out_labels[x & y]);
+        }
+      }
+    }
+  }
+
+  // Like AND with the fixed rhs dummy_rhs.
+  static void garble_not(const Context &ctx, const Label &lhs, Label &out,
+                         Label *table, uint64_t) {
+    Label lhs_labels[2] = {lhs, block::xor_blocks(lhs, ctx.delta)};
+    int a = block::first_bit(lhs);
+    Label dropped = block::hash(lhs_labels[a], ctx.dummy_rhs);
+    out = a ? dropped : block::xor_blocks(dropped, ctx.delta);
+    Label out_labels[2] = {out, block::xor_blocks(out, ctx.delta)};
+    table[0] = block::xor_blocks(block::hash(lhs_labels[1 - a], ctx.dummy_rhs),
+                                 out_labels[a]);
+  }
+
+  static void evaluate_and(const Context &, const Label &lhs, const Label &rhs,
+                           Label &out, const Label *table, uint64_t) {
+    int index = 2 * block::first_bit(lhs) + block::first_bit(rhs);
+    out = block::hash(lhs, rhs);
+    if (index > 0) {
+      out = block::xor_blocks(out, table[index - 1]);
+    }
+  }
+
+  static void evaluate_not(const Context &ctx, const Label &lhs, Label &out,
+                           const Label *table, uint64_t) {
+    out = block::hash(lhs, ctx.dummy_rhs);
+    if (block::first_bit(lhs)) {
+      out = block::xor_blocks(out, table[0]);
+    }
+  }
+};
+
+/**
+ * Half gates: a generator half and an evaluator half per AND, 2 entries;
+ * NOT swaps the input labels for free.
+ */
+template <size_t W> struct HalfGatesScheme : FreeXor<W> {
+  using typename FreeXor<W>::Label;
+  using typename FreeXor<W>::Context;
+  static constexpr SchemeType::T type = SchemeType::HALF_GATES;
+
+  static constexpr int table_size(GateType::T type) {
+    return type == GateType::AND_GATE ? 2 : 0;
+  }
+
+  static void garble_and(const Context &ctx, const Label &lhs,
+                         const Label &rhs, Label &out, Label *table,
+                         uint64_t tweak) {
+    Label lhs_1 = block::xor_blocks(lhs, ctx.delta);
+    Label rhs_1 = block::xor_blocks(rhs, ctx.delta);
+    int pa = block::first_bit(lhs);
+    int pb = block::first_bit(rhs);
+    uint64_t j = 2 * tweak;
+
+    Label hash_a0 = block::hash_tweaked(lhs, j);
+    Label hash_a1 = block::hash_tweaked(lhs_1, j);
+    Label hash_b0 = block::hash_tweaked(rhs, j + 1);
+    Label hash_b1 = block::hash_tweaked(rhs_1, j + 1);
+
+    // TG = H(A0, j) ^ H(A1, j) ^ pb*delta, TE = H(B0, j+1) ^ H(B1, j+1) ^ A0
+    table[0] = block::xor_blocks(hash_a0, hash_a1);
+    if (pb) {
+      table[0] = block::xor_blocks(table[0], ctx.delta);
+    }
+    table[1] = block::xor_blocks(block::xor_blocks(hash_b0, hash_b1), lhs);
+
+    // WG0 = H(A_pa, j) ^ (pa & pb)*delta, WE0 = H(B_pb, j+1)
+    Label wg = block::select(pa, hash_a0, hash_a1);
+    if (pa && pb) {
+      wg = block::xor_blocks(wg, ctx.delta);
+    }
+    out = block::xor_blocks(wg, block::select(pb, hash_b0, hash_b1));
+  }
+
+  static void garble_not(const Context &ctx, const Label &lhs, Label &out,
+                         Label *, uint64_t) {
+    out = block::xor_blocks(lhs, ctx.delta);
+  }
+
+  static void evaluate_and(const Context &, const Label &lhs, const Label &rhs,
+                           Label &out, const Label *table, uint64_t tweak) {
+    uint64_t j = 2 * tweak;
+    out = block::hash_tweaked(lhs, j);
+    if (block::first_bit(lhs)) {
+      out = block::xor_blocks(out, table[0]);
+    }
+    out = block::xor_blocks(out, block::hash_tweaked(rhs, j + 1));
+    if (block::first_bit(rhs)) {
+      out = block::xor_blocks(out, block::xor_blocks(table[1], lhs));
+    }
+  }
+
+  static void evaluate_not(const Context &, const Label &lhs, Label &out,
+                           const Label *, uint64_t) {
+    out = lhs;
+  }
+};
+
+/**
+ * Three halves (Rosulek-Roy): an AND costs 1.5 labels and a byte, one entry;
+ * NOT is free as in half gates. Labels are split into halves L and R. The
+ * evaluator, holding A and B with permute bits (i, j), computes
+ *   L = H(A) ^ H(A ^ B) ^ [i = 0] G0 ^ [i = j] G2 ^ M_L(A, B)
+ *   R = H(B) ^ H(A ^ B) ^ [j = 0] G1 ^ [i = j] G2 ^ M_R(A, B)
+ * with half-width hashes and M a GF(2)-linear map of the four input halves,
+ * bit 7 first: A_L, A_R into L, into R, then the same for B. No fixed M
+ * makes all four rows come out right, so M depends on the row through a
+ * 2-bit coordinate in OFFSETS, sent encrypted per row under its input
+ * labels. Each row's coordinate is uniform whatever the permute bits, so it
+ * reveals nothing about them.
+ */
+template <size_t W> struct ThreeHalvesScheme : FreeXor<W> {
+  static_assert(W % 2 == 0 && W >= 4, "labels split into halves");
+  using typename FreeXor<W>::Label;
+  using typename FreeXor<W>::Context;
+  static constexpr SchemeType::T type = SchemeType::THREE_HALVES;
+  static constexpr size_t half = W / 2;
+
+  // G0, G1 and G2, then the encrypted coordinates, 2 bits per row 2i + j.
+  struct Entry {
+    CryptoPP::byte bytes[3 * half + 1];
+  };
+  static constexpr size_t entry_width = sizeof(Entry);
+
+  static constexpr int table_size(GateType::T type) {
+    return type == GateType::AND_GATE ? 1 : 0;
+  }
+
+  // M for permute bits (0, 0) at coordinate 0 is BASE ^ i SLOPE_A ^ j SLOPE_B;
+  // other rows and permute bits move it by an offset.
+  static constexpr int BASE = 0x04;
+  static constexpr int SLOPE_A = 0x49;
+  static constexpr int SLOPE_B = 0x07;
+  static constexpr int OFFSETS[4] = {0x00, 0x6b, 0xbd, 0xd6};
+  // Coordinate steps along i and j for permute bits 2 pa + pb.
+  static constexpr int STEPS[4][2] = {{0, 0}, {1, 2}, {2, 3}, {3, 1}};
+
+  static int matrix(int i, int j, int coordinate) {
+    return BASE ^ (i ? SLOPE_A : 0) ^ (j ? SLOPE_B : 0) ^ OFFSETS[coordinate];
+  }
+
+  // out ^= M (lhs, rhs).
+  static void add_product(int m, const Label &lhs, const Label &rhs,
+                          Label &out) {
+    for (int k = 0; k < 8; k++) {
+      if (((m >> (7 - k)) & 1) == 0) {
+        continue;
+      }
+      const Label &in = k < 4 ? lhs : rhs;
+      size_t from = (k & 1) * half;
+      size_t to = ((k >> 1) & 1) * half;
+      for (size_t b = 0; b < half; b++) {
+        out.bytes[to + b] ^= in.bytes[from + b];
+      }
+    }
+  }
+
+  // (H(A) ^ H(A ^ B), H(B) ^ H(A ^ B)) from the full-width hashes.
+  static Label hash_halves(const Label &lhs_hash, const Label &rhs_hash,
+                           const Label &sum_hash) {
+    Label out;
+    for (size_t b = 0; b < half; b++) {
+      out.bytes[b] = lhs_hash.bytes[b] ^ sum_hash.bytes[b];
+      out.bytes[half + b] = rhs_hash.bytes[b] ^ sum_hash.bytes[b];
+    }
+    return out;
+  }
+
+  static void garble_and(const Context &ctx, const Label &lhs,
+                         const Label &rhs, Label &out, Entry *table,
+                         uint64_t tweak) {
+    Label lhs_labels[2] = {lhs, block::xor_blocks(lhs, ctx.delta)};
+    Label rhs_labels[2] = {rhs, block::xor_blocks(rhs, ctx.delta)};
+    int pa = block::first_bit(lhs);
+    int pb = block::first_bit(rhs);
+    uint64_t t = 3 * tweak;
+
+    Label lhs_hashes[2], rhs_hashes[2], sum_hashes[2];
+    for (int x = 0; x < 2; x++) {
+      lhs_hashes[x] = block::hash_tweaked(lhs_labels[x], t);
+      rhs_hashes[x] = block::hash_tweaked(rhs_labels[x], t + 1);
+      // A_a ^ B_b = A_0 ^ B_(a ^ b).
+      sum_hashes[x] = block::hash_tweaked(block::xor_blocks(lhs, rhs_labels[x]),
+                                          t + 2);
+    }
+    // The coordinate of row (0, 0), hidden from the evaluator since it needs
+    // both lhs labels' hashes.
+    int start =
+        (lhs_hashes[0].bytes[half + 1] ^ lhs_hashes[1].bytes[half + 1]) & 3;
+    const int *steps = STEPS[2 * pa + pb];
+
+    // rows[i][j]: what the evaluator computes in row (i, j) without G, minus
+    // its output label.
+    Label rows[2][2];
+    Entry &entry = table[0];
+    entry.bytes[3 * half] = 0;
+    for (int i = 0; i < 2; i++) {
+      for (int j = 0; j < 2; j++) {
+        int a = i ^ pa;
+        int b = j ^ pb;
+        int coordinate = start ^ (i ? steps[0] : 0) ^ (j ? steps[1] : 0);
+        int pad = lhs_hashes[a].bytes[half] ^ rhs_hashes[b].bytes[half];
+        int row = 2 * (2 * i + j);
+        entry.bytes[3 * half] |= ((coordinate ^ (pad >> row)) & 3) << row;
+
+        Label &y = rows[i][j];
+        y = hash_halves(lhs_hashes[a], rhs_hashes[b], sum_hashes[a ^ b]);
+        add_product(matrix(i, j, coordinate), lhs_labels[a], rhs_labels[b], y);
+        if (a & b) {
+          y = block::xor_blocks(y, ctx.delta);
+        }
+      }
+    }
+
+    // out = (rows[1][0]_L, rows[0][1]_R); every row then lands on it.
+    for (size_t b = 0; b < half; b++) {
+      out.bytes[b] = rows[1][0].bytes[b];
+      out.bytes[half + b] = rows[0][1].bytes[half + b];
+      entry.bytes[b] = rows[0][1].bytes[b] ^ rows[1][0].bytes[b];
+      entry.bytes[half + b] =
+          rows[1][0].bytes[half + b] ^ rows[0][1].bytes[half + b];
+      entry.bytes[2 * half + b] = rows[1][1].bytes[b] ^ rows[1][0].bytes[b];
+    }
+  }
+
+  static void garble_not(const Context &ctx, const Label &lhs, Label &out,
+                         Entry *, uint64_t) {
+    out = block::xor_blocks(lhs, ctx.delta);
+  }
+
+  static void evaluate_and(const Context &, const Label &lhs, const Label &rhs,
+                           Label &out, const Entry *table, uint64_t tweak) {
+    const Entry &entry = table[0];
+    int i = block::first_bit(lhs);
+    int j = block::first_bit(rhs);
+    uint64_t t = 3 * tweak;
+    Label lhs_hash = block::hash_tweaked(lhs, t);
+    Label rhs_hash = block::hash_tweaked(rhs, t + 1);
+    Label sum_hash = block::hash_tweaked(block::xor_blocks(lhs, rhs), t + 2);
+    int row = 2 * (2 * i + j);
+    int coordinate = ((entry.bytes[3 * half] ^ lhs_hash.bytes[half] ^
+                       rhs_hash.bytes[half]) >>
+                      row) &
+                     3;
+
+    out = hash_halves(lhs_hash, rhs_hash, sum_hash);
+    for (size_t b = 0; b < half; b++) {
+      if (i == 0) {
+        out.bytes[b] ^= entry.bytes[b];
+      }
+      if (j == 0) {
+        out.bytes[half + b] ^= entry.bytes[half + b];
+      }
+      if (i == j) {
+        out.bytes[b] ^= entry.bytes[2 * half + b];
+        out.bytes[half + b] ^= entry.bytes[2 * half + b];
+      }
+    }
+    add_product(matrix(i, j, coordinate), lhs, rhs, out);
+  }
+
+  static void evaluate_not(const Context &, const Label &lhs, Label &out,
+                           const Entry *, uint64_t) {
+    out = lhs;
+  }
+
+  // Lookup tables are the row-reduced rows packed into entries.
+  static constexpr int lut_table_size(int n) {
+    return (FreeXor<W>::lut_table_size(n) * W + entry_width - 1) / entry_width;
+  }
+
+  static void garble_lut(const Context &ctx, const Label *inputs, int n,
+                         uint64_t truth_table, Label &out, Entry *table,
+                         uint64_t tweak) {
+    Label rows[(1 << LUT_MAX_INPUTS) - 1];
+    FreeXor<W>::garble_lut(ctx, inputs, n, truth_table, out, rows, tweak);
+    std::memset(table, 0, lut_table_size(n) * entry_width);
+    std::memcpy(table, rows, FreeXor<W>::lut_table_size(n) * W);
+  }
+
+  static void evaluate_lut(const Context &ctx, const Label *inputs, int n,
+                           Label &out, const Entry *table, uint64_t tweak) {
+    Label rows[(1 << LUT_MAX_INPUTS) - 1];
+    std::memcpy(rows, table, FreeXor<W>::lut_table_size(n) * W);
+    FreeXor<W>::evaluate_lut(ctx, inputs, n, out, rows, tweak);
+  }
+};
+
+// ================================================
+// ENGINE
+// ================================================
+
+template <GarblingScheme S> size_t branch_table_size(const Branch &branch);
+
+// Branches keep seeds and keys in table entries, so entries must be labels.
+template <GarblingScheme S>
+constexpr bool stacks_labels =
+    std::is_same_v<typename S::Entry, typename S::Label>;
+
+template <GarblingScheme S>
+void garble_branch(const Branch &branch, uint64_t index,
+                   const typename S::Context &ctx, typename S::Label *wires,
+                   typename S::Label *tables);
+template <GarblingScheme S>
+void evaluate_branch(const Branch &branch, uint64_t index,
+                     const typename S::Context &ctx, typename S::Label *wires,
+                     const typename S::Label *tables);
+
+/**
+ * Number of table entries one gate of `circuit` has under scheme S.
+ */
+template <GarblingScheme S>
+size_t gate_table_size(const Circuit &circuit, const Gate &gate) {
+  if (gate.type == GateType::BRANCH_GATE) {
+    return branch_table_size<S>(circuit.branches.at(gate.lhs));
+  }
+  if (gate.type == GateType::LUT_GATE) {
+    return S::lut_table_size(circuit.lookup_tables.at(gate.lhs).inputs.size());
+  }
+  return S::table_size(gate.type);
+}
+
+/**
+ * Call f(wire) for every wire `gate` reads.
+ */
+template <class F>
+void for_each_input(const Circuit &circuit, const Gate &gate, F &&f) {
+  switch (gate.type) {
+  case GateType::XOR_GATE:
+  case GateType::AND_GATE:
+    f(gate.lhs);
+    f(gate.rhs);
+    break;
+  case GateType::NOT_GATE:
+    f(gate.lhs);
+    break;
+  case GateType::BRANCH_GATE: {
+    const Branch &branch = circuit.branches.at(gate.lhs);
+    for (int wire : branch.selector) {
+      f(wire);
+    }
+    for (int wire : branch.inputs) {
+      f(wire);
+    }
+    break;
+  }
+  case GateType::LUT_GATE:
+    for (int wire : circuit.lookup_tables.at(gate.lhs).inputs) {
+      f(wire);
+    }
+    break;
+  }
+}
+
+// Copy a lookup table's input labels into `inputs`; returns their number.
+template <class Label, class Wires>
+int gather_lut_inputs(const LookupTable &lookup_table, Wires &wires,
+                      Label *inputs) {
+  int n = lookup_table.inputs.size();
+  for (int i = 0; i < n; i++) {
+    inputs[i] = wires[lookup_table.inputs[i]];
+  }
+  return n;
+}
+
+/**
+ * Number of table entries a circuit has under scheme S.
+ */
+template <GarblingScheme S> size_t count_table_entries(const Circuit &circuit) {
+  size_t entries = 0;
+  for (auto &gate : circuit.gates) {
+    entries += gate_table_size<S>(circuit, gate);
+  }
+  return entries;
+}
+
+/**
+ * Largest table of one gate of `circuit` under scheme S, in entries.
+ */
+template <GarblingScheme S> size_t max_gate_table_size(const Circuit &circuit) {
+  size_t entries = 0;
+  for (auto &gate : circuit.gates) {
+    entries = std::max(entries, gate_table_size<S>(circuit, gate));
+  }
+  return entries;
+}
+
+/**
+ * Garble one gate: write its output wire's 0 label and its table.
+ * `wires[w]` is the 0 label of wire w, in an array or anything indexed like
+ * one; branches need an array, since they are garbled on all their wires.
+ */
+template <GarblingScheme S, class Wires>
+void garble_gate(const Circuit &circuit, const Gate &gate,
+                 const typename S::Context &ctx, Wires &wires,
+                 typename S::Entry *table) {
+  switch (gate.type) {
+  case GateType::XOR_GATE:
+    S::garble_xor(ctx, wires[gate.lhs], wires[gate.rhs], wires[gate.output]);
+    break;
+  case GateType::AND_GATE:
+    S::garble_and(ctx, wires[gate.lhs], wires[gate.rhs], wires[gate.output],
+                  table, gate.output);
+    break;
+  case GateType::NOT_GATE:
+    S::garble_not(ctx, wires[gate.lhs], wires[gate.output], table, gate.output);
+    break;
+  case GateType::BRANCH_GATE:
+    if constexpr (!stacks_labels<S>) {
+      throw std::runtime_error("branches need table entries of one label");
+    } else if constexpr (std::is_pointer_v<Wires>) {
+      garble_branch<S>(circuit.branches[gate.lhs], gate.lhs, ctx, wires, table);
+    } else {
+      throw std::runtime_error("branches only garble on all their wires");
+    }
+    break;
+  case GateType::LUT_GATE: {
+    const LookupTable &lookup_table = circuit.lookup_tables[gate.lhs];
+    typename S::Label inputs[LUT_MAX_INPUTS];
+    int n = gather_lut_inputs(lookup_table, wires, inputs);
+    S::garble_lut(ctx, inputs, n, lookup_table.truth_table, wires[gate.output],
+                  table, gate.output);
+    break;
+  }
+  }
+}
+
+/**
+ * Evaluate one gate on the evaluator's labels, like garble_gate.
+ */
+template <GarblingScheme S, class Wires>
+void evaluate_gate(const Circuit &circuit, const Gate &gate,
+                   const typename S::Context &ctx, Wires &wires,
+                   const typename S::Entry *table) {
+  switch (gate.type) {
+  case GateType::XOR_GATE:
+    S::evaluate_xor(ctx, wires[gate.lhs], wires[gate.rhs], wires[gate.output]);
+    break;
+  case GateType::AND_GATE:
+    S::evaluate_and(ctx, wires[gate.lhs], wires[gate.rhs], wires[gate.output],
+                    table, gate.output);
+    break;
+  case GateType::NOT_GATE:
+    S::evaluate_not(ctx, wires[gate.lhs], wires[gate.output], table,
+                    gate.output);
+    break;
+  case GateType::BRANCH_GATE:
+    if constexpr (!stacks_labels<S>) {
+      throw std::runtime_error("branches need table entries of one label");
+    } else if constexpr (std::is_pointer_v<Wires>) {
+      evaluate_branch<S>(circuit.branches[gate.lhs], gate.lhs, ctx, wires,
+                         table);
+    } else {
+      throw std::runtime_error("branches only evaluate on all their wires");
+    }
+    break;
+  case GateType::LUT_GATE: {
+    typename S::Label inputs[LUT_MAX_INPUTS];
+    int n = gather_lut_inputs(circuit.lookup_tables[gate.lhs], wires, inputs);
+    S::evaluate_lut(ctx, inputs, n, wires[gate.output], table, gate.output);
+    break;
+  }
+  }
+}
+
+/**
+ * Garble every gate of `circuit` in order. `wires` holds num_wire 0 labels
+ * with the input wires filled in; `tables` has room for
+ * count_table_entries<S>(circuit) entries.
+ */
+template <GarblingScheme S>
+void garble_gates(const Circuit &circuit, const typename S::Context &ctx,
+                  typename S::Label *wires, typename S::Entry *tables) {
+  for (auto &gate : circuit.gates) {
+    garble_gate<S>(circuit, gate, ctx, wires, tables);
+    tables += gate_table_size<S>(circuit, gate);
+  }
+}
+
+/**
+ * Evaluate every gate of `circuit` in order on the evaluator's labels.
+ */
+template <GarblingScheme S>
+void evaluate_gates(const Circuit &circuit, const typename S::Context &ctx,
+                    typename S::Label *wires, const typename S::Entry *tables) {
+  for (auto &gate : circuit.gates) {
+    evaluate_gate<S>(circuit, gate, ctx, wires, tables);
+    tables += gate_table_size<S>(circuit, gate);
+  }
+}
+
+// ================================================
+// BRANCHES
+// ================================================
+
+/**
+ * Stacked garbling of branches whose selector the evaluator knows (its own
+ * input). Each alternative j is garbled from its own seed, with its own
+ * labels and offset, and the alternatives' tables are XORed together, so a
+ * branch costs the largest alternative's tables rather than the sum. The
+ * evaluator learns the seed of every alternative but the selected one,
+ * re-garbles those and XORs them out, leaving the selected alternative's
+ * tables. Around the stacked tables the garbler sends, per alternative j:
+ * - its seed, once per selector bit i under the selector label with the
+ *   bit j doesn't have, so any other selector value opens it;
+ * - shares of a key k_j, each under the selector label with the bit j has,
+ *   so only selector value j opens them all, and H(k_j) to recognize it;
+ * - tables translating the branch's input labels to the alternative's and
+ *   its output labels back, keyed with k_j so that the re-garbled
+ *   alternatives reveal nothing.
+ * All of it is deterministic from the seeds, so the scheme must be too.
+ */
+namespace stacking {
+enum PadKind { SEED = 1, SHARE = 2, CHECK = 3, INPUT = 4, OUTPUT = 5 };
+
+// H(label || key || kind || branch || alternative || index), unique per use.
+template <size_t W>
+inline Block<W> pad(PadKind kind, const Block<W> &label,
+                    std::type_identity_t<const Block<W> *> key,
+                    uint64_t branch, uint64_t alternative, uint64_t index) {
+  CryptoPP::byte tweak[25];
+  tweak[0] = kind;
+  for (int i = 0; i < 8; i++) {
+    tweak[1 + i] = branch >> (56 - 8 * i);
+    tweak[9 + i] = alternative >> (56 - 8 * i);
+    tweak[17 + i] = index >> (56 - 8 * i);
+  }
+  CryptoPP::SHA256 sha;
+  sha.Update(label.bytes, W);
+  if (key != nullptr) {
+    sha.Update(key->bytes, W);
+  }
+  sha.Update(tweak, sizeof(tweak));
+  Block<W> out;
+  sha.TruncatedFinal(out.bytes, W);
+  return out;
+}
+
+// Offsets of the parts of a branch gate's table; seeds come first.
+struct Layout {
+  size_t shares, checks, inputs, outputs, material, size;
+};
+
+template <GarblingScheme S> Layout layout(const Branch &branch) {
+  size_t b = branch.circuits.size();
+  size_t k = branch.selector.size();
+  Layout layout;
+  layout.shares = b * k;
+  layout.checks = layout.shares + b * k;
+  layout.inputs = layout.checks + b;
+  layout.outputs = layout.inputs + 2 * b * branch.inputs.size();
+  layout.material = layout.outputs + 2 * b * branch.outputs.size();
+  size_t material = 0;
+  for (auto &circuit : branch.circuits) {
+    material = std::max(material, count_table_entries<S>(circuit));
+  }
+  layout.size = layout.material + material;
+  return layout;
+}
+
+// One alternative garbled from its seed: 0 labels, offset and tables.
+template <GarblingScheme S> struct Alternative {
+  typename S::Context ctx;
+  std::vector<typename S::Label> wires;
+  std::vector<typename S::Label> tables;
+};
+
+template <GarblingScheme S>
+Alternative<S> garble_alternative(const Circuit &circuit,
+                                  const typename S::Label &seed) {
+  static_assert(S::width >= PRG_SEED_LENGTH, "seeds are sent as labels");
+  if constexpr (S::type == SchemeType::CLASSIC) {
+    throw std::runtime_error("branches need a scheme that garbles "
+                             "deterministically");
+  }
+  PRG prg(CryptoPP::SecByteBlock(seed.bytes, PRG_SEED_LENGTH));
+  Alternative<S> alternative;
+  alternative.ctx = S::derive_context(prg, circuit.num_wire);
+  alternative.wires.resize(circuit.num_wire);
+  for (int w = 0; w < circuit.garbler_input_length; w++) {
+    alternative.wires[w] = S::derive_label(prg, w);
+  }
+  alternative.tables.resize(count_table_entries<S>(circuit));
+  garble_gates<S>(circuit, alternative.ctx, alternative.wires.data(),
+                  alternative.tables.data());
+  return alternative;
+}
+} // namespace stacking
+
+/**
+ * Number of table entries of a branch gate under scheme S.
+ */
+template <GarblingScheme S> size_t branch_table_size(const Branch &branch) {
+  return stacking::layout<S>(branch).size;
+}
+
+/**
+ * Garble the branch with index `index` in its circuit: fresh 0 labels for its
+ * output wires, and its table.
+ */
+template <GarblingScheme S>
+void garble_branch(const Branch &branch, uint64_t index,
+                   const typename S::Context &ctx, typename S::Label *wires,
+                   typename S::Label *tables) {
+  using Label = typename S::Label;
+  using namespace stacking;
+  Layout layout = stacking::layout<S>(branch);
+  size_t k = branch.selector.size();
+  size_t num_inputs = branch.inputs.size();
+  size_t num_outputs = branch.outputs.size();
+  auto label = [&ctx](const Label &zero, int bit) {
+    return bit ? block::xor_blocks(zero, ctx.delta) : zero;
+  };
+
+  std::vector<Label> outputs(num_outputs);
+  for (auto &output : outputs) {
+    output = S::random_label();
+  }
+  std::fill(tables + layout.material, tables + layout.size, Label{});
+  for (size_t j = 0; j < branch.circuits.size(); j++) {
+    const Circuit &circuit = branch.circuits[j];
+    Label seed = block::random_block<S::width>();
+    Alternative<S> alternative = garble_alternative<S>(circuit, seed);
+
+    Label key = {};
+    for (size_t i = 0; i < k; i++) {
+      int bit = (j >> i) & 1;
+      const Label &selector = wires[branch.selector[i]];
+      tables[j * k + i] = block::xor_blocks(
+          pad(SEED, label(selector, 1 - bit), nullptr, index, j, i), seed);
+      Label share = block::random_block<S::width>();
+      key = block::xor_blocks(key, share);
+      tables[layout.shares + j * k + i] = block::xor_blocks(
+          pad(SHARE, label(selector, bit), nullptr, index, j, i), share);
+    }
+    tables[layout.checks + j] = pad(CHECK, key, nullptr, index, j, 0);
+
+    for (size_t w = 0; w < num_inputs; w++) {
+      for (int bit = 0; bit < 2; bit++) {
+        Label common = label(wires[branch.inputs[w]], bit);
+        Label local = bit ? block::xor_blocks(alternative.wires[w],
+                                              alternative.ctx.delta)
+                          : alternative.wires[w];
+        tables[layout.inputs + 2 * (j * num_inputs + w) +
+               block::first_bit(common)] =
+            block::xor_blocks(pad(INPUT, common, &key, index, j, w), local);
+      }
+    }
+    for (size_t o = 0; o < num_outputs; o++) {
+      const Label &local_zero =
+          alternative.wires[circuit.num_wire - num_outputs + o];
+      for (int bit = 0; bit < 2; bit++) {
+        Label local = bit ? block::xor_blocks(local_zero, alternative.ctx.delta)
+                          : local_zero;
+        tables[layout.outputs + 2 * (j * num_outputs + o) +
+               block::first_bit(local)] =
+            block::xor_blocks(pad(OUTPUT, local, &key, index, j, o),
+                              label(outputs[o], bit));
+      }
+    }
+
+    for (size_t t = 0; t < alternative.tables.size(); t++) {
+      tables[layout.material + t] =
+          block::xor_blocks(tables[layout.material + t], alternative.tables[t]);
+    }
+  }
+  for (size_t o = 0; o < num_outputs; o++) {
+    wires[branch.outputs[o]] = outputs[o];
+  }
+}
+
+/**
+ * Evaluate the branch with index `index` in its circuit: find the selected
+ * alternative from the selector labels, unstack its tables, evaluate it and
+ * translate its outputs.
+ * @throws error if no alternative matches the selector labels.
+ */
+template <GarblingScheme S>
+void evaluate_branch(const Branch &branch, uint64_t index,
+                     const typename S::Context &ctx, typename S::Label *wires,
+                     const typename S::Label *tables) {
+  using Label = typename S::Label;
+  using namespace stacking;
+  Layout layout = stacking::layout<S>(branch);
+  size_t b = branch.circuits.size();
+  size_t k = branch.selector.size();
+  size_t num_inputs = branch.inputs.size();
+  size_t num_outputs = branch.outputs.size();
+
+  // The selected alternative is the one whose key shares all open.
+  size_t selected = b;
+  Label key;
+  for (size_t j = 0; j < b && selected == b; j++) {
+    Label candidate = {};
+    for (size_t i = 0; i < k; i++) {
+      candidate = block::xor_blocks(
+          candidate,
+          block::xor_blocks(pad(SHARE, wires[branch.selector[i]], nullptr,
+                                index, j, i),
+                            tables[layout.shares + j * k + i]));
+    }
+    Label check = pad(CHECK, candidate, nullptr, index, j, 0);
+    if (std::memcmp(check.bytes, tables[layout.checks + j].bytes, S::width) ==
+        0) {
+      selected = j;
+      key = candidate;
+    }
+  }
+  if (selected == b) {
+    throw std::runtime_error("no branch alternative matches the selector");
+  }
+
+  // Unstack: re-garble every other alternative from its seed and XOR it out.
+  const Circuit &circuit = branch.circuits[selected];
+  std::vector<Label> material(tables + layout.material,
+                              tables + layout.material +
+                                  count_table_entries<S>(circuit));
+  for (size_t j = 0; j < b; j++) {
+    if (j == selected) {
+      continue;
+    }
+    size_t i = 0;
+    while ((((j ^ selected) >> i) & 1) == 0) {
+      i++;
+    }
+    Label seed = block::xor_blocks(
+        pad(SEED, wires[branch.selector[i]], nullptr, index, j, i),
+        tables[j * k + i]);
+    Alternative<S> alternative = garble_alternative<S>(branch.circuits[j], seed);
+    size_t overlap = std::min(material.size(), alternative.tables.size());
+    for (size_t t = 0; t < overlap; t++) {
+      material[t] = block::xor_blocks(material[t], alternative.tables[t]);
+    }
+  }
+
+  std::vector<Label> local(circuit.num_wire);
+  for (size_t w = 0; w < num_inputs; w++) {
+    const Label &common = wires[branch.inputs[w]];
+    local[w] = block::xor_blocks(
+        pad(INPUT, common, &key, index, selected, w),
+        tables[layout.inputs + 2 * (selected * num_inputs + w) +
+               block::first_bit(common)]);
+  }
+  evaluate_gates<S>(circuit, ctx, local.data(), material.data());
+  for (size_t o = 0; o < num_outputs; o++) {
+    const Label &output = local[circuit.num_wire - num_outputs + o];
+    wires[branch.outputs[o]] = block::xor_blocks(
+        pad(OUTPUT, output, &key, index, selected, o),
+        tables[layout.outputs + 2 * (selected * num_outputs + o) +
+               block::first_bit(output)]);
+  }
+}
+
+// ================================================
+// INSTANCES
+// ================================================
+
+// Protocol label of a block.
+template <GarblingScheme S> GarbledWire to_wire(const typename S::Label &label) {
+  GarbledWire wire;
+  wire.value = CryptoPP::SecByteBlock(label.bytes, S::width);
+  return wire;
+}
+
+// Block of a protocol label.
+template <GarblingScheme S>
+typename S::Label to_label(const CryptoPP::SecByteBlock &value) {
+  if (value.size() != S::width) {
+    throw std::runtime_error("label of the wrong length");
+  }
+  typename S::Label label;
+  std::memcpy(label.bytes, value.BytePtr(), S::width);
+  return label;
+}
+
+// Table entry of a protocol table entry.
+template <GarblingScheme S>
+typename S::Entry to_entry(const CryptoPP::SecByteBlock &value) {
+  if (value.size() != S::entry_width) {
+    throw std::runtime_error("table entry of the wrong length");
+  }
+  typename S::Entry entry;
+  std::memcpy(entry.bytes, value.BytePtr(), S::entry_width);
+  return entry;
+}
+
+// Keep wire `wire`'s 0 and 1 labels for the protocol.
+template <GarblingScheme S>
+void keep_labels(GarbledLabels &labels, int wire,
+                 const typename S::Label &zero,
+                 const typename S::Context &ctx) {
+  labels.zeros[wire] = to_wire<S>(zero);
+  labels.ones[wire] = to_wire<S>(block::xor_blocks(zero, ctx.delta));
+}
+
+/**
+ * Keep the input and output wires' labels of a circuit garbled on `wires`
+ * with offset ctx.delta; the protocol needs no others.
+ */
+template <GarblingScheme S>
+void keep_protocol_labels(const Circuit &circuit,
+                          const typename S::Label *wires,
+                          const typename S::Context &ctx,
+                          GarbledLabels &labels) {
+  labels.zeros.resize(circuit.num_wire);
+  labels.ones.resize(circuit.num_wire);
+  labels.delta = CryptoPP::SecByteBlock(ctx.delta.bytes, S::width);
+  int num_inputs = circuit.garbler_input_length + circuit.evaluator_input_length;
+  for (int i = 0; i < num_inputs; i++) {
+    keep_labels<S>(labels, i, wires[i], ctx);
+  }
+  for (int i = circuit.num_wire - circuit.output_length; i < circuit.num_wire;
+       i++) {
+    keep_labels<S>(labels, i, wires[i], ctx);
+  }
+}
+
+/**
+ * Hand one gate's table to the instance: appended to its spilled tables if
+ * it has them, else kept in memory as gate `index`.
+ */
+template <GarblingScheme S>
+void emit_table(GarbledInstance &instance, int index,
+                const typename S::Entry *table, size_t num_entries) {
+  if (instance.spilled_tables) {
+    instance.spilled_tables->append_entries(
+        reinterpret_cast<const unsigned char *>(table), num_entries);
+    return;
+  }
+  auto &entries = instance.tables[index].entries;
+  entries.reserve(num_entries);
+  for (size_t j = 0; j < num_entries; j++) {
+    entries.emplace_back(table[j].bytes, S::entry_width);
+  }
+}
+
+/**
+ * Garble `circuit` under S with fresh random input labels and offset, running
+ * the gates with `garble` (garble_gates<S>, or a generated kernel). Only the
+ * input and output wires' labels are returned; the protocol needs no others.
+ */
+template <GarblingScheme S, class GarbleFn>
+GarbledInstance garble_instance(const Circuit &circuit, GarbleFn &&garble) {
+  using Label = typename S::Label;
+  auto ctx = S::random_context();
+  int num_inputs = circuit.garbler_input_length + circuit.evaluator_input_length;
+  std::vector<Label> wires(circuit.num_wire);
+  for (int i = 0; i < num_inputs; i++) {
+    wires[i] = S::random_label();
+  }
+  std::vector<typename S::Entry> tables(count_table_entries<S>(circuit));
+  garble(ctx, wires.data(), tables.data());
+
+  GarbledInstance instance;
+  keep_protocol_labels<S>(circuit, wires.data(), ctx, instance.labels);
+  instance.tables.resize(circuit.num_gate);
+  const typename S::Entry *table = tables.data();
+  for (int i = 0; i < circuit.num_gate; i++) {
+    size_t num_entries = gate_table_size<S>(circuit, circuit.gates[i]);
+    emit_table<S>(instance, i, table, num_entries);
+    table += num_entries;
+  }
+  return instance;
+}
+
+/**
+ * Garble `circuit` under S gate by gate with fresh random labels, appending
+ * each gate's table to `spilled_tables` as soon as it is garbled, so the
+ * tables never all sit in memory.
+ * @throws error for branches, whose tables are garbled whole.
+ */
+template <GarblingScheme S>
+GarbledInstance garble_spilled_instance(const Circuit &circuit,
+                                        std::shared_ptr<TableStore> tables) {
+  using Label = typename S::Label;
+  if (!circuit.branches.empty()) {
+    throw std::runtime_error("circuits with branches only garble in memory");
+  }
+  auto ctx = S::random_context();
+  int num_inputs = circuit.garbler_input_length + circuit.evaluator_input_length;
+  std::vector<Label> wires(circuit.num_wire);
+  for (int i = 0; i < num_inputs; i++) {
+    wires[i] = S::random_label();
+  }
+
+  GarbledInstance instance;
+  instance.spilled_tables = tables;
+  std::vector<typename S::Entry> table(max_gate_table_size<S>(circuit));
+  Label *wire_labels = wires.data();
+  for (int i = 0; i < circuit.num_gate; i++) {
+    const Gate &gate = circuit.gates[i];
+    garble_gate<S>(circuit, gate, ctx, wire_labels, table.data());
+    emit_table<S>(instance, i, table.data(), gate_table_size<S>(circuit, gate));
+  }
+  keep_protocol_labels<S>(circuit, wires.data(), ctx, instance.labels);
+  return instance;
+}
+
+/**
+ * 0 labels of the wires still to be read while garbling with labels derived
+ * from a PRG: input wire w's label is S::derive_label(prg, w), derived on its
+ * first read, and a wire is dropped after the last gate that reads it, so
+ * memory follows the circuit's width rather than its size.
+ */
+template <GarblingScheme S> class LiveWires {
+public:
+  LiveWires(const Circuit &circuit, const PRG &prg)
+      : circuit(circuit), prg(prg),
+        num_inputs(circuit.garbler_input_length +
+                   circuit.evaluator_input_length),
+        last_use(circuit.num_wire, -1) {
+    for (int i = 0; i < circuit.num_gate; i++) {
+      for_each_input(circuit, circuit.gates[i],
+                     [&](int wire) { this->last_use[wire] = i; });
+    }
+  }
+
+  typename S::Label &operator[](int wire) {
+    auto [it, inserted] = this->live.try_emplace(wire);
+    if (inserted && wire < this->num_inputs) {
+      it->second = S::derive_label(this->prg, wire);
+    }
+    return it->second;
+  }
+
+  // Drop the wires gate `index` read for the last time, and its output if
+  // nothing reads it.
+  void retire(int index) {
+    const Gate &gate = this->circuit.gates[index];
+    auto retire_wire = [&](int wire) {
+      if (this->last_use[wire] <= index) {
+        this->live.erase(wire);
+      }
+    };
+    for_each_input(this->circuit, gate, retire_wire);
+    retire_wire(gate.output);
+  }
+
+private:
+  const Circuit &circuit;
+  const PRG &prg;
+  int num_inputs;
+  std::vector<int> last_use;
+  std::unordered_map<int, typename S::Label> live;
+};
+
+/**
+ * Garble `circuit` under S in one pass with labels derived from a fresh seed:
+ * input wire w gets S::derive_label(prg, w) and the offset comes from
+ * S::derive_context(prg, num_wire). Every other label follows from the
+ * inputs, so only the live wires' labels are held (see LiveWires) and only the
+ * output wires' 0 labels are kept, for decoding. Tables go to `tables` if
+ * given, else into the instance.
+ * @throws error for branches, whose tables are garbled whole.
+ */
+template <GarblingScheme S>
+GarbledInstance garble_seeded_instance(const Circuit &circuit,
+                                       std::shared_ptr<TableStore> tables) {
+  if (!circuit.branches.empty()) {
+    throw std::runtime_error("circuits with branches only garble with "
+                             "random labels");
+  }
+  GarbledInstance instance;
+  GarbledLabels &labels = instance.labels;
+  labels.prg = std::make_shared<const PRG>(PRG::generate_seed());
+  auto ctx = S::derive_context(*labels.prg, circuit.num_wire);
+  labels.delta = CryptoPP::SecByteBlock(ctx.delta.bytes, S::width);
+  int first_output = circuit.num_wire - circuit.output_length;
+  labels.zeros.resize(circuit.output_length);
+
+  instance.spilled_tables = tables;
+  if (!tables) {
+    instance.tables.resize(circuit.num_gate);
+  }
+  LiveWires<S> wires(circuit, *labels.prg);
+  std::vector<typename S::Entry> table(max_gate_table_size<S>(circuit));
+  for (int i = 0; i < circuit.num_gate; i++) {
+    const Gate &gate = circuit.gates[i];
+    garble_gate<S>(circuit, gate, ctx, wires, table.data());
+    emit_table<S>(instance, i, table.data(), gate_table_size<S>(circuit, gate));
+    if (gate.output >= first_output) {
+      labels.zeros.at(gate.output - first_output) =
+          to_wire<S>(wires[gate.output]);
+    }
+    wires.retire(i);
+  }
+  return instance;
+}
+
+/**
+ * The evaluator's num_wire labels with the input wires filled in.
+ * @throws error if an input label is missing or of the wrong length.
+ */
+template <GarblingScheme S>
+std::vector<typename S::Label>
+input_labels(const Circuit &circuit,
+             const std::vector<GarbledWire> &garbler_inputs,
+             const std::vector<GarbledWire> &evaluator_inputs) {
+  std::vector<typename S::Label> wires(circuit.num_wire);
+  for (int i = 0; i < circuit.garbler_input_length; i++) {
+    wires[i] = to_label<S>(garbler_inputs.at(i).value);
+  }
+  for (int i = 0; i < circuit.evaluator_input_length; i++) {
+    wires[circuit.garbler_input_length + i] =
+        to_label<S>(evaluator_inputs.at(i).value);
+  }
+  return wires;
+}
+
+// Labels of the output wires, for the protocol.
+template <GarblingScheme S>
+std::vector<GarbledWire>
+output_labels(const Circuit &circuit,
+              const std::vector<typename S::Label> &wires) {
+  std::vector<GarbledWire> output_wires(circuit.output_length);
+  for (int i = 0; i < circuit.output_length; i++) {
+    output_wires[i] =
+        to_wire<S>(wires[circuit.num_wire - circuit.output_length + i]);
+  }
+  return output_wires;
+}
+
+/**
+ * Evaluate `circuit` under S on received tables and input labels, running the
+ * gates with `evaluate` (evaluate_gates<S>, or a generated kernel).
+ * @return labels of the output wires.
+ * @throws error if the tables or labels don't have the shape S expects.
+ */
+template <GarblingScheme S, class EvaluateFn>
+std::vector<GarbledWire>
+evaluate_instance(const Circuit &circuit, const std::vector<GarbledGate> &tables,
+                  const std::vector<GarbledWire> &garbler_inputs,
+                  const std::vector<GarbledWire> &evaluator_inputs,
+                  EvaluateFn &&evaluate) {
+  std::vector<typename S::Entry> flat_tables;
+  flat_tables.reserve(count_table_entries<S>(circuit));
+  for (int i = 0; i < circuit.num_gate; i++) {
+    if (tables.at(i).entries.size() !=
+        gate_table_size<S>(circuit, circuit.gates[i])) {
+      throw std::runtime_error("garbled table of the wrong size for the scheme");
+    }
+    for (auto &entry : tables[i].entries) {
+      flat_tables.push_back(to_entry<S>(entry));
+    }
+  }
+
+  auto wires = input_labels<S>(circuit, garbler_inputs, evaluator_inputs);
+  auto ctx = make_scheme_context<S::width>();
+  evaluate(ctx, wires.data(), flat_tables.data());
+  return output_labels<S>(circuit, wires);
+}
+
+/**
+ * Evaluate `circuit` under S gate by gate on spilled tables, reading each
+ * gate's table from the store as it is reached.
+ * @return labels of the output wires.
+ * @throws error if the tables or labels don't have the shape S expects, or
+ * for branches.
+ */
+template <GarblingScheme S>
+std::vector<GarbledWire>
+evaluate_spilled_instance(const Circuit &circuit, TableStore &tables,
+                          const std::vector<GarbledWire> &garbler_inputs,
+                          const std::vector<GarbledWire> &evaluator_inputs) {
+  using Label = typename S::Label;
+  if (!circuit.branches.empty()) {
+    throw std::runtime_error("circuits with branches only evaluate in memory");
+  }
+  if (tables.entry_length() != S::entry_width) {
+    throw std::runtime_error("spilled table entries of the wrong length");
+  }
+  auto wires = input_labels<S>(circuit, garbler_inputs, evaluator_inputs);
+  auto ctx = make_scheme_context<S::width>();
+  std::vector<typename S::Entry> table(max_gate_table_size<S>(circuit));
+  Label *wire_labels = wires.data();
+  for (auto &gate : circuit.gates) {
+    auto [entries, num_entries] = tables.next_entries();
+    if (num_entries != gate_table_size<S>(circuit, gate)) {
+      throw std::runtime_error("garbled table of the wrong size for the scheme");
+    }
+    std::memcpy(table.data(), entries, num_entries * S::entry_width);
+    evaluate_gate<S>(circuit, gate, ctx, wire_labels, table.data());
+  }
+  return output_labels<S>(circuit, wires);
+}
+
+size_t table_entry_length(SchemeType::T scheme);
+GarbledInstance garble_with_scheme(SchemeType::T scheme, const Circuit &circuit);
+GarbledInstance garble_spilled_with_scheme(SchemeType::T scheme,
+                                           const Circuit &circuit,
+                                           std::shared_ptr<TableStore> tables);
+GarbledInstance garble_seeded_with_scheme(SchemeType::T scheme,
+                                          const Circuit &circuit,
+                                          std::shared_ptr<TableStore> tables);
+std::vector<GarbledWire>
+evaluate_with_scheme(SchemeType::T scheme, const Circuit &circuit,
+                     const std::vector<GarbledGate> &tables,
+                     const std::vector<GarbledWire> &garbler_inputs,
+                     const std::vector<GarbledWire> &evaluator_inputs);
+std::vector<GarbledWire>
+evaluate_spilled_with_scheme(SchemeType::T scheme, const Circuit &circuit,
+                             TableStore &tables,
+                             const std::vector<GarbledWire> &garbler_inputs,
+                             const std::vector<GarbledWire> &evaluator_inputs);
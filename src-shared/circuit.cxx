@@ -1,38 +1,303 @@
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
 
 #include "circuit.hpp"
+#include "constants.hpp"
+#include "util.hpp"
 #include "crypto++/sha.h"
 
+namespace {
+Circuit parse_circuit_body(FILE *f, bool nested);
+
 /*
- * Parse circuit from file in Bristol format.
+ * Parse "<n> <wire>..." with at most max_length wires.
  */
-Circuit parse_circuit(std::string filename) {
+std::vector<int> parse_wire_list(FILE *f, int max_length) {
+  int length = 0;
+  if (fscanf(f, "%d", &length) != 1) {
+    throw std::runtime_error("truncated branch");
+  }
+  if (length < 0 || length > max_length) {
+    throw std::runtime_error("branch wire list too long");
+  }
+  std::vector<int> wires(length);
+  for (auto &wire : wires) {
+    if (fscanf(f, "%d", &wire) != 1) {
+      throw std::runtime_error("truncated branch");
+    }
+  }
+  return wires;
+}
+
+/*
+ * Whether every gate of a sub-circuit reads and writes wires it has. Lookup
+ * table inputs were checked while parsing.
+ */
+bool gate_wires_in_range(const Circuit &circuit) {
+  auto in_range = [&](int wire) {
+    return wire >= 0 && wire < circuit.num_wire;
+  };
+  for (auto &gate : circuit.gates) {
+    bool reads_lhs =
+        gate.type == GateType::AND_GATE || gate.type == GateType::XOR_GATE ||
+        gate.type == GateType::NOT_GATE;
+    bool reads_rhs =
+        gate.type == GateType::AND_GATE || gate.type == GateType::XOR_GATE;
+    if (!in_range(gate.output) || (reads_lhs && !in_range(gate.lhs)) ||
+        (reads_rhs && !in_range(gate.rhs))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ * Parse the rest of a line
+ *   BRANCH <b> <k> <selector>... <n_in> <input>... <n_out> <output>...
+ * and the b sub-circuits following it, each with its own header.
+ */
+Branch parse_branch(FILE *f, const Circuit &circuit) {
+  Branch branch;
+  int num_branches = 0;
+  if (fscanf(f, "%d", &num_branches) != 1) {
+    throw std::runtime_error("truncated branch");
+  }
+  branch.selector = parse_wire_list(f, 8);
+  branch.inputs = parse_wire_list(f, circuit.num_wire);
+  branch.outputs = parse_wire_list(f, circuit.num_wire);
+  if (branch.selector.empty() ||
+      num_branches != (1 << branch.selector.size())) {
+    throw std::runtime_error("a branch needs 2^k sub-circuits for k selector bits");
+  }
+  for (int i = 0; i < num_branches; i++) {
+    branch.circuits.push_back(parse_circuit_body(f, true));
+  }
+
+  // Only selectors the evaluator knows can be stacked (see Branch).
+  for (int wire : branch.selector) {
+    if (wire < circuit.garbler_input_length ||
+        wire >= circuit.garbler_input_length + circuit.evaluator_input_length) {
+      throw std::runtime_error("branch selectors must be evaluator inputs");
+    }
+  }
+  for (auto *wires : {&branch.inputs, &branch.outputs}) {
+    for (int wire : *wires) {
+      if (wire < 0 || wire >= circuit.num_wire) {
+        throw std::runtime_error("branch wire index out of range");
+      }
+    }
+  }
+  // Stacking indexes a sub-circuit's wires by these, so they must fit.
+  for (auto &sub_circuit : branch.circuits) {
+    if (sub_circuit.garbler_input_length != (int)branch.inputs.size() ||
+        sub_circuit.evaluator_input_length != 0 ||
+        sub_circuit.output_length != (int)branch.outputs.size()) {
+      throw std::runtime_error("branch sub-circuit doesn't match its wires");
+    }
+    if (sub_circuit.num_wire <
+            sub_circuit.garbler_input_length + sub_circuit.output_length ||
+        !gate_wires_in_range(sub_circuit)) {
+      throw std::runtime_error("branch sub-circuit wire index out of range");
+    }
+  }
+  return branch;
+}
+
+/*
+ * Parse the rest of a line
+ *   <n> 1 <input>... <output> LUT <truth table>
+ * after its inputs and output, with the truth table in hex.
+ */
+LookupTable parse_lookup_table(FILE *f, std::vector<int> inputs,
+                               const Circuit &circuit) {
+  LookupTable lookup_table = {std::move(inputs), 0};
+  unsigned long long truth_table = 0;
+  if (fscanf(f, "%llx", &truth_table) != 1) {
+    throw std::runtime_error("lookup table without a truth table");
+  }
+  lookup_table.truth_table = truth_table;
+
+  size_t num_inputs = lookup_table.inputs.size();
+  if (num_inputs == 0 || num_inputs > LUT_MAX_INPUTS) {
+    throw std::runtime_error("a lookup table needs 1 to " +
+                             std::to_string(LUT_MAX_INPUTS) + " inputs");
+  }
+  if ((1 << num_inputs) < 64 && (truth_table >> (1 << num_inputs)) != 0) {
+    throw std::runtime_error("lookup table has more rows than inputs allow");
+  }
+  for (int wire : lookup_table.inputs) {
+    if (wire < 0 || wire >= circuit.num_wire) {
+      throw std::runtime_error("lookup table wire index out of range");
+    }
+  }
+  return lookup_table;
+}
+
+/*
+ * Parse a header and its gates. Sub-circuits of branches can't branch again.
+ */
+Circuit parse_circuit_body(FILE *f, bool nested) {
   Circuit circuit;
 
-  // Open file, scan header.
-  FILE *f = fopen(filename.c_str(), "r");
-  (void)fscanf(f, "%d%d\n", &circuit.num_gate, &circuit.num_wire);
-  (void)fscanf(f, "%d%d%d\n", &circuit.garbler_input_length,
-               &circuit.evaluator_input_length, &circuit.output_length);
+  // Scan header.
+  if (fscanf(f, "%d%d\n", &circuit.num_gate, &circuit.num_wire) != 2 ||
+      fscanf(f, "%d%d%d\n", &circuit.garbler_input_length,
+             &circuit.evaluator_input_length, &circuit.output_length) != 3) {
+    throw std::runtime_error("truncated circuit header");
+  }
+  if (circuit.num_gate < 0 || circuit.num_wire < 0 ||
+      circuit.garbler_input_length < 0 || circuit.evaluator_input_length < 0 ||
+      circuit.output_length < 0) {
+    throw std::runtime_error("negative count in circuit header");
+  }
   (void)fscanf(f, "\n");
 
   // Scan gates.
   circuit.gates.resize(circuit.num_gate);
-  int tmp, lhs, rhs, output;
+  int num_inputs, num_outputs, output;
   char str[10];
   for (int i = 0; i < circuit.num_gate; ++i) {
-    (void)fscanf(f, "%d", &tmp);
-    if (tmp == 2) {
-      (void)fscanf(f, "%d%d%d%d%s", &tmp, &lhs, &rhs, &output, str);
+    if (fscanf(f, "%9s", str) != 1) {
+      throw std::runtime_error("truncated gate");
+    }
+    if (std::string(str) == "BRANCH") {
+      if (nested) {
+        throw std::runtime_error("branches can't be nested");
+      }
+      circuit.branches.push_back(parse_branch(f, circuit));
+      circuit.gates[i] = {GateType::BRANCH_GATE,
+                          (int)circuit.branches.size() - 1, 0, 0};
+      continue;
+    }
+    // Bound the input count before allocating for it; no gate, lookup
+    // tables included, takes more than LUT_MAX_INPUTS.
+    num_inputs = atoi(str);
+    if (num_inputs < 0 || num_inputs > LUT_MAX_INPUTS) {
+      throw std::runtime_error("gate with " + std::to_string(num_inputs) +
+                               " inputs");
+    }
+    if (fscanf(f, "%d", &num_outputs) != 1) {
+      throw std::runtime_error("truncated gate");
+    }
+    std::vector<int> inputs(num_inputs);
+    for (auto &input : inputs) {
+      if (fscanf(f, "%d", &input) != 1) {
+        throw std::runtime_error("truncated gate");
+      }
+    }
+    if (fscanf(f, "%d%9s", &output, str) != 2) {
+      throw std::runtime_error("truncated gate");
+    }
+    if (std::string(str) == "LUT") {
+      if (num_outputs != 1) {
+        throw std::runtime_error("a lookup table has exactly one output");
+      }
+      circuit.lookup_tables.push_back(
+          parse_lookup_table(f, std::move(inputs), circuit));
+      circuit.gates[i] = {GateType::LUT_GATE,
+                          (int)circuit.lookup_tables.size() - 1, 0, output};
+    } else if (num_inputs == 2) {
       if (str[0] == 'A')
-        circuit.gates[i] = {GateType::AND_GATE, lhs, rhs, output};
+        circuit.gates[i] = {GateType::AND_GATE, inputs[0], inputs[1], output};
       else if (str[0] == 'X')
-        circuit.gates[i] = {GateType::XOR_GATE, lhs, rhs, output};
-    } else if (tmp == 1) {
-      (void)fscanf(f, "%d%d%d%s", &tmp, &lhs, &output, str);
-      circuit.gates[i] = {GateType::NOT_GATE, lhs, 0, output};
+        circuit.gates[i] = {GateType::XOR_GATE, inputs[0], inputs[1], output};
+    } else if (num_inputs == 1) {
+      circuit.gates[i] = {GateType::NOT_GATE, inputs[0], 0, output};
     }
   }
 
   return circuit;
 }
+} // namespace
+
+/*
+ * Parse circuit from file in Bristol format, extended with BRANCH lines
+ * (see parse_branch) and LUT gates (see parse_lookup_table).
+ * @throws error for malformed branches or lookup tables.
+ */
+Circuit parse_circuit(std::string filename) {
+  FILE *f = fopen(filename.c_str(), "r");
+  if (f == nullptr) {
+    throw std::runtime_error("could not open circuit file " + filename);
+  }
+  try {
+    Circuit circuit = parse_circuit_body(f, false);
+    fclose(f);
+    return circuit;
+  } catch (...) {
+    fclose(f);
+    throw;
+  }
+}
+
+/*
+ * 64-bit FNV-1a hash of a circuit's header and gates, identifying it without
+ * comparing every gate.
+ */
+uint64_t circuit_fingerprint(const Circuit &circuit) {
+  uint64_t hash = 0xcbf29ce484222325;
+  auto mix = [&hash](int64_t value) {
+    for (int i = 0; i < 8; i++) {
+      hash ^= (value >> (8 * i)) & 0xff;
+      hash *= 0x100000001b3;
+    }
+  };
+  mix(circuit.num_gate);
+  mix(circuit.num_wire);
+  mix(circuit.garbler_input_length);
+  mix(circuit.evaluator_input_length);
+  mix(circuit.output_length);
+  for (auto &gate : circuit.gates) {
+    mix(gate.type);
+    mix(gate.lhs);
+    mix(gate.rhs);
+    mix(gate.output);
+  }
+  for (auto &branch : circuit.branches) {
+    for (auto *wires : {&branch.selector, &branch.inputs, &branch.outputs}) {
+      mix(wires->size());
+      for (int wire : *wires) {
+        mix(wire);
+      }
+    }
+    for (auto &sub_circuit : branch.circuits) {
+      mix(circuit_fingerprint(sub_circuit));
+    }
+  }
+  for (auto &lookup_table : circuit.lookup_tables) {
+    mix(lookup_table.inputs.size());
+    for (int wire : lookup_table.inputs) {
+      mix(wire);
+    }
+    mix(lookup_table.truth_table);
+  }
+  return hash;
+}
+
+/*
+ * Parse a session's jobs from a file with one "<circuit file> <input file>"
+ * pair per line. Jobs naming the same circuit file share one parsed circuit.
+ */
+std::vector<EvaluationJob> parse_jobs(std::string filename) {
+  std::ifstream f(filename);
+  if (!f) {
+    throw std::runtime_error("could not open jobs file " + filename);
+  }
+
+  std::map<std::string, std::shared_ptr<const Circuit>> circuits;
+  std::vector<EvaluationJob> jobs;
+  std::string circuit_file, input_file;
+  while (f >> circuit_file >> input_file) {
+    if (!circuits.count(circuit_file)) {
+      circuits[circuit_file] =
+          std::make_shared<const Circuit>(parse_circuit(circuit_file));
+    }
+    EvaluationJob job;
+    job.circuit_name = circuit_file.substr(circuit_file.find_last_of('/') + 1);
+    job.circuit = circuits[circuit_file];
+    job.input = parse_input(input_file);
+    jobs.push_back(job);
+  }
+  return jobs;
+}
@@ -19,7 +19,7 @@ MessageType::T get_message_type(std::vector<unsigned char> &data) {
 /**
  * Puts the bool b into the end of data.
  */
-int put_bool(bool b, std::vector<unsigned char> &data) {
+size_t put_bool(bool b, std::vector<unsigned char> &data) {
   data.push_back((char)b);
   return 1;
 }
@@ -27,9 +27,9 @@ int put_bool(bool b, std::vector<unsigned char> &data) {
 /**
  * Puts the string s into the end of data.
  */
-int put_string(std::string s, std::vector<unsigned char> &data) {
+size_t put_string(std::string s, std::vector<unsigned char> &data) {
   // Put length
-  int idx = data.size();
+  size_t idx = data.size();
   data.resize(idx + sizeof(size_t));
   size_t str_size = s.size();
   std::memcpy(&data[idx], &str_size, sizeof(size_t));
@@ -39,17 +39,29 @@ int put_string(std::string s, std::vector<unsigned char> &data) {
   return data.size() - idx;
 }
 
+/**
+ * Puts length bytes at bytes into the end of data, like a string of them.
+ */
+size_t put_bytes(const unsigned char *bytes, size_t length,
+                 std::vector<unsigned char> &data) {
+  size_t idx = data.size();
+  data.resize(idx + sizeof(size_t) + length);
+  std::memcpy(&data[idx], &length, sizeof(size_t));
+  std::memcpy(&data[idx + sizeof(size_t)], bytes, length);
+  return sizeof(size_t) + length;
+}
+
 /**
  * Puts the integer i into the end of data.
  */
-int put_integer(CryptoPP::Integer i, std::vector<unsigned char> &data) {
+size_t put_integer(CryptoPP::Integer i, std::vector<unsigned char> &data) {
   return put_string(CryptoPP::IntToString(i), data);
 }
 
 /**
  * Puts the nest bool from data at index idx into b.
  */
-int get_bool(bool *b, std::vector<unsigned char> &data, int idx) {
+size_t get_bool(bool *b, std::vector<unsigned char> &data, size_t idx) {
   *b = (bool)data[idx];
   return 1;
 }
@@ -57,7 +69,7 @@ int get_bool(bool *b, std::vector<unsigned char> &data, int idx) {
 /**
  * Puts the nest string from data at index idx into s.
  */
-int get_string(std::string *s, std::vector<unsigned char> &data, int idx) {
+size_t get_string(std::string *s, std::vector<unsigned char> &data, size_t idx) {
   // Get length
   size_t str_size;
   std::memcpy(&str_size, &data[idx], sizeof(size_t));
@@ -72,10 +84,10 @@ int get_string(std::string *s, std::vector<unsigned char> &data, int idx) {
 /**
  * Puts the next integer from data at index idx into i.
  */
-int get_integer(CryptoPP::Integer *i, std::vector<unsigned char> &data,
-                int idx) {
+size_t get_integer(CryptoPP::Integer *i, std::vector<unsigned char> &data,
+                size_t idx) {
   std::string i_str;
-  int n = get_string(&i_str, data, idx);
+  size_t n = get_string(&i_str, data, idx);
   *i = CryptoPP::Integer(i_str.c_str());
   return n;
 }
@@ -103,13 +115,13 @@ void HMACTagged_Wrapper::serialize(std::vector<unsigned char> &data) {
 /**
  * deserialize HMACTagged_Wrapper.
  */
-int HMACTagged_Wrapper::deserialize(std::vector<unsigned char> &data) {
+size_t HMACTagged_Wrapper::deserialize(std::vector<unsigned char> &data) {
   // Check correct message type.
   assert(data[0] == MessageType::HMACTagged_Wrapper);
 
   // Get fields.
   std::string payload_string;
-  int n = 1;
+  size_t n = 1;
   n += get_string(&payload_string, data, n);
   this->payload = str2chvec(payload_string);
 
@@ -140,13 +152,13 @@ void DHPublicValue_Message::serialize(std::vector<unsigned char> &data) {
 /**
  * deserialize DHPublicValue_Message.
  */
-int DHPublicValue_Message::deserialize(std::vector<unsigned char> &data) {
+size_t DHPublicValue_Message::deserialize(std::vector<unsigned char> &data) {
   // Check correct message type.
   assert(data[0] == MessageType::DHPublicValue_Message);
 
   // Get fields.
   std::string public_string;
-  int n = 1;
+  size_t n = 1;
   n += get_string(&public_string, data, n);
   this->public_value = string_to_byteblock(public_string);
   return n;
@@ -166,14 +178,14 @@ void SenderToReceiver_OTPublicValue_Message::serialize(
   put_string(public_integer, data);
 }
 
-int SenderToReceiver_OTPublicValue_Message::deserialize(
+size_t SenderToReceiver_OTPublicValue_Message::deserialize(
     std::vector<unsigned char> &data) {
   // Check correct message type.
   assert(data[0] == MessageType::SenderToReceiver_OTPublicValue_Message);
 
   // Get fields.
   std::string public_integer;
-  int n = 1;
+  size_t n = 1;
   n += get_string(&public_integer, data, n);
   this->public_value = string_to_byteblock(public_integer);
   return n;
@@ -189,14 +201,14 @@ void ReceiverToSender_OTPublicValue_Message::serialize(
   put_string(public_integer, data);
 }
 
-int ReceiverToSender_OTPublicValue_Message::deserialize(
+size_t ReceiverToSender_OTPublicValue_Message::deserialize(
     std::vector<unsigned char> &data) {
   // Check correct message type.
   assert(data[0] == MessageType::ReceiverToSender_OTPublicValue_Message);
 
   // Get fields.
   std::string public_integer;
-  int n = 1;
+  size_t n = 1;
   n += get_string(&public_integer, data, n);
   this->public_value = string_to_byteblock(public_integer);
   return n;
@@ -217,13 +229,13 @@ void SenderToReceiver_OTEncryptedValues_Message::serialize(
   put_string(iv1, data);
 }
 
-int SenderToReceiver_OTEncryptedValues_Message::deserialize(
+size_t SenderToReceiver_OTEncryptedValues_Message::deserialize(
     std::vector<unsigned char> &data) {
   // Check correct message type.
   assert(data[0] == MessageType::SenderToReceiver_OTEncryptedValues_Message);
 
   // Get fields.
-  int n = 1;
+  size_t n = 1;
   n += get_string(&this->e0, data, n);
   n += get_string(&this->e1, data, n);
 
@@ -237,6 +249,242 @@ int SenderToReceiver_OTEncryptedValues_Message::deserialize(
   return n;
 }
 
+void SenderToReceiver_OTPublicValues_Message::serialize(
+    std::vector<unsigned char> &data) {
+  // Add message type.
+  data.push_back((char)MessageType::SenderToReceiver_OTPublicValues_Message);
+
+  // Put number of public values.
+  size_t idx = data.size();
+  data.resize(idx + sizeof(size_t));
+  size_t num_values = this->public_values.size();
+  std::memcpy(&data[idx], &num_values, sizeof(size_t));
+
+  // Put each public value.
+  for (size_t i = 0; i < num_values; i++) {
+    put_string(byteblock_to_string(this->public_values[i]), data);
+  }
+}
+
+size_t SenderToReceiver_OTPublicValues_Message::deserialize(
+    std::vector<unsigned char> &data) {
+  // Check correct message type.
+  assert(data[0] == MessageType::SenderToReceiver_OTPublicValues_Message);
+
+  // Get length
+  size_t num_values;
+  std::memcpy(&num_values, &data[1], sizeof(size_t));
+
+  // Get fields.
+  size_t n = 1 + sizeof(size_t);
+  this->public_values.resize(num_values);
+  for (size_t i = 0; i < num_values; i++) {
+    std::string public_integer;
+    n += get_string(&public_integer, data, n);
+    this->public_values[i] = string_to_byteblock(public_integer);
+  }
+  return n;
+}
+
+void ReceiverToSender_OTPublicValues_Message::serialize(
+    std::vector<unsigned char> &data) {
+  // Add message type.
+  data.push_back((char)MessageType::ReceiverToSender_OTPublicValues_Message);
+
+  // Put number of public values.
+  size_t idx = data.size();
+  data.resize(idx + sizeof(size_t));
+  size_t num_values = this->public_values.size();
+  std::memcpy(&data[idx], &num_values, sizeof(size_t));
+
+  // Put each public value.
+  for (size_t i = 0; i < num_values; i++) {
+    put_string(byteblock_to_string(this->public_values[i]), data);
+  }
+}
+
+size_t ReceiverToSender_OTPublicValues_Message::deserialize(
+    std::vector<unsigned char> &data) {
+  // Check correct message type.
+  assert(data[0] == MessageType::ReceiverToSender_OTPublicValues_Message);
+
+  // Get length
+  size_t num_values;
+  std::memcpy(&num_values, &data[1], sizeof(size_t));
+
+  // Get fields.
+  size_t n = 1 + sizeof(size_t);
+  this->public_values.resize(num_values);
+  for (size_t i = 0; i < num_values; i++) {
+    std::string public_integer;
+    n += get_string(&public_integer, data, n);
+    this->public_values[i] = string_to_byteblock(public_integer);
+  }
+  return n;
+}
+
+void SenderToReceiver_OTEncryptedValuesBatch_Message::serialize(
+    std::vector<unsigned char> &data) {
+  // Add message type.
+  data.push_back(
+      (char)MessageType::SenderToReceiver_OTEncryptedValuesBatch_Message);
+
+  // Put number of encrypted pairs.
+  size_t idx = data.size();
+  data.resize(idx + sizeof(size_t));
+  size_t num_values = this->e0.size();
+  std::memcpy(&data[idx], &num_values, sizeof(size_t));
+
+  // Put each pair with its IVs.
+  for (size_t i = 0; i < num_values; i++) {
+    put_string(this->e0[i], data);
+    put_string(this->e1[i], data);
+    put_string(byteblock_to_string(this->iv0[i]), data);
+    put_string(byteblock_to_string(this->iv1[i]), data);
+  }
+}
+
+size_t SenderToReceiver_OTEncryptedValuesBatch_Message::deserialize(
+    std::vector<unsigned char> &data) {
+  // Check correct message type.
+  assert(data[0] ==
+         MessageType::SenderToReceiver_OTEncryptedValuesBatch_Message);
+
+  // Get length
+  size_t num_values;
+  std::memcpy(&num_values, &data[1], sizeof(size_t));
+
+  // Get fields.
+  size_t n = 1 + sizeof(size_t);
+  this->e0.resize(num_values);
+  this->e1.resize(num_values);
+  this->iv0.resize(num_values);
+  this->iv1.resize(num_values);
+  for (size_t i = 0; i < num_values; i++) {
+    n += get_string(&this->e0[i], data, n);
+    n += get_string(&this->e1[i], data, n);
+
+    std::string iv0;
+    n += get_string(&iv0, data, n);
+    this->iv0[i] = string_to_byteblock(iv0);
+
+    std::string iv1;
+    n += get_string(&iv1, data, n);
+    this->iv1[i] = string_to_byteblock(iv1);
+  }
+  return n;
+}
+
+void ReceiverToSender_OTChoiceCorrections_Message::serialize(
+    std::vector<unsigned char> &data) {
+  // Add message type.
+  data.push_back((char)MessageType::ReceiverToSender_OTChoiceCorrections_Message);
+
+  // Put number of corrections.
+  size_t idx = data.size();
+  data.resize(idx + sizeof(size_t));
+  size_t num_corrections = this->corrections.size();
+  std::memcpy(&data[idx], &num_corrections, sizeof(size_t));
+
+  // Put each correction bit.
+  for (size_t i = 0; i < num_corrections; i++) {
+    put_bool(this->corrections[i], data);
+  }
+}
+
+size_t ReceiverToSender_OTChoiceCorrections_Message::deserialize(
+    std::vector<unsigned char> &data) {
+  // Check correct message type.
+  assert(data[0] == MessageType::ReceiverToSender_OTChoiceCorrections_Message);
+
+  // Get length
+  size_t num_corrections;
+  std::memcpy(&num_corrections, &data[1], sizeof(size_t));
+
+  // Get fields.
+  size_t n = 1 + sizeof(size_t);
+  this->corrections.resize(num_corrections);
+  for (size_t i = 0; i < num_corrections; i++) {
+    bool correction;
+    n += get_bool(&correction, data, n);
+    this->corrections[i] = correction;
+  }
+  return n;
+}
+
+void SenderToReceiver_OTMaskedValues_Message::serialize(
+    std::vector<unsigned char> &data) {
+  // Add message type.
+  data.push_back((char)MessageType::SenderToReceiver_OTMaskedValues_Message);
+
+  // Put number of masked pairs.
+  size_t idx = data.size();
+  data.resize(idx + sizeof(size_t));
+  size_t num_values = this->e0.size();
+  std::memcpy(&data[idx], &num_values, sizeof(size_t));
+
+  // Put each pair.
+  for (size_t i = 0; i < num_values; i++) {
+    put_string(this->e0[i], data);
+    put_string(this->e1[i], data);
+  }
+}
+
+size_t SenderToReceiver_OTMaskedValues_Message::deserialize(
+    std::vector<unsigned char> &data) {
+  // Check correct message type.
+  assert(data[0] == MessageType::SenderToReceiver_OTMaskedValues_Message);
+
+  // Get length
+  size_t num_values;
+  std::memcpy(&num_values, &data[1], sizeof(size_t));
+
+  // Get fields.
+  size_t n = 1 + sizeof(size_t);
+  this->e0.resize(num_values);
+  this->e1.resize(num_values);
+  for (size_t i = 0; i < num_values; i++) {
+    n += get_string(&this->e0[i], data, n);
+    n += get_string(&this->e1[i], data, n);
+  }
+  return n;
+}
+
+void ReceiverToSender_OTExtensionColumns_Message::serialize(
+    std::vector<unsigned char> &data) {
+  // Add message type.
+  data.push_back((char)MessageType::ReceiverToSender_OTExtensionColumns_Message);
+
+  // Put number of columns.
+  size_t idx = data.size();
+  data.resize(idx + sizeof(size_t));
+  size_t num_columns = this->columns.size();
+  std::memcpy(&data[idx], &num_columns, sizeof(size_t));
+
+  // Put each column.
+  for (size_t i = 0; i < num_columns; i++) {
+    put_string(this->columns[i], data);
+  }
+}
+
+size_t ReceiverToSender_OTExtensionColumns_Message::deserialize(
+    std::vector<unsigned char> &data) {
+  // Check correct message type.
+  assert(data[0] == MessageType::ReceiverToSender_OTExtensionColumns_Message);
+
+  // Get length
+  size_t num_columns;
+  std::memcpy(&num_columns, &data[1], sizeof(size_t));
+
+  // Get fields.
+  size_t n = 1 + sizeof(size_t);
+  this->columns.resize(num_columns);
+  for (size_t i = 0; i < num_columns; i++) {
+    n += get_string(&this->columns[i], data, n);
+  }
+  return n;
+}
+
 // ================================================
 // GARBLED CIRCUITS
 // ================================================
@@ -247,17 +495,37 @@ void GarblerToEvaluator_GarbledTables_Message::serialize(
   data.push_back((char)MessageType::GarblerToEvaluator_GarbledTables_Message);
 
   // Put length of garbled tables.
-  int idx = data.size();
+  const PackedTables &packed = this->packed_tables;
+  bool is_packed = !packed.sizes.empty();
+  size_t idx = data.size();
   data.resize(idx + sizeof(size_t));
-  size_t num_tables = this->garbled_tables.size();
+  size_t num_tables =
+      is_packed ? packed.sizes.size() : this->garbled_tables.size();
   std::memcpy(&data[idx], &num_tables, sizeof(size_t));
 
-  // Put each table.
-  for (int i = 0; i < num_tables; i++) {
+  // Put each table; packed ones straight from their buffer, in the same form.
+  if (is_packed) {
+    size_t total_entries = 0;
+    for (size_t size : packed.sizes) {
+      total_entries += size;
+    }
+    data.reserve(data.size() + packed.entries.size() +
+                 (num_tables * 2 + total_entries) * sizeof(size_t));
+    const unsigned char *entry = packed.entries.data();
+    for (size_t num_entries : packed.sizes) {
+      put_integer(CryptoPP::Integer(num_entries), data);
+      for (size_t j = 0; j < num_entries; j++) {
+        put_bytes(entry, packed.entry_length, data);
+        entry += packed.entry_length;
+      }
+    }
+    return;
+  }
+  for (size_t i = 0; i < num_tables; i++) {
     // Put num entries.
-    CryptoPP::Integer num_entries = this->garbled_tables[i].entries.size();
-    put_integer(num_entries, data);
-    for (int j = 0; j < num_entries; j++) {
+    size_t num_entries = this->garbled_tables[i].entries.size();
+    put_integer(CryptoPP::Integer(num_entries), data);
+    for (size_t j = 0; j < num_entries; j++) {
       std::string entry =
           byteblock_to_string(this->garbled_tables[i].entries[j]);
       put_string(entry, data);
@@ -265,7 +533,7 @@ void GarblerToEvaluator_GarbledTables_Message::serialize(
   }
 }
 
-int GarblerToEvaluator_GarbledTables_Message::deserialize(
+size_t GarblerToEvaluator_GarbledTables_Message::deserialize(
     std::vector<unsigned char> &data) {
   // Check correct message type.
   assert(data[0] == MessageType::GarblerToEvaluator_GarbledTables_Message);
@@ -275,12 +543,13 @@ int GarblerToEvaluator_GarbledTables_Message::deserialize(
   std::memcpy(&num_tables, &data[1], sizeof(size_t));
 
   // Get fields.
-  int n = 1 + sizeof(size_t);
-  for (int i = 0; i < num_tables; i++) {
+  size_t n = 1 + sizeof(size_t);
+  for (size_t i = 0; i < num_tables; i++) {
     GarbledGate gate;
-    CryptoPP::Integer num_entries;
-    n += get_integer(&num_entries, data, n);
-    for (int j = 0; j < num_entries; j++) {
+    CryptoPP::Integer num_entries_integer;
+    n += get_integer(&num_entries_integer, data, n);
+    size_t num_entries = num_entries_integer.ConvertToLong();
+    for (size_t j = 0; j < num_entries; j++) {
       std::string entry;
       n += get_string(&entry, data, n);
       gate.entries.push_back(string_to_byteblock(entry));
@@ -296,19 +565,19 @@ void GarblerToEvaluator_GarblerInputs_Message::serialize(
   data.push_back((char)MessageType::GarblerToEvaluator_GarblerInputs_Message);
 
   // Put length of garbled inputs.
-  int idx = data.size();
+  size_t idx = data.size();
   data.resize(idx + sizeof(size_t));
   size_t num_inputs = this->garbler_inputs.size();
   std::memcpy(&data[idx], &num_inputs, sizeof(size_t));
 
   // Put each table.
-  for (int i = 0; i < num_inputs; i++) {
+  for (size_t i = 0; i < num_inputs; i++) {
     std::string entry = byteblock_to_string(this->garbler_inputs[i].value);
     put_string(entry, data);
   }
 }
 
-int GarblerToEvaluator_GarblerInputs_Message::deserialize(
+size_t GarblerToEvaluator_GarblerInputs_Message::deserialize(
     std::vector<unsigned char> &data) {
   // Check correct message type.
   assert(data[0] == MessageType::GarblerToEvaluator_GarblerInputs_Message);
@@ -318,9 +587,9 @@ int GarblerToEvaluator_GarblerInputs_Message::deserialize(
   std::memcpy(&num_inputs, &data[1], sizeof(size_t));
 
   // Get fields.
-  int n = 1 + sizeof(size_t);
+  size_t n = 1 + sizeof(size_t);
   this->garbler_inputs.resize(num_inputs);
-  for (int i = 0; i < num_inputs; i++) {
+  for (size_t i = 0; i < num_inputs; i++) {
     std::string entry;
     n += get_string(&entry, data, n);
     this->garbler_inputs[i].value = string_to_byteblock(entry);
@@ -334,19 +603,19 @@ void EvaluatorToGarbler_FinalLabels_Message::serialize(
   data.push_back((char)MessageType::EvaluatorToGarbler_FinalLabels_Message);
 
   // Put length of garbled inputs.
-  int idx = data.size();
+  size_t idx = data.size();
   data.resize(idx + sizeof(size_t));
   size_t num_labels = this->final_labels.size();
   std::memcpy(&data[idx], &num_labels, sizeof(size_t));
 
   // Put each table.
-  for (int i = 0; i < num_labels; i++) {
+  for (size_t i = 0; i < num_labels; i++) {
     std::string entry = byteblock_to_string(this->final_labels[i].value);
     put_string(entry, data);
   }
 }
 
-int EvaluatorToGarbler_FinalLabels_Message::deserialize(
+size_t EvaluatorToGarbler_FinalLabels_Message::deserialize(
     std::vector<unsigned char> &data) {
   // Check correct message type.
   assert(data[0] == MessageType::EvaluatorToGarbler_FinalLabels_Message);
@@ -356,9 +625,9 @@ int EvaluatorToGarbler_FinalLabels_Message::deserialize(
   std::memcpy(&num_labels, &data[1], sizeof(size_t));
 
   // Get fields.
-  int n = 1 + sizeof(size_t);
+  size_t n = 1 + sizeof(size_t);
   this->final_labels.resize(num_labels);
-  for (int i = 0; i < num_labels; i++) {
+  for (size_t i = 0; i < num_labels; i++) {
     std::string entry;
     n += get_string(&entry, data, n);
     this->final_labels[i].value = string_to_byteblock(entry);
@@ -375,13 +644,64 @@ void GarblerToEvaluator_FinalOutput_Message::serialize(
   put_string(this->final_output, data);
 }
 
-int GarblerToEvaluator_FinalOutput_Message::deserialize(
+size_t GarblerToEvaluator_FinalOutput_Message::deserialize(
     std::vector<unsigned char> &data) {
   // Check correct message type.
   assert(data[0] == MessageType::GarblerToEvaluator_FinalOutput_Message);
 
   // Get fields.
-  int n = 1;
+  size_t n = 1;
   n += get_string(&this->final_output, data, n);
   return n;
 }
+
+void GarblerToEvaluator_EvaluationHeader_Message::serialize(
+    std::vector<unsigned char> &data) {
+  // Add message type.
+  data.push_back((char)MessageType::GarblerToEvaluator_EvaluationHeader_Message);
+
+  // Add fields.
+  put_string(this->circuit_name, data);
+  put_bool(this->done, data);
+}
+
+size_t GarblerToEvaluator_EvaluationHeader_Message::deserialize(
+    std::vector<unsigned char> &data) {
+  // Check correct message type.
+  assert(data[0] == MessageType::GarblerToEvaluator_EvaluationHeader_Message);
+
+  // Get fields.
+  size_t n = 1;
+  n += get_string(&this->circuit_name, data, n);
+  n += get_bool(&this->done, data, n);
+  return n;
+}
+
+void GarblerToEvaluator_GarbledTablesChunk_Message::serialize(
+    std::vector<unsigned char> &data) {
+  // Add message type.
+  data.push_back((char)MessageType::GarblerToEvaluator_GarbledTablesChunk_Message);
+
+  // Add fields; the tables are raw bytes behind their length.
+  put_bool(this->last, data);
+  size_t idx = data.size();
+  size_t length = this->tables.size();
+  data.resize(idx + sizeof(size_t) + length);
+  std::memcpy(&data[idx], &length, sizeof(size_t));
+  std::memcpy(&data[idx + sizeof(size_t)], this->tables.data(), length);
+}
+
+size_t GarblerToEvaluator_GarbledTablesChunk_Message::deserialize(
+    std::vector<unsigned char> &data) {
+  // Check correct message type.
+  assert(data[0] == MessageType::GarblerToEvaluator_GarbledTablesChunk_Message);
+
+  // Get fields.
+  size_t n = 1;
+  n += get_bool(&this->last, data, n);
+  size_t length;
+  std::memcpy(&length, &data[n], sizeof(size_t));
+  n += sizeof(size_t);
+  this->tables.assign(data.begin() + n, data.begin() + n + length);
+  return n + length;
+}
@@ -0,0 +1,143 @@
+#include <algorithm>
+#include <cstring>
+#include <endian.h>
+
+#include <crypto++/osrng.h>
+
+#include "../include-shared/constants.hpp"
+#include "../include-shared/prg.hpp"
+
+namespace {
+// Index of the sequential stream, out of the way of derive()'s indices.
+const uint64_t STREAM_INDEX = UINT64_MAX;
+
+// Writes the counter block (index || block), both halves big-endian.
+void put_counter(CryptoPP::byte *out, uint64_t index, uint64_t block) {
+  uint64_t index_be = htobe64(index);
+  uint64_t block_be = htobe64(block);
+  std::memcpy(out, &index_be, sizeof(uint64_t));
+  std::memcpy(out + sizeof(uint64_t), &block_be, sizeof(uint64_t));
+}
+
+// Fresh AES key straight from the OS.
+CryptoPP::SecByteBlock os_seed() {
+  CryptoPP::SecByteBlock seed(PRG_SEED_LENGTH);
+  CryptoPP::OS_GenerateRandomBlock(false, seed, seed.size());
+  return seed;
+}
+} // namespace
+
+// ================================================
+// PRG
+// ================================================
+
+/**
+ * Constructor. Runs the AES key schedule once for every derivation.
+ * @param seed AES key, PRG_SEED_LENGTH bytes.
+ */
+PRG::PRG(const CryptoPP::SecByteBlock &seed) : stream_block(0) {
+  this->aes.SetKey(seed, seed.size());
+}
+
+/**
+ * Derive `length` bytes for `index`: AES of the counter blocks
+ * (index || 0), (index || 1), ...
+ */
+CryptoPP::SecByteBlock PRG::derive(uint64_t index, size_t length) const {
+  const size_t block_size = CryptoPP::AES::BLOCKSIZE;
+  size_t num_blocks = (length + block_size - 1) / block_size;
+  CryptoPP::SecByteBlock counters(num_blocks * block_size);
+  for (size_t i = 0; i < num_blocks; i++) {
+    put_counter(counters + i * block_size, index, i);
+  }
+  this->aes.AdvancedProcessBlocks(counters, nullptr, counters,
+                                  counters.size(), 0);
+  counters.resize(length);
+  return counters;
+}
+
+/**
+ * Fill `output` with the next `length` bytes of the sequential stream. Whole
+ * blocks are encrypted in place in one call; a trailing partial block uses
+ * up a full one.
+ */
+void PRG::generate(CryptoPP::byte *output, size_t length) {
+  const size_t block_size = CryptoPP::AES::BLOCKSIZE;
+  size_t whole = length / block_size * block_size;
+  for (size_t offset = 0; offset < whole; offset += block_size) {
+    put_counter(output + offset, STREAM_INDEX, this->stream_block++);
+  }
+  if (whole > 0) {
+    this->aes.AdvancedProcessBlocks(output, nullptr, output, whole, 0);
+  }
+  if (whole < length) {
+    CryptoPP::byte block[CryptoPP::AES::BLOCKSIZE];
+    put_counter(block, STREAM_INDEX, this->stream_block++);
+    this->aes.ProcessBlock(block);
+    std::memcpy(output + whole, block, length - whole);
+  }
+}
+
+/**
+ * Fresh random seed from this thread's generator.
+ */
+CryptoPP::SecByteBlock PRG::generate_seed() {
+  CryptoPP::SecByteBlock seed(PRG_SEED_LENGTH);
+  ThreadRNG::get().GenerateBlock(seed, seed.size());
+  return seed;
+}
+
+// ================================================
+// THREAD RNG
+// ================================================
+
+/**
+ * Constructor. The only OS randomness this thread's generator ever uses.
+ */
+ThreadRNG::ThreadRNG()
+    : prg(os_seed()), buffer(THREAD_RNG_BUFFER_SIZE),
+      buffer_offset(THREAD_RNG_BUFFER_SIZE), bits(0), bits_left(0) {}
+
+/**
+ * Generator of the calling thread, created on first use.
+ */
+ThreadRNG &ThreadRNG::get() {
+  thread_local ThreadRNG rng;
+  return rng;
+}
+
+/**
+ * Fill `output` with `size` random bytes. Small requests come out of the
+ * buffer; large ones are generated in place.
+ */
+void ThreadRNG::GenerateBlock(CryptoPP::byte *output, size_t size) {
+  if (size >= this->buffer.size()) {
+    this->prg.generate(output, size);
+    return;
+  }
+  while (size > 0) {
+    if (this->buffer_offset == this->buffer.size()) {
+      this->prg.generate(this->buffer, this->buffer.size());
+      this->buffer_offset = 0;
+    }
+    size_t n = std::min(size, this->buffer.size() - this->buffer_offset);
+    std::memcpy(output, this->buffer + this->buffer_offset, n);
+    this->buffer_offset += n;
+    output += n;
+    size -= n;
+  }
+}
+
+/**
+ * One random bit; eight bits are taken from each generated byte.
+ */
+bool ThreadRNG::random_bit() {
+  if (this->bits_left == 0) {
+    this->GenerateBlock(&this->bits, 1);
+    this->bits_left = 8;
+  }
+  bool bit = this->bits & 1;
+  this->bits >>= 1;
+  this->bits_left--;
+  return bit;
+}
@@ -0,0 +1,183 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "../include-shared/constants.hpp"
+#include "../include-shared/table_store.hpp"
+
+namespace {
+std::runtime_error spill_error(const std::string &what) {
+  return std::runtime_error("table spill file: " + what + ": " +
+                            std::strerror(errno));
+}
+} // namespace
+
+/**
+ * Constructor. Creates the spill file and unlinks it right away, so it goes
+ * away with the process however it exits.
+ * @param spill_dir Directory for the spill file.
+ * @param entry_length Bytes per table entry.
+ * @throws error if the file can't be created.
+ */
+TableStore::TableStore(std::string spill_dir, size_t entry_length)
+    : entry_size(entry_length), length(0), mapping(nullptr), read_offset(0),
+      advised_offset(0), released_offset(0) {
+  std::string path = spill_dir + "/yaos-tables-XXXXXX";
+  this->fd = mkstemp(path.data());
+  if (this->fd < 0) {
+    throw spill_error("create in " + spill_dir);
+  }
+  unlink(path.c_str());
+  this->write_buffer.reserve(TABLE_STORE_BUFFER_SIZE);
+}
+
+/**
+ * Destructor. Unmaps and closes the spill file, freeing its disk space.
+ */
+TableStore::~TableStore() {
+  if (this->mapping != nullptr) {
+    munmap(this->mapping, this->length);
+  }
+  close(this->fd);
+}
+
+/**
+ * Append one gate's table: num_entries entries of entry_length() bytes.
+ * @throws error if the gate has more entries than its count byte holds.
+ */
+void TableStore::append_entries(const unsigned char *entries,
+                                size_t num_entries) {
+  if (num_entries > UINT8_MAX) {
+    throw std::runtime_error("garbled table too large to spill");
+  }
+  size_t entries_length = num_entries * this->entry_size;
+  if (this->write_buffer.size() + 1 + entries_length >
+      TABLE_STORE_BUFFER_SIZE) {
+    this->flush();
+  }
+  this->write_buffer.push_back((unsigned char)num_entries);
+  this->append_bytes(entries, entries_length);
+}
+
+/**
+ * Append tables already in store format, e.g. a chunk from the garbler.
+ */
+void TableStore::append_bytes(const unsigned char *data, size_t length) {
+  if (this->write_buffer.size() + length > TABLE_STORE_BUFFER_SIZE) {
+    this->flush();
+  }
+  if (length > TABLE_STORE_BUFFER_SIZE) {
+    this->write_buffer.assign(data, data + length);
+    this->flush();
+    return;
+  }
+  this->write_buffer.insert(this->write_buffer.end(), data, data + length);
+}
+
+/**
+ * Write out the buffered tables.
+ */
+void TableStore::flush() {
+  size_t written = 0;
+  while (written < this->write_buffer.size()) {
+    ssize_t n = write(this->fd, this->write_buffer.data() + written,
+                      this->write_buffer.size() - written);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      throw spill_error("write");
+    }
+    written += n;
+  }
+  this->length += written;
+  this->write_buffer.clear();
+}
+
+/**
+ * Stop writing and map the file for reading, front to back.
+ * @throws error if the file can't be mapped.
+ */
+void TableStore::finish() {
+  this->flush();
+  this->write_buffer.shrink_to_fit();
+  if (this->length == 0) {
+    return;
+  }
+  void *mapping =
+      mmap(nullptr, this->length, PROT_READ, MAP_SHARED, this->fd, 0);
+  if (mapping == MAP_FAILED) {
+    throw spill_error("mmap");
+  }
+  this->mapping = (unsigned char *)mapping;
+  madvise(this->mapping, this->length, MADV_SEQUENTIAL);
+  this->advance(0);
+}
+
+/**
+ * Size of the stored tables in bytes.
+ */
+size_t TableStore::size() { return this->length + this->write_buffer.size(); }
+
+/**
+ * Bytes per table entry.
+ */
+size_t TableStore::entry_length() const { return this->entry_size; }
+
+/**
+ * Read the next gate's table: its entries, back to back, and their number.
+ * The entries stay valid until the following read.
+ * @throws error past the end of the tables.
+ */
+std::pair<const unsigned char *, size_t> TableStore::next_entries() {
+  if (this->read_offset >= this->length) {
+    throw std::runtime_error("read past the end of the garbled tables");
+  }
+  size_t num_entries = this->mapping[this->read_offset];
+  size_t record_length = 1 + num_entries * this->entry_size;
+  if (this->read_offset + record_length > this->length) {
+    throw std::runtime_error("truncated garbled table");
+  }
+  const unsigned char *entries = this->mapping + this->read_offset + 1;
+  this->advance(record_length);
+  return std::make_pair(entries, num_entries);
+}
+
+/**
+ * Next slice of at most max_length raw bytes, empty at the end. The slice
+ * stays valid until the following read.
+ */
+std::pair<const unsigned char *, size_t>
+TableStore::next_chunk(size_t max_length) {
+  size_t chunk_length = std::min(max_length, this->length - this->read_offset);
+  const unsigned char *chunk = this->mapping + this->read_offset;
+  this->advance(chunk_length);
+  return std::make_pair(chunk, chunk_length);
+}
+
+/**
+ * Move the read cursor: drop the pages already consumed, and ask for the next
+ * TABLE_STORE_READAHEAD bytes once the cursor is halfway through the last
+ * request.
+ */
+void TableStore::advance(size_t length) {
+  size_t page = sysconf(_SC_PAGESIZE);
+  size_t consumed = this->read_offset / page * page;
+  if (consumed >= this->released_offset + TABLE_STORE_READAHEAD) {
+    madvise(this->mapping + this->released_offset,
+            consumed - this->released_offset, MADV_DONTNEED);
+    this->released_offset = consumed;
+  }
+
+  this->read_offset += length;
+  if (this->read_offset + TABLE_STORE_READAHEAD / 2 >= this->advised_offset &&
+      this->advised_offset < this->length) {
+    readahead(this->fd, this->advised_offset, TABLE_STORE_READAHEAD);
+    this->advised_offset += TABLE_STORE_READAHEAD;
+  }
+}
@@ -1,4 +1,6 @@
+#include <fstream>
 #include <crypto++/osrng.h>
+#include "../include-shared/prg.hpp"
 #include "../include-shared/util.hpp"
 
 /**
@@ -69,7 +71,7 @@ CryptoPP::SecByteBlock string_to_byteblock(const std::string &s) {
 }
 
 bool random_bit() {
-  return (std::rand() % 2) == 0;
+  return ThreadRNG::get().random_bit();
 }
 
 /**
@@ -140,6 +142,31 @@ std::vector<int> parse_input(std::string input_file) {
   return res;
 }
 
+/**
+ * Parse many inputs to a circuit, one per non-empty line.
+ */
+std::vector<std::vector<int>> parse_inputs(std::string inputs_file) {
+  std::ifstream f(inputs_file);
+  if (!f) {
+    throw std::runtime_error("could not open inputs file " + inputs_file);
+  }
+
+  std::vector<std::vector<int>> res;
+  std::string line;
+  while (std::getline(f, line)) {
+    std::vector<int> input;
+    for (char c : line) {
+      if (c == '0' || c == '1') {
+        input.push_back(c - '0');
+      }
+    }
+    if (!input.empty()) {
+      res.push_back(input);
+    }
+  }
+  return res;
+}
+
 /*
  * Return the first bit of a SecByteBlock
  * */
@@ -0,0 +1,154 @@
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "../../include-shared/circuit.hpp"
+#include "../../include-shared/logger.hpp"
+#include "../../include/pkg/circuit_kernel.hpp"
+
+// Gates per generated function, so compilers don't choke on huge circuits.
+#define CODEGEN_GATES_PER_FUNCTION 4096
+
+namespace {
+/*
+ * Emit one pass (garble or evaluate) over the circuit's gates as a series of
+ * straight-line functions plus an entry point calling them in order. Table
+ * offsets follow KernelScheme's table sizes, as the interpreter's do.
+ */
+void emit_pass(std::ostream &out, const Circuit &circuit, bool garble) {
+  std::string pass = garble ? "garble" : "evaluate";
+  std::string tables = garble ? "KernelLabel *t" : "const KernelLabel *t";
+  int num_parts = 0;
+  size_t entry = 0;
+  for (int i = 0; i < circuit.num_gate; i++) {
+    if (i % CODEGEN_GATES_PER_FUNCTION == 0) {
+      if (i > 0) {
+        out << "}\n\n";
+      }
+      out << "void " << pass << "_" << num_parts++
+          << "(const KernelContext &ctx, KernelLabel *w, " << tables << ") {\n";
+    }
+    const Gate &gate = circuit.gates[i];
+    switch (gate.type) {
+    case GateType::XOR_GATE:
+      out << "  KernelScheme::" << pass << "_xor(ctx, w[" << gate.lhs
+          << "], w[" << gate.rhs << "], w[" << gate.output << "]);\n";
+      break;
+    case GateType::AND_GATE:
+      out << "  KernelScheme::" << pass << "_and(ctx, w[" << gate.lhs
+          << "], w[" << gate.rhs << "], w[" << gate.output << "], t + "
+          << entry << ", " << gate.output << ");\n";
+      break;
+    case GateType::NOT_GATE:
+      out << "  KernelScheme::" << pass << "_not(ctx, w[" << gate.lhs
+          << "], w[" << gate.output << "], t + " << entry << ", "
+          << gate.output << ");\n";
+      break;
+    case GateType::LUT_GATE: {
+      const LookupTable &lookup_table = circuit.lookup_tables[gate.lhs];
+      out << "  {\n    const KernelLabel in[] = {";
+      for (size_t j = 0; j < lookup_table.inputs.size(); j++) {
+        out << (j > 0 ? ", " : "") << "w[" << lookup_table.inputs[j] << "]";
+      }
+      out << "};\n    KernelScheme::" << pass << "_lut(ctx, in, "
+          << lookup_table.inputs.size() << ", ";
+      if (garble) {
+        out << "0x" << std::hex << lookup_table.truth_table << std::dec
+            << "ULL, ";
+      }
+      out << "w[" << gate.output << "], t + " << entry << ", " << gate.output
+          << ");\n  }\n";
+      break;
+    }
+    default:
+      throw std::runtime_error("unsupported gate type");
+    }
+    entry += gate_table_size<KernelScheme>(circuit, gate);
+  }
+  if (num_parts > 0) {
+    out << "}\n\n";
+  }
+
+  out << "void " << pass << "(const KernelContext &ctx, KernelLabel *w, "
+      << tables << ") {\n";
+  for (int i = 0; i < num_parts; i++) {
+    out << "  " << pass << "_" << i << "(ctx, w, t);\n";
+  }
+  out << "}\n\n";
+}
+} // namespace
+
+/*
+ * Usage: ./yaos_codegen <circuit file> <output file> <name>
+ *
+ * Compiles a circuit into C++ source for a CircuitKernel that registers
+ * itself at startup; link the output into a garbler or evaluator to have it
+ * used for that circuit instead of the interpreter.
+ */
+int main(int argc, char *argv[]) {
+  // Initialize logger
+  initLogger();
+
+  // Parse args
+  if (argc != 4) {
+    std::cout << "./yaos_codegen <circuit file> <output file> <name>"
+              << std::endl;
+    return 1;
+  }
+  std::string circuit_file = argv[1];
+  std::string output_file = argv[2];
+  std::string name = argv[3];
+
+  if (!std::ifstream(circuit_file)) {
+    std::cerr << "could not open " << circuit_file << std::endl;
+    return 1;
+  }
+  Circuit circuit = parse_circuit(circuit_file);
+  if (!circuit.branches.empty()) {
+    std::cerr << circuit_file << ": branches are not supported" << std::endl;
+    return 1;
+  }
+  for (auto &gate : circuit.gates) {
+    if (gate.type == GateType::LUT_GATE) {
+      // The parser checked the inputs; lhs indexes lookup_tables.
+      if (gate.output < 0 || gate.output >= circuit.num_wire) {
+        std::cerr << circuit_file << ": wire index out of range" << std::endl;
+        return 1;
+      }
+      continue;
+    }
+    if (gate.lhs < 0 || gate.lhs >= circuit.num_wire || gate.rhs < 0 ||
+        gate.rhs >= circuit.num_wire || gate.output < 0 ||
+        gate.output >= circuit.num_wire) {
+      std::cerr << circuit_file << ": wire index out of range" << std::endl;
+      return 1;
+    }
+  }
+
+  std::ofstream out(output_file);
+  if (!out) {
+    std::cerr << "could not open " << output_file << std::endl;
+    return 1;
+  }
+  out << "// Generated by yaos_codegen from " << circuit_file
+      << ". Do not edit.\n\n"
+      << "#include \"pkg/circuit_kernel.hpp\"\n\n"
+      << "namespace {\n";
+  emit_pass(out, circuit, true);
+  emit_pass(out, circuit, false);
+  out << "const CircuitKernel kernel_def = {\"" << name << "\", "
+      << circuit_fingerprint(circuit) << "ULL, " << circuit.num_gate << ", "
+      << circuit.num_wire << ", "
+      << count_table_entries<KernelScheme>(circuit)
+      << ", garble, evaluate};\n"
+      << "const CircuitKernelRegistration registration(&kernel_def);\n"
+      << "} // namespace\n";
+  out.close();
+  if (!out) {
+    std::cerr << "could not write " << output_file << std::endl;
+    return 1;
+  }
+  return 0;
+}
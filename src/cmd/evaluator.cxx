@@ -4,44 +4,141 @@
 #include <string>
 
 #include "../../include-shared/circuit.hpp"
+#include "../../include-shared/constants.hpp"
 #include "../../include-shared/logger.hpp"
 #include "../../include-shared/util.hpp"
+#include "../../include/drivers/emulated_network_driver.hpp"
+#include "../../include/drivers/shm_network_driver.hpp"
+#include "../../include/drivers/striped_network_driver.hpp"
 #include "../../include/pkg/evaluator.hpp"
 
 /*
  * Usage: ./yaos_evaluator <circuit file> <input file> <address> <port>
+ *    or: ./yaos_evaluator --session <jobs file> <address> <port>
+ *    or: ./yaos_evaluator --batch <circuit file> <inputs file> <address> <port>
+ *    or: ./yaos_evaluator <circuit file> <input file> <socket path>
+ *          [--connections <n>] [--transport <tcp|shm>] [--spill <dir>]
+ *          [--scheme <grr3|half-gates|classic|three-halves>]
+ *          [--netem <latency_ms>,<bandwidth_mbps>[,<jitter_ms>]]
  */
 int main(int argc, char *argv[]) {
   // Initialize logger
   initLogger();
 
   // Parse args
-  if (!(argc == 5)) {
-    std::cout
-        << "Usage: ./yaos_evaluator <circuit file> <input file> <address> <port>"
-        << std::endl;
+  std::vector<std::string> args;
+  int connections = 1;
+  std::string transport = "tcp";
+  std::string netem = "";
+  std::string session_file = "";
+  bool batch = false;
+  std::string spill_dir = "";
+  std::string scheme = "grr3";
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--connections" && i + 1 < argc) {
+      connections = atoi(argv[++i]);
+    } else if (arg == "--transport" && i + 1 < argc) {
+      transport = argv[++i];
+    } else if (arg == "--netem" && i + 1 < argc) {
+      netem = argv[++i];
+    } else if (arg == "--session" && i + 1 < argc) {
+      session_file = argv[++i];
+    } else if (arg == "--batch") {
+      batch = true;
+    } else if (arg == "--spill" && i + 1 < argc) {
+      spill_dir = argv[++i];
+    } else if (arg == "--scheme" && i + 1 < argc) {
+      scheme = argv[++i];
+    } else {
+      args.push_back(arg);
+    }
+  }
+  // In session mode circuits and inputs come from the jobs file.
+  size_t first_network_arg = session_file.empty() ? 2 : 0;
+  size_t num_network_args =
+      args.size() >= first_network_arg ? args.size() - first_network_arg : 0;
+  if (!(num_network_args == 1 || num_network_args == 2) || connections < 1 ||
+      !(transport == "tcp" || transport == "shm") ||
+      !(scheme == "grr3" || scheme == "half-gates" || scheme == "classic" ||
+        scheme == "three-halves") ||
+      (batch && !session_file.empty())) {
+    std::cout << "Usage: ./yaos_evaluator ([--batch] <circuit file> <input file> "
+                 "| --session <jobs file>) (<address> <port> | <socket path>) "
+                 "[--connections <n>] [--transport <tcp|shm>] [--spill <dir>] "
+                 "[--scheme <grr3|half-gates|classic|three-halves>] "
+                 "[--netem <latency_ms>,<bandwidth_mbps>[,<jitter_ms>]]"
+              << std::endl;
     return 1;
   }
-  std::string circuit_file = argv[1];
-  std::string input_file = argv[2];
-  std::string address = argv[3];
-  int port = atoi(argv[4]);
+  // A lone path instead of address and port selects a Unix domain socket.
+  std::string address = args[first_network_arg];
+  int port = num_network_args == 2 ? std::stoi(args[first_network_arg + 1]) : 0;
 
-  // Parse circuit.
-  Circuit circuit = parse_circuit(circuit_file);
+  // Parse circuits and inputs.
+  std::vector<EvaluationJob> jobs;
+  std::vector<std::vector<int>> batch_inputs;
+  if (session_file.empty()) {
+    EvaluationJob job;
+    job.circuit = std::make_shared<const Circuit>(parse_circuit(args[0]));
+    if (batch) {
+      batch_inputs = parse_inputs(args[1]);
+      if (batch_inputs.empty()) {
+        std::cout << "No inputs in " << args[1] << std::endl;
+        return 1;
+      }
+      job.input = batch_inputs[0];
+    } else {
+      job.input = parse_input(args[1]);
+    }
+    jobs.push_back(job);
+  } else {
+    jobs = parse_jobs(session_file);
+    if (jobs.empty()) {
+      std::cout << "No jobs in " << session_file << std::endl;
+      return 1;
+    }
+  }
+  const Circuit &circuit = *jobs[0].circuit;
 
-  // Parse input.
-  std::vector<int> input = parse_input(input_file);
+  // Precompute DH keypairs (key exchange + input OTs) while connecting.
+  std::shared_ptr<CryptoDriver> crypto_driver =
+      std::make_shared<CryptoDriver>();
+  crypto_driver->DH_precompute(session_file.empty() && !batch
+                                    ? 1 + circuit.evaluator_input_length
+                                    : 1 + OT_EXTENSION_WIDTH);
 
   // Connect to network driver.
-  std::shared_ptr<NetworkDriver> network_driver =
-      std::make_shared<NetworkDriverImpl>();
+  std::shared_ptr<NetworkDriver> network_driver;
+  if (num_network_args == 1) {
+    network_driver = std::make_shared<UnixNetworkDriverImpl>(address);
+  } else if (transport == "shm") {
+    network_driver = std::make_shared<ShmNetworkDriverImpl>();
+  } else if (connections > 1) {
+    network_driver = std::make_shared<StripedNetworkDriverImpl>(connections);
+  } else {
+    network_driver = std::make_shared<AsyncNetworkDriverImpl>();
+  }
+  if (!netem.empty()) {
+    network_driver = std::make_shared<EmulatedNetworkDriver>(
+        network_driver, parse_network_profile(netem));
+  }
   network_driver->connect(address, port);
-  std::shared_ptr<CryptoDriver> crypto_driver =
-      std::make_shared<CryptoDriver>();
 
   // Create garbler then run.
-  EvaluatorClient evaluator = EvaluatorClient(circuit, network_driver, crypto_driver);
-  evaluator.run(input);
+  EvaluatorClient evaluator =
+      EvaluatorClient(jobs[0].circuit, network_driver, crypto_driver);
+  evaluator.set_spill_dir(spill_dir);
+  evaluator.set_scheme(scheme == "half-gates"     ? SchemeType::HALF_GATES
+                       : scheme == "classic"      ? SchemeType::CLASSIC
+                       : scheme == "three-halves" ? SchemeType::THREE_HALVES
+                                                  : SchemeType::GRR3);
+  if (batch) {
+    evaluator.run_batch(batch_inputs);
+  } else if (session_file.empty()) {
+    evaluator.run(jobs[0].input);
+  } else {
+    evaluator.run_session(jobs);
+  }
   return 0;
 }
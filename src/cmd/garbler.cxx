@@ -1,47 +1,196 @@
+#include <algorithm>
 #include <cmath>
 #include <cstdlib>
 #include <iostream>
 #include <string>
+#include <thread>
 
 #include "../../include-shared/circuit.hpp"
+#include "../../include-shared/constants.hpp"
 #include "../../include-shared/logger.hpp"
 #include "../../include-shared/util.hpp"
+#include "../../include/drivers/emulated_network_driver.hpp"
+#include "../../include/drivers/shm_network_driver.hpp"
+#include "../../include/drivers/striped_network_driver.hpp"
 #include "../../include/pkg/garbler.hpp"
+#include "../../include/pkg/garbler_server.hpp"
 
 /*
  * Usage: ./yaos_garbler <circuit file> <input file> <address> <port>
+ *    or: ./yaos_garbler --session <jobs file> <address> <port>
+ *    or: ./yaos_garbler --batch <circuit file> <inputs file> <address> <port>
+ *    or: ./yaos_garbler <circuit file> <input file> <socket path>
+ *          [--connections <n>] [--transport <tcp|shm>] [--seeded-labels]
+ *          [--spill <dir>]
+ *          [--scheme <grr3|half-gates|classic|three-halves>]
+ *          [--netem <latency_ms>,<bandwidth_mbps>[,<jitter_ms>]]
+ *          [--serve [--max-sessions <n>] [--memory-limit <MiB>]
+ *                   [--pool <n>] [--pool-memory <MiB>]
+ *                   [--session-timeout <seconds>]]
+ *
+ * --serve accepts plain TCP connections on one port, so it takes none of the
+ * transport, striping, emulation, seeding, spilling or scheme options.
  */
 int main(int argc, char *argv[]) {
   // Initialize logger
   initLogger();
 
   // Parse args
-  if (!(argc == 5)) {
-    std::cout
-        << "Usage: ./yaos_garbler <circuit file> <input file> <address> <port>"
-        << std::endl;
+  std::vector<std::string> args;
+  int connections = 1;
+  std::string transport = "tcp";
+  std::string netem = "";
+  std::string session_file = "";
+  bool batch = false;
+  bool seeded_labels = false;
+  std::string spill_dir = "";
+  std::string scheme = "grr3";
+  bool serve = false;
+  int max_sessions = std::max(1u, std::thread::hardware_concurrency());
+  size_t memory_limit_mib = 0;
+  size_t pool_depth = 0;
+  size_t pool_memory_mib = 0;
+  int session_timeout_s = SESSION_TIMEOUT_MS / 1000;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--connections" && i + 1 < argc) {
+      connections = atoi(argv[++i]);
+    } else if (arg == "--transport" && i + 1 < argc) {
+      transport = argv[++i];
+    } else if (arg == "--netem" && i + 1 < argc) {
+      netem = argv[++i];
+    } else if (arg == "--session" && i + 1 < argc) {
+      session_file = argv[++i];
+    } else if (arg == "--batch") {
+      batch = true;
+    } else if (arg == "--seeded-labels") {
+      seeded_labels = true;
+    } else if (arg == "--spill" && i + 1 < argc) {
+      spill_dir = argv[++i];
+    } else if (arg == "--scheme" && i + 1 < argc) {
+      scheme = argv[++i];
+    } else if (arg == "--serve") {
+      serve = true;
+    } else if (arg == "--max-sessions" && i + 1 < argc) {
+      max_sessions = atoi(argv[++i]);
+    } else if (arg == "--memory-limit" && i + 1 < argc) {
+      memory_limit_mib = std::stoull(argv[++i]);
+    } else if (arg == "--pool" && i + 1 < argc) {
+      pool_depth = std::stoull(argv[++i]);
+    } else if (arg == "--pool-memory" && i + 1 < argc) {
+      pool_memory_mib = std::stoull(argv[++i]);
+    } else if (arg == "--session-timeout" && i + 1 < argc) {
+      session_timeout_s = atoi(argv[++i]);
+    } else {
+      args.push_back(arg);
+    }
+  }
+  // In session mode circuits and inputs come from the jobs file.
+  size_t first_network_arg = session_file.empty() ? 2 : 0;
+  size_t num_network_args =
+      args.size() >= first_network_arg ? args.size() - first_network_arg : 0;
+  if (!(num_network_args == 1 || num_network_args == 2) || connections < 1 ||
+      !(transport == "tcp" || transport == "shm") ||
+      !(scheme == "grr3" || scheme == "half-gates" || scheme == "classic" ||
+        scheme == "three-halves") ||
+      (batch && !session_file.empty()) ||
+      (serve && (num_network_args != 2 || !session_file.empty() || batch)) ||
+      (!serve && pool_depth > 0) ||
+      (serve && (seeded_labels || !spill_dir.empty() || scheme != "grr3")) ||
+      (serve && (transport != "tcp" || connections != 1 || !netem.empty())) ||
+      max_sessions < 1 || session_timeout_s < 1) {
+    std::cout << "Usage: ./yaos_garbler ([--batch] <circuit file> <input file> "
+                 "| --session <jobs file>) (<address> <port> | <socket path>) "
+                 "[--connections <n>] [--transport <tcp|shm>] [--seeded-labels] "
+                 "[--spill <dir>] "
+                 "[--scheme <grr3|half-gates|classic|three-halves>] "
+                 "[--netem <latency_ms>,<bandwidth_mbps>[,<jitter_ms>]] [--serve "
+                 "[--max-sessions <n>] [--memory-limit <MiB>] [--pool <n>] "
+                 "[--pool-memory <MiB>] [--session-timeout <seconds>]]"
+              << std::endl;
     return 1;
   }
-  std::string circuit_file = argv[1];
-  std::string input_file = argv[2];
-  std::string address = argv[3];
-  int port = atoi(argv[4]);
+  // A lone path instead of address and port selects a Unix domain socket.
+  std::string address = args[first_network_arg];
+  int port = num_network_args == 2 ? std::stoi(args[first_network_arg + 1]) : 0;
 
-  // Parse circuit.
-  Circuit circuit = parse_circuit(circuit_file);
+  // Parse circuits and inputs.
+  std::vector<EvaluationJob> jobs;
+  std::vector<std::vector<int>> batch_inputs;
+  if (session_file.empty()) {
+    EvaluationJob job;
+    job.circuit = std::make_shared<const Circuit>(parse_circuit(args[0]));
+    if (batch) {
+      batch_inputs = parse_inputs(args[1]);
+      if (batch_inputs.empty()) {
+        std::cout << "No inputs in " << args[1] << std::endl;
+        return 1;
+      }
+      job.input = batch_inputs[0];
+    } else {
+      job.input = parse_input(args[1]);
+    }
+    jobs.push_back(job);
+  } else {
+    jobs = parse_jobs(session_file);
+    if (jobs.empty()) {
+      std::cout << "No jobs in " << session_file << std::endl;
+      return 1;
+    }
+  }
+  const Circuit &circuit = *jobs[0].circuit;
 
-  // Parse input.
-  std::vector<int> input = parse_input(input_file);
+  // Server mode: garble for every evaluator that connects, sharing the
+  // parsed circuit and, with --pool, circuits garbled ahead of time.
+  if (serve) {
+    GarblerServer server(jobs[0].circuit, jobs[0].input, max_sessions,
+                         memory_limit_mib << 20, pool_depth,
+                         pool_memory_mib << 20,
+                         std::chrono::seconds(session_timeout_s));
+    server.serve(port);
+    return 0;
+  }
 
-  // Connect to network driver.
-  std::shared_ptr<NetworkDriver> network_driver =
-      std::make_shared<NetworkDriverImpl>();
-  network_driver->listen(port);
+  // Precompute DH keypairs (key exchange + input OTs) while connecting.
   std::shared_ptr<CryptoDriver> crypto_driver =
       std::make_shared<CryptoDriver>();
+  crypto_driver->DH_precompute(session_file.empty() && !batch
+                                    ? 1 + circuit.evaluator_input_length
+                                    : 1 + OT_EXTENSION_WIDTH);
 
-  // Create garbler then run.
-  GarblerClient garbler = GarblerClient(circuit, network_driver, crypto_driver);
-  garbler.run(input);
+  // Create garbler and start garbling while waiting for the evaluator.
+  std::shared_ptr<NetworkDriver> network_driver;
+  if (num_network_args == 1) {
+    network_driver = std::make_shared<UnixNetworkDriverImpl>(address);
+  } else if (transport == "shm") {
+    network_driver = std::make_shared<ShmNetworkDriverImpl>();
+  } else if (connections > 1) {
+    network_driver = std::make_shared<StripedNetworkDriverImpl>(connections);
+  } else {
+    network_driver = std::make_shared<AsyncNetworkDriverImpl>();
+  }
+  if (!netem.empty()) {
+    network_driver = std::make_shared<EmulatedNetworkDriver>(
+        network_driver, parse_network_profile(netem));
+  }
+  GarblerClient garbler =
+      GarblerClient(jobs[0].circuit, network_driver, crypto_driver);
+  garbler.set_seeded_labels(seeded_labels);
+  garbler.set_spill_dir(spill_dir);
+  garbler.set_scheme(scheme == "half-gates"     ? SchemeType::HALF_GATES
+                     : scheme == "classic"      ? SchemeType::CLASSIC
+                     : scheme == "three-halves" ? SchemeType::THREE_HALVES
+                                                : SchemeType::GRR3);
+  garbler.start_garbling();
+
+  // Connect to network driver, then run.
+  network_driver->listen(port);
+  if (batch) {
+    garbler.run_batch(batch_inputs);
+  } else if (session_file.empty()) {
+    garbler.run(jobs[0].input);
+  } else {
+    garbler.run_session(jobs);
+  }
   return 0;
 }
@@ -13,11 +13,27 @@
 #include <crypto++/queue.h>
 
 #include "../../include-shared/constants.hpp"
+#include "../../include-shared/prg.hpp"
 #include "../../include-shared/util.hpp"
 #include "../../include/drivers/crypto_driver.hpp"
 
 using namespace CryptoPP;
 
+/**
+ * @brief Constructor.
+ */
+CryptoDriver::CryptoDriver() : DH_pool_stop(false) {}
+
+/**
+ * @brief Destructor. Stops and joins any keypair precomputation threads.
+ */
+CryptoDriver::~CryptoDriver() {
+  this->DH_pool_stop = true;
+  for (auto &thread : this->DH_pool_threads) {
+    thread.join();
+  }
+}
+
 /**
  * @brief Encrypts the given message using AES and tags the ciphertext with an
  * HMAC. Outputs an HMACTagged_Wrapper as bytes.
@@ -28,7 +44,16 @@ CryptoDriver::encrypt_and_tag(SecByteBlock AES_key, SecByteBlock HMAC_key,
   // Serialize given message.
   std::vector<unsigned char> plaintext;
   message->serialize(plaintext);
+  return this->encrypt_and_tag(AES_key, HMAC_key, plaintext);
+}
 
+/**
+ * @brief Encrypts and tags an already serialized message, e.g. one prepared
+ * ahead of time. Returns an HMACTagged_Wrapper as bytes.
+ */
+std::vector<unsigned char>
+CryptoDriver::encrypt_and_tag(SecByteBlock AES_key, SecByteBlock HMAC_key,
+                              const std::vector<unsigned char> &plaintext) {
   // Encrypt the payload, generate iv to hmac.
   std::pair<std::string, SecByteBlock> encrypted =
       this->AES_encrypt(AES_key, chvec2str(plaintext));
@@ -72,16 +97,114 @@ CryptoDriver::decrypt_and_verify(SecByteBlock AES_key, SecByteBlock HMAC_key,
   return std::make_pair(plaintext_data, valid);
 }
 
+namespace {
+/**
+ * @brief Process-wide DH domain with a fixed-base window table for DL_G.
+ * Built once on first use and never used directly; callers take a copy so
+ * that each gets its own Montgomery workspace.
+ */
+const DH &precomputed_DH() {
+  static const DH DH_obj = [] {
+    DH obj(DL_P, DL_Q, DL_G);
+    obj.AccessGroupParameters().Precompute(DH_PRECOMPUTATION_STORAGE);
+    return obj;
+  }();
+  return DH_obj;
+}
+} // namespace
+
+/**
+ * @brief Starts generating `count` DH keypairs on a background thread, e.g.
+ * while waiting for the peer to connect. DH_initialize and
+ * DH_initialize_batch take keypairs from this pool before generating their
+ * own.
+ */
+void CryptoDriver::DH_precompute(int count) {
+  this->DH_pool_threads.emplace_back([this, count]() {
+    DH DH_obj(precomputed_DH());
+    ThreadRNG &prng = ThreadRNG::get();
+    for (int i = 0; i < count && !this->DH_pool_stop; i++) {
+      SecByteBlock DH_private_key(DH_obj.PrivateKeyLength());
+      SecByteBlock DH_public_key(DH_obj.PublicKeyLength());
+      DH_obj.GenerateKeyPair(prng, DH_private_key, DH_public_key);
+      std::lock_guard<std::mutex> lock(this->DH_pool_mutex);
+      this->DH_pool.push_back(std::make_pair(DH_private_key, DH_public_key));
+    }
+  });
+}
+
 /**
  * @brief Generate DH keypair.
  */
 std::tuple<DH, SecByteBlock, SecByteBlock> CryptoDriver::DH_initialize() {
-  DH DH_obj(DL_P, DL_Q, DL_G);
-  AutoSeededRandomPool prng;
-  SecByteBlock DH_private_key(DH_obj.PrivateKeyLength());
-  SecByteBlock DH_public_key(DH_obj.PublicKeyLength());
-  DH_obj.GenerateKeyPair(prng, DH_private_key, DH_public_key);
-  return std::make_tuple(DH_obj, DH_private_key, DH_public_key);
+  auto batch = this->DH_initialize_batch(1);
+  return std::make_tuple(std::get<0>(batch), std::get<1>(batch)[0],
+                         std::get<2>(batch)[0]);
+}
+
+/**
+ * @brief Generate `count` DH keypairs sharing one copy of the precomputed
+ * domain. Keypairs already in the precomputation pool are used first.
+ */
+std::tuple<DH, std::vector<SecByteBlock>, std::vector<SecByteBlock>>
+CryptoDriver::DH_initialize_batch(size_t count) {
+  DH DH_obj(precomputed_DH());
+  std::vector<SecByteBlock> DH_private_keys;
+  std::vector<SecByteBlock> DH_public_keys;
+  {
+    std::lock_guard<std::mutex> lock(this->DH_pool_mutex);
+    while (DH_private_keys.size() < count && !this->DH_pool.empty()) {
+      DH_private_keys.push_back(this->DH_pool.front().first);
+      DH_public_keys.push_back(this->DH_pool.front().second);
+      this->DH_pool.pop_front();
+    }
+  }
+
+  ThreadRNG &prng = ThreadRNG::get();
+  while (DH_private_keys.size() < count) {
+    SecByteBlock DH_private_key(DH_obj.PrivateKeyLength());
+    SecByteBlock DH_public_key(DH_obj.PublicKeyLength());
+    DH_obj.GenerateKeyPair(prng, DH_private_key, DH_public_key);
+    DH_private_keys.push_back(DH_private_key);
+    DH_public_keys.push_back(DH_public_key);
+  }
+  return std::make_tuple(DH_obj, DH_private_keys, DH_public_keys);
+}
+
+/**
+ * @brief Computes numerators[i] / denominators[i] mod DL_P for every i using
+ * Montgomery's simultaneous inversion: one modular inversion for the whole
+ * batch, with all intermediate products kept in Montgomery form.
+ */
+std::vector<SecByteBlock>
+CryptoDriver::DL_divide_batch(const std::vector<SecByteBlock> &numerators,
+                              const std::vector<SecByteBlock> &denominators) {
+  if (numerators.size() != denominators.size()) {
+    throw std::runtime_error("DL_divide_batch: mismatched batch sizes");
+  }
+  size_t n = denominators.size();
+  MontgomeryRepresentation mr(DL_P);
+
+  // prefix[i] = d_0 * ... * d_{i-1}
+  std::vector<Integer> d(n);
+  std::vector<Integer> prefix(n);
+  Integer acc = mr.MultiplicativeIdentity();
+  for (size_t i = 0; i < n; i++) {
+    d[i] = mr.ConvertIn(byteblock_to_integer(denominators[i]));
+    prefix[i] = acc;
+    acc = mr.Multiply(acc, d[i]);
+  }
+
+  // Walk back from (d_0 * ... * d_{n-1})^-1, peeling off one d_i per step.
+  Integer inv = mr.MultiplicativeInverse(acc);
+  std::vector<SecByteBlock> quotients(n);
+  for (size_t i = n; i-- > 0;) {
+    Integer d_inv = mr.Multiply(inv, prefix[i]);
+    inv = mr.Multiply(inv, d[i]);
+    Integer num = mr.ConvertIn(byteblock_to_integer(numerators[i]));
+    quotients[i] = integer_to_byteblock(mr.ConvertOut(mr.Multiply(num, d_inv)));
+  }
+  return quotients;
 }
 
 /**
@@ -130,7 +253,7 @@ CryptoDriver::AES_encrypt(SecByteBlock key, std::string plaintext) {
     CBC_Mode<AES>::Encryption AES_encryptor = CBC_Mode<AES>::Encryption();
 
     SecByteBlock iv(AES::BLOCKSIZE);
-    AutoSeededRandomPool rng;
+    ThreadRNG &rng = ThreadRNG::get();
     AES_encryptor.GetNextIV(rng, iv.BytePtr());
     AES_encryptor.SetKeyWithIV(key, key.size(), iv);
 
@@ -226,11 +349,11 @@ bool CryptoDriver::HMAC_verify(SecByteBlock key, std::string ciphertext,
 /**
  * Hash inputs. SHA256(lhs || rhs)
  */
-CryptoPP::SecByteBlock CryptoDriver::hash_inputs(CryptoPP::SecByteBlock &lhs, CryptoPP::SecByteBlock &rhs) {
+CryptoPP::SecByteBlock CryptoDriver::hash_inputs(const CryptoPP::SecByteBlock &lhs, const CryptoPP::SecByteBlock &rhs) {
   CryptoPP::SHA256 hash;
   CryptoPP::SecByteBlock digest(hash.DigestSize());
-  CryptoPP::SecByteBlock appended = lhs + rhs;
-  hash.Update(appended.BytePtr(), appended.size());
+  hash.Update(lhs.BytePtr(), lhs.size());
+  hash.Update(rhs.BytePtr(), rhs.size());
   hash.Final(digest.BytePtr());
   return digest;
 }
@@ -0,0 +1,112 @@
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include "../../include/drivers/emulated_network_driver.hpp"
+
+using std::chrono::steady_clock;
+
+/**
+ * Parses "<latency_ms>,<bandwidth_mbps>[,<jitter_ms>]".
+ * @throws error on malformed input.
+ */
+NetworkProfile parse_network_profile(std::string spec) {
+  NetworkProfile profile = {0, 0, 0};
+  std::stringstream stream(spec);
+  char comma;
+  if (!(stream >> profile.latency_ms >> comma >> profile.bandwidth_mbps) ||
+      comma != ',') {
+    throw std::runtime_error("malformed network profile: " + spec);
+  }
+  if (stream >> comma && !(comma == ',' && stream >> profile.jitter_ms)) {
+    throw std::runtime_error("malformed network profile: " + spec);
+  }
+  if (profile.latency_ms < 0 || profile.bandwidth_mbps < 0 ||
+      profile.jitter_ms < 0) {
+    throw std::runtime_error("malformed network profile: " + spec);
+  }
+  return profile;
+}
+
+/**
+ * Constructor.
+ * @param inner Driver that actually carries the messages.
+ * @param profile Characteristics of the emulated link.
+ */
+EmulatedNetworkDriver::EmulatedNetworkDriver(
+    std::shared_ptr<NetworkDriver> inner, NetworkProfile profile)
+    : inner(inner), profile(profile), jitter_rng(std::random_device()()),
+      link_free_at(steady_clock::now()), last_delivery(steady_clock::now()) {}
+
+void EmulatedNetworkDriver::listen(int port) { this->inner->listen(port); }
+
+void EmulatedNetworkDriver::connect(std::string address, int port) {
+  this->inner->connect(address, port);
+}
+
+void EmulatedNetworkDriver::disconnect() { this->inner->disconnect(); }
+
+/**
+ * Computes when the message would arrive and sends it stamped with that
+ * time. The message is handed to the inner driver right away.
+ * @param data Bytes of data to send.
+ */
+void EmulatedNetworkDriver::send(const std::vector<unsigned char> &data) {
+  auto now = steady_clock::now();
+
+  // Serialization delay: the link carries one message at a time.
+  auto start = std::max(now, this->link_free_at);
+  if (this->profile.bandwidth_mbps > 0) {
+    double seconds =
+        (8.0 * data.size()) / (this->profile.bandwidth_mbps * 1e6);
+    this->link_free_at =
+        start + std::chrono::duration_cast<steady_clock::duration>(
+                    std::chrono::duration<double>(seconds));
+  } else {
+    this->link_free_at = start;
+  }
+
+  // Propagation delay plus jitter, keeping FIFO order.
+  double delay_ms = this->profile.latency_ms;
+  if (this->profile.jitter_ms > 0) {
+    std::uniform_real_distribution<double> jitter(0, this->profile.jitter_ms);
+    delay_ms += jitter(this->jitter_rng);
+  }
+  auto deliver_at =
+      this->link_free_at +
+      std::chrono::duration_cast<steady_clock::duration>(
+          std::chrono::duration<double, std::milli>(delay_ms));
+  deliver_at = std::max(deliver_at, this->last_delivery);
+  this->last_delivery = deliver_at;
+
+  uint64_t stamp = htobe64(deliver_at.time_since_epoch().count());
+  std::vector<unsigned char> stamped(sizeof(uint64_t) + data.size());
+  std::memcpy(stamped.data(), &stamp, sizeof(uint64_t));
+  std::memcpy(stamped.data() + sizeof(uint64_t), data.data(), data.size());
+  this->inner->send(std::move(stamped));
+}
+
+/**
+ * Reads the next message and holds it until its arrival time.
+ * @return std::vector<unsigned char> data read.
+ * @throws error when eof.
+ */
+std::vector<unsigned char> EmulatedNetworkDriver::read() {
+  std::vector<unsigned char> stamped = this->inner->read();
+  if (stamped.size() < sizeof(uint64_t)) {
+    throw std::runtime_error("Received malformed message.");
+  }
+  uint64_t stamp;
+  std::memcpy(&stamp, stamped.data(), sizeof(uint64_t));
+  std::this_thread::sleep_until(
+      steady_clock::time_point(steady_clock::duration(be64toh(stamp))));
+  return std::vector<unsigned char>(stamped.begin() + sizeof(uint64_t),
+                                    stamped.end());
+}
+
+/**
+ * Get inner driver info as string.
+ */
+std::string EmulatedNetworkDriver::get_remote_info() {
+  return this->inner->get_remote_info() + " (emulated)";
+}
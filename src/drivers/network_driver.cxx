@@ -1,4 +1,13 @@
+#include <cerrno>
+#include <climits>
+#include <netinet/in.h>
+#include <poll.h>
 #include <stdexcept>
+#include <sys/socket.h>
+#include <unistd.h>
+#ifdef SO_ZEROCOPY
+#include <linux/errqueue.h>
+#endif
 #include <vector>
 
 #include "../../include/drivers/network_driver.hpp"
@@ -6,10 +15,218 @@
 using namespace boost::asio;
 using ip::tcp;
 
+// ================================================
+// FRAMING
+// ================================================
+
+/**
+ * Builds the buffer sequence for the given frames: each frame's length
+ * header followed by its payload. `headers` must outlive the write.
+ */
+std::vector<boost::asio::const_buffer>
+gather_frames(const std::vector<const std::vector<unsigned char> *> &frames,
+              std::vector<uint64_t> &headers) {
+  headers.resize(frames.size());
+  std::vector<boost::asio::const_buffer> buffers;
+  for (size_t i = 0; i < frames.size(); i++) {
+    headers[i] = htobe64(frames[i]->size());
+    buffers.push_back(boost::asio::buffer(&headers[i], sizeof(uint64_t)));
+    buffers.push_back(boost::asio::buffer(*frames[i]));
+  }
+  return buffers;
+}
+
+#ifdef SO_ZEROCOPY
+/**
+ * Writes the frames (each length header and payload) with one gathered
+ * MSG_ZEROCOPY send, so the kernel sends straight from the payloads instead
+ * of copying them, then waits for the completion notifications so the caller
+ * may free or reuse them. Works on blocking and non-blocking sockets.
+ * @return false, having written nothing, if zerocopy isn't worthwhile or
+ * available; the caller should fall back to a regular write.
+ * @throws error if the write fails.
+ */
+bool write_frames_zerocopy(int fd,
+                           const std::vector<std::vector<unsigned char>> &frames,
+                           ZerocopyState &state) {
+  size_t payload = 0;
+  for (auto &frame : frames) {
+    payload += frame.size();
+  }
+  if (state.unavailable || payload < ZEROCOPY_THRESHOLD) {
+    return false;
+  }
+  if (!state.enabled) {
+    int one = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one)) != 0) {
+      state.unavailable = true;
+      return false;
+    }
+    state.enabled = true;
+  }
+
+  std::vector<uint64_t> headers(frames.size());
+  std::vector<struct iovec> parts;
+  for (size_t i = 0; i < frames.size(); i++) {
+    headers[i] = htobe64(frames[i].size());
+    parts.push_back({&headers[i], sizeof(uint64_t)});
+    parts.push_back({const_cast<unsigned char *>(frames[i].data()),
+                     frames[i].size()});
+  }
+  size_t total = frames.size() * sizeof(uint64_t) + payload;
+  uint32_t first_id = state.next_id;
+  std::vector<struct iovec> remaining;
+  for (size_t sent = 0; sent < total;) {
+    // Skip what has already gone out.
+    remaining.clear();
+    size_t skip = sent;
+    for (auto &part : parts) {
+      if (skip >= part.iov_len) {
+        skip -= part.iov_len;
+        continue;
+      }
+      remaining.push_back(
+          {static_cast<char *>(part.iov_base) + skip, part.iov_len - skip});
+      skip = 0;
+    }
+    struct msghdr msg = {};
+    msg.msg_iov = remaining.data();
+    msg.msg_iovlen = std::min<size_t>(remaining.size(), IOV_MAX);
+    ssize_t n = sendmsg(fd, &msg, MSG_ZEROCOPY | MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // ENOBUFS means too many pages are pinned; wait for some to drain.
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
+        struct pollfd wait = {fd, POLLOUT, 0};
+        poll(&wait, 1, 100);
+        continue;
+      }
+      throw std::runtime_error("Failed to send: zerocopy write failed.");
+    }
+    sent += n;
+    state.next_id++;
+  }
+
+  // Each successful sendmsg above completes with one id, reported on the
+  // error queue in ranges.
+  uint32_t outstanding = state.next_id - first_id;
+  bool copied = false;
+  while (outstanding > 0) {
+    char control[128];
+    struct msghdr msg = {};
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(fd, &msg, MSG_ERRQUEUE) < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        struct pollfd wait = {fd, 0, 0}; // POLLERR is always reported
+        poll(&wait, 1, 100);
+        continue;
+      }
+      throw std::runtime_error("Failed to send: no zerocopy completion.");
+    }
+    for (struct cmsghdr *cm = CMSG_FIRSTHDR(&msg); cm;
+         cm = CMSG_NXTHDR(&msg, cm)) {
+      if (!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+            (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))) {
+        continue;
+      }
+      auto *err = reinterpret_cast<struct sock_extended_err *>(CMSG_DATA(cm));
+      if (err->ee_origin != SO_EE_ORIGIN_ZEROCOPY || err->ee_errno != 0) {
+        continue;
+      }
+      outstanding -= err->ee_data - err->ee_info + 1;
+      copied |= (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0;
+    }
+  }
+
+  // The kernel copied anyway (e.g. over loopback); plain writes are cheaper.
+  if (copied) {
+    state.unavailable = true;
+  }
+  return true;
+}
+#else
+bool write_frames_zerocopy(
+    [[maybe_unused]] int fd,
+    [[maybe_unused]] const std::vector<std::vector<unsigned char>> &frames,
+    [[maybe_unused]] ZerocopyState &state) {
+  return false;
+}
+#endif
+
+/**
+ * Sends data the caller no longer needs. Drivers that queue writes override
+ * this to take the buffer instead of copying it.
+ * @param data Bytes of data to send.
+ */
+void NetworkDriver::send(std::vector<unsigned char> &&data) {
+  this->send(static_cast<const std::vector<unsigned char> &>(data));
+}
+
+/**
+ * Sends each frame in order. Drivers that can coalesce frames override this.
+ * @param frames Messages to send.
+ */
+void NetworkDriver::send_frames(
+    const std::vector<std::vector<unsigned char>> &frames) {
+  for (auto &frame : frames) {
+    this->send(frame);
+  }
+}
+
+/**
+ * Sends frames the caller no longer needs. Drivers that queue writes
+ * override this to take the buffers instead of copying them.
+ * @param frames Messages to send.
+ */
+void NetworkDriver::send_frames(
+    std::vector<std::vector<unsigned char>> &&frames) {
+  this->send_frames(
+      static_cast<const std::vector<std::vector<unsigned char>> &>(frames));
+}
+
+/**
+ * Sends large, write-once messages. Drivers that can send without copying
+ * override this.
+ * @param frames Messages to send.
+ */
+void NetworkDriver::send_zerocopy(
+    std::vector<std::vector<unsigned char>> frames) {
+  this->send_frames(std::move(frames));
+}
+
+/**
+ * Waits up to the timeout for the socket to become readable or writable.
+ * @return false, with error set to timed_out or the poll error, if it didn't.
+ */
+bool TimedSocket::wait_ready(bool write, boost::system::error_code &error) {
+  struct pollfd fd = {this->socket.native_handle(),
+                      (short)(write ? POLLOUT : POLLIN), 0};
+  int ready;
+  do {
+    ready = poll(&fd, 1, this->timeout.count());
+  } while (ready < 0 && errno == EINTR);
+  if (ready < 0) {
+    error = boost::system::error_code(errno, boost::system::system_category());
+    return false;
+  }
+  if (ready == 0) {
+    error = boost::asio::error::timed_out;
+    return false;
+  }
+  return true;
+}
+
+// ================================================
+// NETWORK DRIVER
+// ================================================
+
 /**
  * Constructor. Sets up IO context and socket.
  */
-NetworkDriverImpl::NetworkDriverImpl() : io_context() {
+NetworkDriverImpl::NetworkDriverImpl() : io_context(), timeout(0) {
   this->socket = std::make_shared<tcp::socket>(io_context);
 }
 
@@ -19,7 +236,17 @@ NetworkDriverImpl::NetworkDriverImpl() : io_context() {
  */
 void NetworkDriverImpl::listen(int port) {
   tcp::acceptor acceptor(this->io_context, tcp::endpoint(tcp::v4(), port));
+  this->accept(acceptor);
+}
+
+/**
+ * Accept the next connection on an acceptor owned by the caller, so one
+ * listening socket can serve many drivers.
+ * @param acceptor Listening acceptor.
+ */
+void NetworkDriverImpl::accept(tcp::acceptor &acceptor) {
   acceptor.accept(*this->socket);
+  this->socket->set_option(tcp::no_delay(true));
 }
 
 /**
@@ -32,6 +259,7 @@ void NetworkDriverImpl::connect(std::string address, int port) {
     address = "127.0.0.1";
   this->socket->connect(
       tcp::endpoint(boost::asio::ip::address::from_string(address), port));
+  this->socket->set_option(tcp::no_delay(true));
 }
 
 /**
@@ -44,40 +272,71 @@ void NetworkDriverImpl::disconnect() {
 }
 
 /**
- * Sends a fixed amount of data by sending length first.
+ * Sends a fixed amount of data by sending length first, in one write.
  * @param data Bytes of data to send.
  */
-void NetworkDriverImpl::send(std::vector<unsigned char> data) {
-  int length = htonl(data.size());
-  boost::asio::write(*this->socket, boost::asio::buffer(&length, sizeof(int)));
-  boost::asio::write(*this->socket, boost::asio::buffer(data));
+void NetworkDriverImpl::send(const std::vector<unsigned char> &data) {
+  if (this->timeout.count() > 0) {
+    TimedSocket timed(*this->socket, this->timeout);
+    write_frames(timed, {&data});
+    return;
+  }
+  write_frames(*this->socket, {&data});
+}
+
+/**
+ * Sends several messages with a single gathered write.
+ * @param frames Messages to send.
+ */
+void NetworkDriverImpl::send_frames(
+    const std::vector<std::vector<unsigned char>> &frames) {
+  std::vector<const std::vector<unsigned char> *> pointers;
+  for (auto &frame : frames) {
+    pointers.push_back(&frame);
+  }
+  if (this->timeout.count() > 0) {
+    TimedSocket timed(*this->socket, this->timeout);
+    write_frames(timed, pointers);
+    return;
+  }
+  write_frames(*this->socket, pointers);
+}
+
+/**
+ * Sends several messages with a single gathered write, without copying them
+ * into the kernel when the socket supports MSG_ZEROCOPY. Zerocopy sends
+ * block without a deadline, so a driver with a timeout copies instead.
+ * @param frames Messages to send.
+ */
+void NetworkDriverImpl::send_zerocopy(
+    std::vector<std::vector<unsigned char>> frames) {
+  if (this->timeout.count() > 0 ||
+      !write_frames_zerocopy(this->socket->native_handle(), frames,
+                             this->zerocopy)) {
+    this->send_frames(frames);
+  }
 }
 
 /**
  * Receives a fixed amount of data by receiving length first.
  * @return std::vector<unsigned char> data read.
- * @throws error when eof.
+ * @throws error when eof, or when the peer stays silent past the timeout.
  */
 std::vector<unsigned char> NetworkDriverImpl::read() {
-  // read length
-  int length;
-  boost::system::error_code error;
-  boost::asio::read(*this->socket, boost::asio::buffer(&length, sizeof(int)),
-                    boost::asio::transfer_exactly(sizeof(int)), error);
-  if (error) {
-    throw std::runtime_error("Received EOF.");
+  if (this->timeout.count() > 0) {
+    TimedSocket timed(*this->socket, this->timeout);
+    return read_frame(timed);
   }
-  length = ntohl(length);
+  return read_frame(*this->socket);
+}
 
-  // read message
-  std::vector<unsigned char> data;
-  data.resize(length);
-  boost::asio::read(*this->socket, boost::asio::buffer(data),
-                    boost::asio::transfer_exactly(length), error);
-  if (error) {
-    throw std::runtime_error("Received EOF.");
-  }
-  return data;
+/**
+ * Fail sends and reads that wait on the peer for longer than `timeout`,
+ * 0 to wait forever.
+ * @param timeout Longest wait for the socket to become ready.
+ */
+void NetworkDriverImpl::set_timeout(std::chrono::milliseconds timeout) {
+  this->timeout = timeout;
 }
 
 /**
@@ -87,3 +346,405 @@ std::string NetworkDriverImpl::get_remote_info() {
   return this->socket->remote_endpoint().address().to_string() + ":" +
          std::to_string(this->socket->remote_endpoint().port());
 }
+
+// ================================================
+// UNIX NETWORK DRIVER
+// ================================================
+
+/**
+ * Constructor. Sets up IO context and socket.
+ * @param path Filesystem path of the socket.
+ */
+UnixNetworkDriverImpl::UnixNetworkDriverImpl(std::string path)
+    : path(path), io_context() {
+  this->socket =
+      std::make_shared<local::stream_protocol::socket>(this->io_context);
+}
+
+/**
+ * Bind to the socket path and accept one connection. The path is removed
+ * once connected, since nobody else should attach to it.
+ */
+void UnixNetworkDriverImpl::listen([[maybe_unused]] int port) {
+  ::unlink(this->path.c_str());
+  local::stream_protocol::acceptor acceptor(
+      this->io_context, local::stream_protocol::endpoint(this->path));
+  acceptor.accept(*this->socket);
+  ::unlink(this->path.c_str());
+}
+
+/**
+ * Connect to the socket path.
+ */
+void UnixNetworkDriverImpl::connect([[maybe_unused]] std::string address,
+                                    [[maybe_unused]] int port) {
+  this->socket->connect(local::stream_protocol::endpoint(this->path));
+}
+
+/**
+ * Disconnect graceefully.
+ */
+void UnixNetworkDriverImpl::disconnect() {
+  this->socket->shutdown(local::stream_protocol::socket::shutdown_both);
+  this->socket->close();
+  this->io_context.stop();
+}
+
+/**
+ * Sends a fixed amount of data by sending length first, in one write.
+ * @param data Bytes of data to send.
+ */
+void UnixNetworkDriverImpl::send(const std::vector<unsigned char> &data) {
+  write_frames(*this->socket, {&data});
+}
+
+/**
+ * Sends several messages with a single gathered write.
+ * @param frames Messages to send.
+ */
+void UnixNetworkDriverImpl::send_frames(
+    const std::vector<std::vector<unsigned char>> &frames) {
+  std::vector<const std::vector<unsigned char> *> pointers;
+  for (auto &frame : frames) {
+    pointers.push_back(&frame);
+  }
+  write_frames(*this->socket, pointers);
+}
+
+/**
+ * Receives a fixed amount of data by receiving length first.
+ * @return std::vector<unsigned char> data read.
+ * @throws error when eof.
+ */
+std::vector<unsigned char> UnixNetworkDriverImpl::read() {
+  return read_frame(*this->socket);
+}
+
+/**
+ * Get socket info as string.
+ */
+std::string UnixNetworkDriverImpl::get_remote_info() {
+  return "unix:" + this->path;
+}
+
+// ================================================
+// ASYNC NETWORK DRIVER
+// ================================================
+
+/**
+ * Constructor. Sets up IO context and socket; the I/O thread is started once
+ * connected.
+ */
+AsyncNetworkDriverImpl::AsyncNetworkDriverImpl()
+    : io_context(), work_guard(boost::asio::make_work_guard(io_context)) {
+  this->socket = std::make_shared<tcp::socket>(io_context);
+}
+
+/**
+ * Destructor. Flushes queued messages and stops the I/O thread if disconnect
+ * wasn't called.
+ */
+AsyncNetworkDriverImpl::~AsyncNetworkDriverImpl() {
+  if (this->io_thread.joinable() && this->last_send.valid()) {
+    this->last_send.wait();
+  }
+  this->work_guard.reset();
+  this->io_context.stop();
+  if (this->io_thread.joinable()) {
+    this->io_thread.join();
+  }
+}
+
+/**
+ * Listen on the given port at localhost, then start the I/O thread.
+ * @param port Port to listen on.
+ */
+void AsyncNetworkDriverImpl::listen(int port) {
+  tcp::acceptor acceptor(this->io_context, tcp::endpoint(tcp::v4(), port));
+  acceptor.accept(*this->socket);
+  this->socket->set_option(tcp::no_delay(true));
+  this->start();
+}
+
+/**
+ * Connect to the given address and port, then start the I/O thread.
+ * @param address Address to connect to.
+ * @param port Port to conect to.
+ */
+void AsyncNetworkDriverImpl::connect(std::string address, int port) {
+  if (address == "localhost")
+    address = "127.0.0.1";
+  this->socket->connect(
+      tcp::endpoint(boost::asio::ip::address::from_string(address), port));
+  this->socket->set_option(tcp::no_delay(true));
+  this->start();
+}
+
+/**
+ * Start the receive loop and the thread servicing the IO context.
+ */
+void AsyncNetworkDriverImpl::start() {
+  this->do_read_header();
+  this->io_thread = std::thread([this]() { this->io_context.run(); });
+}
+
+/**
+ * Disconnect gracefully once every queued message has been written.
+ */
+void AsyncNetworkDriverImpl::disconnect() {
+  std::shared_future<void> last_send;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    last_send = this->last_send;
+  }
+  if (last_send.valid()) {
+    last_send.wait();
+  }
+  boost::asio::post(this->io_context, [this]() {
+    boost::system::error_code error;
+    this->socket->shutdown(tcp::socket::shutdown_both, error);
+    this->socket->close(error);
+  });
+  this->work_guard.reset();
+  if (this->io_thread.joinable()) {
+    this->io_thread.join();
+  }
+  this->io_context.stop();
+}
+
+/**
+ * Queues a copy of data to be sent and returns without waiting for the
+ * write; the caller keeps its buffer.
+ * @param data Bytes of data to send.
+ * @throws error if an earlier write failed.
+ */
+void AsyncNetworkDriverImpl::send(const std::vector<unsigned char> &data) {
+  this->send_async(data);
+}
+
+/**
+ * Queues data to be sent, taking the buffer, and returns without waiting for
+ * the write.
+ * @param data Bytes of data to send.
+ * @throws error if an earlier write failed.
+ */
+void AsyncNetworkDriverImpl::send(std::vector<unsigned char> &&data) {
+  this->send_async(std::move(data));
+}
+
+/**
+ * Queues copies of several messages; the I/O thread writes everything
+ * queued at once.
+ * @param frames Messages to send.
+ */
+void AsyncNetworkDriverImpl::send_frames(
+    const std::vector<std::vector<unsigned char>> &frames) {
+  for (auto &frame : frames) {
+    this->send_async(frame);
+  }
+}
+
+/**
+ * Queues several messages, taking their buffers; the I/O thread writes
+ * everything queued at once.
+ * @param frames Messages to send.
+ */
+void AsyncNetworkDriverImpl::send_frames(
+    std::vector<std::vector<unsigned char>> &&frames) {
+  for (auto &frame : frames) {
+    this->send_async(std::move(frame));
+  }
+}
+
+/**
+ * Waits for queued messages to go out, then sends the frames from the
+ * calling thread with one gathered write, without copying them into the
+ * kernel when the socket supports MSG_ZEROCOPY. Otherwise they are queued
+ * like send_frames, without copying them. Must not race with other sends.
+ * @param frames Messages to send.
+ * @throws error if an earlier write failed.
+ */
+void AsyncNetworkDriverImpl::send_zerocopy(
+    std::vector<std::vector<unsigned char>> frames) {
+  std::shared_future<void> last_send;
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (!this->send_error.empty()) {
+      throw std::runtime_error(this->send_error);
+    }
+    last_send = this->last_send;
+  }
+  if (last_send.valid()) {
+    last_send.wait();
+  }
+  if (!write_frames_zerocopy(this->socket->native_handle(), frames,
+                             this->zerocopy)) {
+    this->send_frames(std::move(frames));
+  }
+}
+
+/**
+ * Queues data to be sent by the I/O thread, length first.
+ * @param data Bytes of data to send.
+ * @return future that becomes ready once the data has been written.
+ * @throws error if an earlier write failed.
+ */
+std::shared_future<void>
+AsyncNetworkDriverImpl::send_async(std::vector<unsigned char> data) {
+  auto frame = std::make_shared<OutgoingFrame>();
+  frame->data = std::move(data);
+  std::shared_future<void> done = frame->done.get_future().share();
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (!this->send_error.empty()) {
+      throw std::runtime_error(this->send_error);
+    }
+    this->last_send = done;
+  }
+
+  boost::asio::post(this->io_context, [this, frame]() {
+    this->send_queue.push_back(frame);
+    if (this->send_queue.size() == 1) {
+      this->do_write();
+    }
+  });
+  return done;
+}
+
+/**
+ * Write every frame currently in the send queue with one gathered write, then
+ * move on to whatever was queued meanwhile. Runs on the I/O thread.
+ */
+void AsyncNetworkDriverImpl::do_write() {
+  std::vector<const std::vector<unsigned char> *> frames;
+  for (auto &frame : this->send_queue) {
+    frames.push_back(&frame->data);
+  }
+  size_t num_frames = frames.size();
+  boost::asio::async_write(
+      *this->socket, gather_frames(frames, this->write_headers),
+      [this, num_frames](boost::system::error_code error, std::size_t) {
+        std::string reason = "Failed to send: " + error.message();
+        if (error) {
+          std::lock_guard<std::mutex> lock(this->mutex);
+          this->send_error = reason;
+        }
+        for (size_t i = 0; i < num_frames; i++) {
+          auto frame = this->send_queue.front();
+          this->send_queue.pop_front();
+          if (error) {
+            frame->done.set_exception(
+                std::make_exception_ptr(std::runtime_error(reason)));
+          } else {
+            frame->done.set_value();
+          }
+        }
+        if (!this->send_queue.empty()) {
+          this->do_write();
+        }
+      });
+}
+
+/**
+ * Receives the next message, blocking until the I/O thread has read it.
+ * @return std::vector<unsigned char> data read.
+ * @throws error when eof.
+ */
+std::vector<unsigned char> AsyncNetworkDriverImpl::read() {
+  return this->read_async().get();
+}
+
+/**
+ * Returns a future for the next message read by the I/O thread.
+ */
+std::future<std::vector<unsigned char>> AsyncNetworkDriverImpl::read_async() {
+  std::promise<std::vector<unsigned char>> promise;
+  std::future<std::vector<unsigned char>> future = promise.get_future();
+  std::lock_guard<std::mutex> lock(this->mutex);
+  if (!this->receive_queue.empty()) {
+    promise.set_value(std::move(this->receive_queue.front()));
+    this->receive_queue.pop_front();
+  } else if (!this->read_error.empty()) {
+    promise.set_exception(
+        std::make_exception_ptr(std::runtime_error(this->read_error)));
+  } else {
+    this->pending_reads.push_back(std::move(promise));
+  }
+  return future;
+}
+
+/**
+ * Read the length of the next message. Runs on the I/O thread, so a length
+ * over MAX_FRAME_LENGTH fails the reads rather than throwing out of it.
+ */
+void AsyncNetworkDriverImpl::do_read_header() {
+  boost::asio::async_read(
+      *this->socket,
+      boost::asio::buffer(&this->incoming_length, sizeof(uint64_t)),
+      boost::asio::transfer_exactly(sizeof(uint64_t)),
+      [this](boost::system::error_code error, std::size_t) {
+        if (!error && be64toh(this->incoming_length) > MAX_FRAME_LENGTH) {
+          error = boost::asio::error::message_size;
+        }
+        if (error) {
+          this->fail_reads(error);
+          return;
+        }
+        this->incoming_data.resize(be64toh(this->incoming_length));
+        this->do_read_body();
+      });
+}
+
+/**
+ * Read the body of the next message and hand it to a waiting reader or the
+ * receive queue. Runs on the I/O thread.
+ */
+void AsyncNetworkDriverImpl::do_read_body() {
+  boost::asio::async_read(
+      *this->socket, boost::asio::buffer(this->incoming_data),
+      boost::asio::transfer_exactly(this->incoming_data.size()),
+      [this](boost::system::error_code error, std::size_t) {
+        if (error) {
+          this->fail_reads(error);
+          return;
+        }
+        {
+          std::lock_guard<std::mutex> lock(this->mutex);
+          if (!this->pending_reads.empty()) {
+            this->pending_reads.front().set_value(
+                std::move(this->incoming_data));
+            this->pending_reads.pop_front();
+          } else {
+            this->receive_queue.push_back(std::move(this->incoming_data));
+          }
+        }
+        this->incoming_data = std::vector<unsigned char>();
+        this->do_read_header();
+      });
+}
+
+/**
+ * Record a receive error and fail every waiting reader. Sends are unaffected;
+ * they fail on their own if the socket can't be written.
+ */
+void AsyncNetworkDriverImpl::fail_reads(boost::system::error_code error) {
+  std::lock_guard<std::mutex> lock(this->mutex);
+  if (this->read_error.empty()) {
+    this->read_error = error == boost::asio::error::eof
+                           ? "Received EOF."
+                           : "Failed to read: " + error.message();
+  }
+  for (auto &promise : this->pending_reads) {
+    promise.set_exception(
+        std::make_exception_ptr(std::runtime_error(this->read_error)));
+  }
+  this->pending_reads.clear();
+}
+
+/**
+ * Get socket info as string.
+ */
+std::string AsyncNetworkDriverImpl::get_remote_info() {
+  return this->socket->remote_endpoint().address().to_string() + ":" +
+         std::to_string(this->socket->remote_endpoint().port());
+}
@@ -10,15 +10,69 @@
 #include <crypto++/elgamal.h>
 #include <crypto++/files.h>
 #include <crypto++/hkdf.h>
+#include <crypto++/modes.h>
 #include <crypto++/nbtheory.h>
 #include <crypto++/queue.h>
 #include <crypto++/sha.h>
+#include <endian.h>
 
 #include "../../include-shared/constants.hpp"
 #include "../../include-shared/messages.hpp"
+#include "../../include-shared/prg.hpp"
 #include "../../include-shared/util.hpp"
 #include "../../include/drivers/ot_driver.hpp"
 
+namespace {
+/**
+ * Expands a base OT seed into `length` bytes with AES-CTR. Each batch uses
+ * its own nonce so no column is ever reused.
+ */
+std::vector<unsigned char> expand_seed(const CryptoPP::SecByteBlock &seed,
+                                       uint64_t nonce, size_t length) {
+  CryptoPP::byte iv[CryptoPP::AES::BLOCKSIZE] = {0};
+  uint64_t nonce_be = htobe64(nonce);
+  std::memcpy(iv, &nonce_be, sizeof(uint64_t));
+  CryptoPP::CTR_Mode<CryptoPP::AES>::Encryption prg;
+  prg.SetKeyWithIV(seed, seed.size(), iv);
+  std::vector<unsigned char> out(length, 0);
+  prg.ProcessData(out.data(), out.data(), length);
+  return out;
+}
+
+/**
+ * Transposes OT_EXTENSION_WIDTH columns of `rows` bits each into `rows` rows
+ * of OT_EXTENSION_WIDTH bits each.
+ */
+std::vector<unsigned char>
+transpose(const std::vector<std::vector<unsigned char>> &columns,
+          size_t rows) {
+  const size_t row_bytes = OT_EXTENSION_WIDTH / 8;
+  std::vector<unsigned char> out(rows * row_bytes, 0);
+  for (size_t i = 0; i < OT_EXTENSION_WIDTH; i++) {
+    for (size_t j = 0; j < rows; j++) {
+      if ((columns[i][j / 8] >> (j % 8)) & 1) {
+        out[j * row_bytes + i / 8] |= 1 << (i % 8);
+      }
+    }
+  }
+  return out;
+}
+
+/**
+ * Pad of extended OT number `index`: H(index || row), truncated.
+ */
+CryptoPP::SecByteBlock hash_row(uint64_t index, const unsigned char *row) {
+  CryptoPP::SHA256 hash;
+  uint64_t index_be = htobe64(index);
+  hash.Update(reinterpret_cast<const CryptoPP::byte *>(&index_be),
+              sizeof(uint64_t));
+  hash.Update(row, OT_EXTENSION_WIDTH / 8);
+  CryptoPP::SecByteBlock digest(CryptoPP::SHA256::DIGESTSIZE);
+  hash.Final(digest);
+  return CryptoPP::SecByteBlock(digest, RANDOM_OT_LENGTH);
+}
+} // namespace
+
 /*
  * Constructor
  */
@@ -48,7 +102,7 @@ void OTDriver::OT_send(std::string m0, std::string m1) {
   SenderToReceiver_OTPublicValue_Message pub_val_msg;
   pub_val_msg.public_value = std::get<2>(dh);
   std::vector<unsigned char> pub_val_msg_data = this->crypto_driver->encrypt_and_tag(this->AES_key, this->HMAC_key, &pub_val_msg);
-  this->network_driver->send(pub_val_msg_data);
+  this->network_driver->send(std::move(pub_val_msg_data));
 
   ReceiverToSender_OTPublicValue_Message ot_pub_val_msg;
   auto ot_pub_val_msg_data = this->crypto_driver->decrypt_and_verify(this->AES_key, this->HMAC_key, this->network_driver->read());
@@ -77,7 +131,7 @@ void OTDriver::OT_send(std::string m0, std::string m1) {
   enc_msg.e1 = e1.first;
   enc_msg.iv1 = e1.second;
   std::vector<unsigned char> enc_msg_data = this->crypto_driver->encrypt_and_tag(this->AES_key, this->HMAC_key, &enc_msg);
-  this->network_driver->send(enc_msg_data);
+  this->network_driver->send(std::move(enc_msg_data));
 }
 
 /*
@@ -112,7 +166,7 @@ std::string OTDriver::OT_recv(int choice_bit) {
   ReceiverToSender_OTPublicValue_Message pub_val_msg;
   pub_val_msg.public_value = pub_val;
   auto pub_val_msg_data = this->crypto_driver->encrypt_and_tag(this->AES_key, this->HMAC_key, &pub_val_msg);
-  this->network_driver->send(pub_val_msg_data);
+  this->network_driver->send(std::move(pub_val_msg_data));
 
   auto shared_secret = this->crypto_driver->DH_generate_shared_key(std::get<0>(dh), std::get<1>(dh), ot_pub_val_msg.public_value);
   auto choice_key = this->crypto_driver->AES_generate_key(shared_secret);
@@ -132,4 +186,440 @@ std::string OTDriver::OT_recv(int choice_bit) {
   } else {
     return this->crypto_driver->AES_decrypt(choice_key, enc_val_msg.iv1, enc_val_msg.e1);
   }
-}
\ No newline at end of file
+}
+/*
+ * Send one of each pair of messages using OT, running all OTs together. Same
+ * protocol as OT_send, but every round carries the whole batch and the
+ * divisions by our public values share a single modular inversion.
+ */
+void OTDriver::OT_send_batch(
+    std::vector<std::pair<std::string, std::string>> messages) {
+  auto dh = this->crypto_driver->DH_initialize_batch(messages.size());
+  SenderToReceiver_OTPublicValues_Message pub_val_msg;
+  pub_val_msg.public_values = std::get<2>(dh);
+  std::vector<unsigned char> pub_val_msg_data = this->crypto_driver->encrypt_and_tag(this->AES_key, this->HMAC_key, &pub_val_msg);
+  this->network_driver->send(std::move(pub_val_msg_data));
+
+  ReceiverToSender_OTPublicValues_Message ot_pub_val_msg;
+  auto ot_pub_val_msg_data = this->crypto_driver->decrypt_and_verify(this->AES_key, this->HMAC_key, this->network_driver->read());
+  if (!ot_pub_val_msg_data.second) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("invalid message");
+  }
+  ot_pub_val_msg.deserialize(ot_pub_val_msg_data.first);
+  if (ot_pub_val_msg.public_values.size() != messages.size()) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("mismatched number of OT public values");
+  }
+
+  // B / A for every OT, with one inversion for the whole batch.
+  auto second_shared_key_pvs = this->crypto_driver->DL_divide_batch(
+      ot_pub_val_msg.public_values, std::get<2>(dh));
+
+  SenderToReceiver_OTEncryptedValuesBatch_Message enc_msg;
+  for (size_t i = 0; i < messages.size(); i++) {
+    auto first_shared_key = this->crypto_driver->DH_generate_shared_key(
+        std::get<0>(dh), std::get<1>(dh)[i], ot_pub_val_msg.public_values[i]);
+    auto second_shared_key = this->crypto_driver->DH_generate_shared_key(
+        std::get<0>(dh), std::get<1>(dh)[i], second_shared_key_pvs[i]);
+
+    auto first_shared_key_aes = this->crypto_driver->AES_generate_key(first_shared_key);
+    auto second_shared_key_aes = this->crypto_driver->AES_generate_key(second_shared_key);
+
+    auto e0 = this->crypto_driver->AES_encrypt(first_shared_key_aes, messages[i].first);
+    auto e1 = this->crypto_driver->AES_encrypt(second_shared_key_aes, messages[i].second);
+    enc_msg.e0.push_back(e0.first);
+    enc_msg.iv0.push_back(e0.second);
+    enc_msg.e1.push_back(e1.first);
+    enc_msg.iv1.push_back(e1.second);
+  }
+  std::vector<unsigned char> enc_msg_data = this->crypto_driver->encrypt_and_tag(this->AES_key, this->HMAC_key, &enc_msg);
+  this->network_driver->send(std::move(enc_msg_data));
+}
+
+/*
+ * Receive m_c for every choice bit using OT, running all OTs together.
+ * Counterpart of OT_send_batch.
+ */
+std::vector<std::string>
+OTDriver::OT_recv_batch(std::vector<int> choice_bits) {
+  auto dh = this->crypto_driver->DH_initialize_batch(choice_bits.size());
+
+  SenderToReceiver_OTPublicValues_Message ot_pub_val_msg;
+  auto ot_pub_val_msg_data = this->crypto_driver->decrypt_and_verify(this->AES_key,
+                                                                     this->HMAC_key,
+                                                                     this->network_driver->read());
+  if (!ot_pub_val_msg_data.second) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("invalid message");
+  }
+  ot_pub_val_msg.deserialize(ot_pub_val_msg_data.first);
+  if (ot_pub_val_msg.public_values.size() != choice_bits.size()) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("mismatched number of OT public values");
+  }
+
+  ReceiverToSender_OTPublicValues_Message pub_val_msg;
+  for (size_t i = 0; i < choice_bits.size(); i++) {
+    if (choice_bits[i] == 0) {
+      pub_val_msg.public_values.push_back(std::get<2>(dh)[i]);
+    } else {
+      pub_val_msg.public_values.push_back(integer_to_byteblock(
+          byteblock_to_integer(ot_pub_val_msg.public_values[i]) *
+          byteblock_to_integer(std::get<2>(dh)[i]) % DL_P));
+    }
+  }
+  auto pub_val_msg_data = this->crypto_driver->encrypt_and_tag(this->AES_key, this->HMAC_key, &pub_val_msg);
+  this->network_driver->send(std::move(pub_val_msg_data));
+
+  SenderToReceiver_OTEncryptedValuesBatch_Message enc_val_msg;
+  auto enc_val_msg_data = this->crypto_driver->decrypt_and_verify(this->AES_key,
+                                                                  this->HMAC_key,
+                                                                  this->network_driver->read());
+  if (!enc_val_msg_data.second) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("invalid message");
+  }
+  enc_val_msg.deserialize(enc_val_msg_data.first);
+  if (enc_val_msg.e0.size() != choice_bits.size()) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("mismatched number of OT values");
+  }
+
+  std::vector<std::string> res;
+  for (size_t i = 0; i < choice_bits.size(); i++) {
+    auto shared_secret = this->crypto_driver->DH_generate_shared_key(
+        std::get<0>(dh), std::get<1>(dh)[i], ot_pub_val_msg.public_values[i]);
+    auto choice_key = this->crypto_driver->AES_generate_key(shared_secret);
+    if (choice_bits[i] == 0) {
+      res.push_back(this->crypto_driver->AES_decrypt(choice_key, enc_val_msg.iv0[i], enc_val_msg.e0[i]));
+    } else {
+      res.push_back(this->crypto_driver->AES_decrypt(choice_key, enc_val_msg.iv1[i], enc_val_msg.e1[i]));
+    }
+  }
+  return res;
+}
+
+/*
+ * Offline phase of the sender. Runs `count` OTs on random pads r0, r1 and
+ * stores them in the pool. Must be matched by OT_precompute_recv.
+ */
+void OTDriver::OT_precompute_send(int count) {
+  if (count <= 0) {
+    return;
+  }
+  if (this->extension_ready) {
+    this->OT_extend_send(count);
+    return;
+  }
+  ThreadRNG &prng = ThreadRNG::get();
+  std::vector<std::pair<CryptoPP::SecByteBlock, CryptoPP::SecByteBlock>> pads;
+  std::vector<std::pair<std::string, std::string>> messages;
+  for (int i = 0; i < count; i++) {
+    CryptoPP::SecByteBlock r0(RANDOM_OT_LENGTH);
+    CryptoPP::SecByteBlock r1(RANDOM_OT_LENGTH);
+    prng.GenerateBlock(r0, r0.size());
+    prng.GenerateBlock(r1, r1.size());
+    pads.push_back(std::make_pair(r0, r1));
+    messages.push_back(
+        std::make_pair(byteblock_to_string(r0), byteblock_to_string(r1)));
+  }
+  this->OT_send_batch(messages);
+  this->send_pool.insert(this->send_pool.end(), pads.begin(), pads.end());
+}
+
+/*
+ * Offline phase of the receiver. Runs `count` OTs on a random choice bit c
+ * and stores c together with the pad r_c in the pool.
+ */
+void OTDriver::OT_precompute_recv(int count) {
+  if (count <= 0) {
+    return;
+  }
+  if (this->extension_ready) {
+    this->OT_extend_recv(count);
+    return;
+  }
+  ThreadRNG &prng = ThreadRNG::get();
+  std::vector<int> choice_bits;
+  for (int i = 0; i < count; i++) {
+    choice_bits.push_back(prng.GenerateBit());
+  }
+  std::vector<std::string> r_c = this->OT_recv_batch(choice_bits);
+  for (int i = 0; i < count; i++) {
+    this->recv_pool.push_back(
+        std::make_pair(choice_bits[i], string_to_byteblock(r_c[i])));
+  }
+}
+
+/*
+ * Online phase of the sender. Derandomizes one precomputed OT per message:
+ * 1) Receive the correction bits d = b ^ c from the receiver
+ * 2) Send (m0 ^ r_d, m1 ^ r_{1-d}) for each pair
+ * Tops up the pool first if the offline phase didn't generate enough OTs.
+ */
+void OTDriver::OT_send_precomputed(
+    std::vector<std::pair<std::string, std::string>> messages) {
+  if (this->send_pool.size() < messages.size()) {
+    this->OT_precompute_send(messages.size() - this->send_pool.size());
+  }
+  std::vector<bool> corrections = this->OT_recv_corrections(messages.size());
+  this->OT_send_masked(messages, corrections);
+}
+
+/*
+ * Online phase of the receiver. Derandomizes one precomputed OT per bit:
+ * 1) Send the correction bits d = b ^ c to the sender
+ * 2) Receive the masked pairs and unmask the chosen one with r_c
+ */
+std::vector<std::string>
+OTDriver::OT_recv_precomputed(std::vector<int> choice_bits) {
+  if (this->recv_pool.size() < choice_bits.size()) {
+    this->OT_precompute_recv(choice_bits.size() - this->recv_pool.size());
+  }
+  auto pads = this->OT_send_corrections(choice_bits);
+  return this->OT_recv_masked(choice_bits, pads);
+}
+
+/*
+ * Step 1 of OT_send_precomputed: receive `count` correction bits in one
+ * message. A batch may receive the corrections for many OT_send_masked calls
+ * at once.
+ */
+std::vector<bool> OTDriver::OT_recv_corrections(size_t count) {
+  ReceiverToSender_OTChoiceCorrections_Message corrections_msg;
+  auto corrections_msg_data = this->crypto_driver->decrypt_and_verify(
+      this->AES_key, this->HMAC_key, this->network_driver->read());
+  if (!corrections_msg_data.second) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("invalid message");
+  }
+  corrections_msg.deserialize(corrections_msg_data.first);
+  if (corrections_msg.corrections.size() != count) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("mismatched number of OT corrections");
+  }
+  return corrections_msg.corrections;
+}
+
+/*
+ * Step 2 of OT_send_precomputed: mask each pair with the next pads in the
+ * pool according to its correction bit and send them.
+ */
+void OTDriver::OT_send_masked(
+    const std::vector<std::pair<std::string, std::string>> &messages,
+    const std::vector<bool> &corrections) {
+  if (this->send_pool.size() < messages.size() ||
+      corrections.size() < messages.size()) {
+    throw std::runtime_error("not enough precomputed OTs");
+  }
+  SenderToReceiver_OTMaskedValues_Message masked_msg;
+  for (size_t i = 0; i < messages.size(); i++) {
+    auto pads = this->send_pool.front();
+    this->send_pool.pop_front();
+    if (messages[i].first.size() > RANDOM_OT_LENGTH ||
+        messages[i].second.size() > RANDOM_OT_LENGTH) {
+      throw std::runtime_error("OT message longer than precomputed pad");
+    }
+
+    bool d = corrections[i];
+    CryptoPP::SecByteBlock e0 = string_to_byteblock(messages[i].first);
+    CryptoPP::SecByteBlock e1 = string_to_byteblock(messages[i].second);
+    CryptoPP::xorbuf(e0, d ? pads.second : pads.first, e0.size());
+    CryptoPP::xorbuf(e1, d ? pads.first : pads.second, e1.size());
+    masked_msg.e0.push_back(byteblock_to_string(e0));
+    masked_msg.e1.push_back(byteblock_to_string(e1));
+  }
+  std::vector<unsigned char> masked_msg_data =
+      this->crypto_driver->encrypt_and_tag(this->AES_key, this->HMAC_key,
+                                           &masked_msg);
+  this->network_driver->send(std::move(masked_msg_data));
+}
+
+/*
+ * Step 1 of OT_recv_precomputed: send the corrections for every choice bit
+ * in one message.
+ * @return the pads r_c to unmask with, in order.
+ */
+std::vector<CryptoPP::SecByteBlock>
+OTDriver::OT_send_corrections(const std::vector<int> &choice_bits) {
+  if (this->recv_pool.size() < choice_bits.size()) {
+    throw std::runtime_error("not enough precomputed OTs");
+  }
+  ReceiverToSender_OTChoiceCorrections_Message corrections_msg;
+  std::vector<CryptoPP::SecByteBlock> pads;
+  for (size_t i = 0; i < choice_bits.size(); i++) {
+    auto pad = this->recv_pool.front();
+    this->recv_pool.pop_front();
+    corrections_msg.corrections.push_back((choice_bits[i] ^ pad.first) != 0);
+    pads.push_back(pad.second);
+  }
+  auto corrections_msg_data = this->crypto_driver->encrypt_and_tag(
+      this->AES_key, this->HMAC_key, &corrections_msg);
+  this->network_driver->send(std::move(corrections_msg_data));
+  return pads;
+}
+
+/*
+ * Step 2 of OT_recv_precomputed: receive one message of masked pairs and
+ * unmask the chosen ones.
+ */
+std::vector<std::string>
+OTDriver::OT_recv_masked(const std::vector<int> &choice_bits,
+                         const std::vector<CryptoPP::SecByteBlock> &pads) {
+  SenderToReceiver_OTMaskedValues_Message masked_msg;
+  auto masked_msg_data = this->crypto_driver->decrypt_and_verify(
+      this->AES_key, this->HMAC_key, this->network_driver->read());
+  if (!masked_msg_data.second) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("invalid message");
+  }
+  masked_msg.deserialize(masked_msg_data.first);
+  if (masked_msg.e0.size() != choice_bits.size() ||
+      masked_msg.e1.size() != choice_bits.size()) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("mismatched number of OT values");
+  }
+
+  std::vector<std::string> res;
+  for (size_t i = 0; i < choice_bits.size(); i++) {
+    CryptoPP::SecByteBlock m = string_to_byteblock(
+        choice_bits[i] ? masked_msg.e1[i] : masked_msg.e0[i]);
+    CryptoPP::xorbuf(m, pads.at(i), m.size());
+    res.push_back(byteblock_to_string(m));
+  }
+  return res;
+}
+
+/*
+ * Sets up IKNP OT extension on the sender's side. The base OTs run with
+ * roles reversed: we receive one of each pair of seeds (k_i^0, k_i^1)
+ * according to random choice bits s. Must be matched by
+ * OT_extension_setup_recv.
+ */
+void OTDriver::OT_extension_setup_send() {
+  ThreadRNG &prng = ThreadRNG::get();
+  this->extension_delta = CryptoPP::SecByteBlock(OT_EXTENSION_WIDTH / 8);
+  prng.GenerateBlock(this->extension_delta, this->extension_delta.size());
+
+  std::vector<int> choice_bits;
+  for (int i = 0; i < OT_EXTENSION_WIDTH; i++) {
+    choice_bits.push_back((this->extension_delta[i / 8] >> (i % 8)) & 1);
+  }
+  std::vector<std::string> seeds = this->OT_recv_batch(choice_bits);
+  this->extension_seeds0.clear();
+  for (auto &seed : seeds) {
+    this->extension_seeds0.push_back(string_to_byteblock(seed));
+  }
+  this->extension_ready = true;
+}
+
+/*
+ * Sets up IKNP OT extension on the receiver's side by sending random seed
+ * pairs (k_i^0, k_i^1) through the base OTs.
+ */
+void OTDriver::OT_extension_setup_recv() {
+  ThreadRNG &prng = ThreadRNG::get();
+  std::vector<std::pair<std::string, std::string>> seed_pairs;
+  this->extension_seeds0.clear();
+  this->extension_seeds1.clear();
+  for (int i = 0; i < OT_EXTENSION_WIDTH; i++) {
+    CryptoPP::SecByteBlock k0(OT_EXTENSION_SEED_LENGTH);
+    CryptoPP::SecByteBlock k1(OT_EXTENSION_SEED_LENGTH);
+    prng.GenerateBlock(k0, k0.size());
+    prng.GenerateBlock(k1, k1.size());
+    this->extension_seeds0.push_back(k0);
+    this->extension_seeds1.push_back(k1);
+    seed_pairs.push_back(
+        std::make_pair(byteblock_to_string(k0), byteblock_to_string(k1)));
+  }
+  this->OT_send_batch(seed_pairs);
+  this->extension_ready = true;
+}
+
+/*
+ * Extends the base OTs into `count` random OTs for the send pool:
+ * 1) Receive the columns u^i from the receiver
+ * 2) q^i = G(k_i^{s_i}) ^ s_i * u^i, so row q_j = t_j ^ r_j * s
+ * 3) Pads are H(j, q_j) and H(j, q_j ^ s)
+ */
+void OTDriver::OT_extend_send(int count) {
+  size_t rows = (count + 7) / 8 * 8;
+  uint64_t nonce = this->extension_batches++;
+
+  ReceiverToSender_OTExtensionColumns_Message columns_msg;
+  auto columns_msg_data = this->crypto_driver->decrypt_and_verify(
+      this->AES_key, this->HMAC_key, this->network_driver->read());
+  if (!columns_msg_data.second) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("invalid message");
+  }
+  columns_msg.deserialize(columns_msg_data.first);
+  if (columns_msg.columns.size() != OT_EXTENSION_WIDTH) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("mismatched number of OT extension columns");
+  }
+
+  std::vector<std::vector<unsigned char>> q(OT_EXTENSION_WIDTH);
+  for (int i = 0; i < OT_EXTENSION_WIDTH; i++) {
+    if (columns_msg.columns[i].size() != rows / 8) {
+      this->network_driver->disconnect();
+      throw std::runtime_error("mismatched OT extension column length");
+    }
+    q[i] = expand_seed(this->extension_seeds0[i], nonce, rows / 8);
+    if ((this->extension_delta[i / 8] >> (i % 8)) & 1) {
+      CryptoPP::xorbuf(q[i].data(),
+                       reinterpret_cast<const CryptoPP::byte *>(
+                           columns_msg.columns[i].data()),
+                       rows / 8);
+    }
+  }
+
+  std::vector<unsigned char> q_rows = transpose(q, rows);
+  for (int j = 0; j < count; j++) {
+    unsigned char *row = &q_rows[j * (OT_EXTENSION_WIDTH / 8)];
+    auto r0 = hash_row(this->extension_count + j, row);
+    CryptoPP::xorbuf(row, this->extension_delta, OT_EXTENSION_WIDTH / 8);
+    auto r1 = hash_row(this->extension_count + j, row);
+    this->send_pool.push_back(std::make_pair(r0, r1));
+  }
+  this->extension_count += rows;
+}
+
+/*
+ * Extends the base OTs into `count` random OTs for the receive pool:
+ * 1) Pick random choice bits r and t^i = G(k_i^0)
+ * 2) Send u^i = t^i ^ G(k_i^1) ^ r to the sender
+ * 3) The pad for choice r_j is H(j, t_j)
+ */
+void OTDriver::OT_extend_recv(int count) {
+  size_t rows = (count + 7) / 8 * 8;
+  uint64_t nonce = this->extension_batches++;
+
+  ThreadRNG &prng = ThreadRNG::get();
+  CryptoPP::SecByteBlock r(rows / 8);
+  prng.GenerateBlock(r, r.size());
+
+  ReceiverToSender_OTExtensionColumns_Message columns_msg;
+  std::vector<std::vector<unsigned char>> t(OT_EXTENSION_WIDTH);
+  for (int i = 0; i < OT_EXTENSION_WIDTH; i++) {
+    t[i] = expand_seed(this->extension_seeds0[i], nonce, rows / 8);
+    std::vector<unsigned char> u =
+        expand_seed(this->extension_seeds1[i], nonce, rows / 8);
+    CryptoPP::xorbuf(u.data(), t[i].data(), rows / 8);
+    CryptoPP::xorbuf(u.data(), r, rows / 8);
+    columns_msg.columns.push_back(std::string(u.begin(), u.end()));
+  }
+  auto columns_msg_data = this->crypto_driver->encrypt_and_tag(
+      this->AES_key, this->HMAC_key, &columns_msg);
+  this->network_driver->send(std::move(columns_msg_data));
+
+  std::vector<unsigned char> t_rows = transpose(t, rows);
+  for (int j = 0; j < count; j++) {
+    int choice = (r[j / 8] >> (j % 8)) & 1;
+    this->recv_pool.push_back(std::make_pair(
+        choice, hash_row(this->extension_count + j,
+                         &t_rows[j * (OT_EXTENSION_WIDTH / 8)])));
+  }
+  this->extension_count += rows;
+}
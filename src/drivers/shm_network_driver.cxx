@@ -0,0 +1,390 @@
+#include <cerrno>
+#include <climits>
+#include <ctime>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "../../include/drivers/shm_network_driver.hpp"
+
+namespace {
+/**
+ * Sleeps while *word == value, for at most SHM_WAIT_INTERVAL_MS. May return
+ * early or spuriously. The futex is shared, so it works across processes.
+ */
+void futex_wait(std::atomic<uint32_t> *word, uint32_t value) {
+  struct timespec timeout = {SHM_WAIT_INTERVAL_MS / 1000,
+                             (SHM_WAIT_INTERVAL_MS % 1000) * 1000000L};
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAIT, value,
+          &timeout, nullptr, 0);
+}
+
+/**
+ * Wakes every thread sleeping on word.
+ */
+void futex_wake(std::atomic<uint32_t> *word) {
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAKE, INT_MAX,
+          nullptr, nullptr, 0);
+}
+} // namespace
+
+// ================================================
+// RING BUFFER
+// ================================================
+
+SpscRing::SpscRing()
+    : header(nullptr), data(nullptr), closed(nullptr), peer_pid(nullptr) {}
+
+SpscRing::SpscRing(RingHeader *header, unsigned char *data,
+                   std::atomic<uint32_t> *closed,
+                   std::atomic<int32_t> *peer_pid)
+    : header(header), data(data), closed(closed), peer_pid(peer_pid) {}
+
+/**
+ * Wakes the other side if it is asleep in wait_until. Called after every
+ * move of head or tail and when the channel closes.
+ */
+void SpscRing::notify() {
+  // seq_cst pairs with wait_until: either the sleeper sees the new event, or
+  // we see its sleepers count and wake it.
+  this->header->event.fetch_add(1, std::memory_order_seq_cst);
+  if (this->header->sleepers.load(std::memory_order_seq_cst) > 0) {
+    futex_wake(&this->header->event);
+  }
+}
+
+/**
+ * Whether the peer's process has exited. Only shared memory channels record
+ * a pid; an in-process peer closes the channel when it goes away.
+ */
+bool SpscRing::peer_gone() {
+  pid_t pid = this->peer_pid->load(std::memory_order_acquire);
+  return pid > 0 && kill(pid, 0) != 0 && errno == ESRCH;
+}
+
+/**
+ * Waits until `ready` returns true: polls SHM_SPIN_LIMIT times, then sleeps
+ * on the ring's futex. Every SHM_WAIT_INTERVAL_MS a sleeper checks whether
+ * the peer died; if so it marks the channel closed, which `ready` must
+ * accept, instead of waiting forever.
+ */
+template <typename Predicate> void SpscRing::wait_until(Predicate ready) {
+  for (int spins = 0; spins < SHM_SPIN_LIMIT; spins++) {
+    if (ready()) {
+      return;
+    }
+  }
+  while (true) {
+    uint32_t event = this->header->event.load(std::memory_order_seq_cst);
+    this->header->sleepers.fetch_add(1, std::memory_order_seq_cst);
+    if (ready()) {
+      this->header->sleepers.fetch_sub(1, std::memory_order_seq_cst);
+      return;
+    }
+    futex_wait(&this->header->event, event);
+    this->header->sleepers.fetch_sub(1, std::memory_order_seq_cst);
+    if (ready()) {
+      return;
+    }
+    if (this->peer_gone()) {
+      this->closed->store(1, std::memory_order_release);
+    }
+  }
+}
+
+/**
+ * Copies length bytes into the ring, blocking while it is full. Messages
+ * larger than the ring are streamed through in pieces.
+ * @throws error if the channel is closed.
+ */
+void SpscRing::write(const unsigned char *src, size_t length) {
+  while (length > 0) {
+    uint64_t head = this->header->head.load(std::memory_order_relaxed);
+    uint64_t tail;
+    wait_until([&]() {
+      tail = this->header->tail.load(std::memory_order_acquire);
+      return head - tail < SHM_RING_CAPACITY ||
+             this->closed->load(std::memory_order_acquire);
+    });
+    if (this->closed->load(std::memory_order_acquire)) {
+      throw std::runtime_error("Channel closed.");
+    }
+
+    size_t n = std::min<uint64_t>(length, SHM_RING_CAPACITY - (head - tail));
+    size_t offset = head % SHM_RING_CAPACITY;
+    size_t first = std::min<size_t>(n, SHM_RING_CAPACITY - offset);
+    std::memcpy(this->data + offset, src, first);
+    std::memcpy(this->data, src + first, n - first);
+    this->header->head.store(head + n, std::memory_order_release);
+    this->notify();
+
+    src += n;
+    length -= n;
+  }
+}
+
+/**
+ * Copies length bytes out of the ring, blocking while it is empty.
+ * @throws error when eof.
+ */
+void SpscRing::read(unsigned char *dst, size_t length) {
+  while (length > 0) {
+    uint64_t tail = this->header->tail.load(std::memory_order_relaxed);
+    uint64_t head;
+    wait_until([&]() {
+      head = this->header->head.load(std::memory_order_acquire);
+      return head != tail || this->closed->load(std::memory_order_acquire);
+    });
+    // Re-check after seeing closed: the last write may have landed just
+    // before it.
+    head = this->header->head.load(std::memory_order_acquire);
+    if (head == tail) {
+      throw std::runtime_error("Received EOF.");
+    }
+
+    size_t n = std::min<uint64_t>(length, head - tail);
+    size_t offset = tail % SHM_RING_CAPACITY;
+    size_t first = std::min<size_t>(n, SHM_RING_CAPACITY - offset);
+    std::memcpy(dst, this->data + offset, first);
+    std::memcpy(dst + first, this->data, n - first);
+    this->header->tail.store(tail + n, std::memory_order_release);
+    this->notify();
+
+    dst += n;
+    length -= n;
+  }
+}
+
+// ================================================
+// RING NETWORK DRIVER
+// ================================================
+
+/**
+ * Points the rings at the given channel. The listener writes ring 0 and reads
+ * ring 1; the connector the other way round.
+ */
+void RingNetworkDriver::attach(ChannelHeader *channel, bool is_listener) {
+  this->channel.store(channel, std::memory_order_release);
+  unsigned char *rings = reinterpret_cast<unsigned char *>(channel + 1);
+  std::atomic<int32_t> *peer_pid = &channel->pids[is_listener ? 1 : 0];
+  SpscRing ring0(&channel->rings[0], rings, &channel->closed, peer_pid);
+  SpscRing ring1(&channel->rings[1], rings + SHM_RING_CAPACITY,
+                 &channel->closed, peer_pid);
+  this->outgoing = is_listener ? ring0 : ring1;
+  this->incoming = is_listener ? ring1 : ring0;
+}
+
+/**
+ * Marks the channel closed and wakes the peer; it reads what is left, then
+ * sees EOF. The rings stay valid, so calls already blocked on them wake and
+ * fail; later calls fail without touching them.
+ */
+void RingNetworkDriver::close_channel() {
+  ChannelHeader *channel =
+      this->channel.exchange(nullptr, std::memory_order_acq_rel);
+  if (channel) {
+    channel->closed.store(1, std::memory_order_release);
+    this->outgoing.notify();
+    this->incoming.notify();
+  }
+}
+
+/**
+ * Sends a length-prefixed message through the outgoing ring.
+ * @param data Bytes of data to send.
+ * @throws error if the channel is closed.
+ */
+void RingNetworkDriver::send(const std::vector<unsigned char> &data) {
+  if (!this->channel.load(std::memory_order_acquire)) {
+    throw std::runtime_error("Channel closed.");
+  }
+  uint64_t length = data.size();
+  this->outgoing.write(reinterpret_cast<unsigned char *>(&length),
+                       sizeof(uint64_t));
+  this->outgoing.write(data.data(), data.size());
+}
+
+/**
+ * Receives the next message from the incoming ring.
+ * @return std::vector<unsigned char> data read.
+ * @throws error when eof, if the channel is closed on this end, or if the
+ * message is longer than MAX_FRAME_LENGTH.
+ */
+std::vector<unsigned char> RingNetworkDriver::read() {
+  if (!this->channel.load(std::memory_order_acquire)) {
+    throw std::runtime_error("Channel closed.");
+  }
+  uint64_t length;
+  this->incoming.read(reinterpret_cast<unsigned char *>(&length),
+                      sizeof(uint64_t));
+  if (length > MAX_FRAME_LENGTH) {
+    throw std::runtime_error("Frame too long.");
+  }
+  std::vector<unsigned char> data(length);
+  this->incoming.read(data.data(), length);
+  return data;
+}
+
+// ================================================
+// SHARED MEMORY NETWORK DRIVER
+// ================================================
+
+ShmNetworkDriverImpl::ShmNetworkDriverImpl() : mapping(MAP_FAILED) {}
+
+/**
+ * Closes the channel and unmaps the segment.
+ */
+ShmNetworkDriverImpl::~ShmNetworkDriverImpl() {
+  this->disconnect();
+  if (this->mapping != MAP_FAILED) {
+    munmap(this->mapping, CHANNEL_SIZE);
+  }
+}
+
+/**
+ * Creates the shared memory object for the given port and waits for the
+ * peer to attach.
+ * @param port Port the segment is named after.
+ */
+void ShmNetworkDriverImpl::listen(int port) {
+  this->name = "/yaos-" + std::to_string(port);
+  shm_unlink(this->name.c_str()); // stale segment from a crashed run
+  int fd = shm_open(this->name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+  if (fd < 0) {
+    throw std::runtime_error("could not create shared memory segment");
+  }
+  if (ftruncate(fd, CHANNEL_SIZE) != 0) {
+    close(fd);
+    shm_unlink(this->name.c_str());
+    throw std::runtime_error("could not size shared memory segment");
+  }
+  this->mapping =
+      mmap(nullptr, CHANNEL_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (this->mapping == MAP_FAILED) {
+    shm_unlink(this->name.c_str());
+    throw std::runtime_error("could not map shared memory segment");
+  }
+
+  // The fresh object is zero-filled; construct the header in place and
+  // publish it last.
+  ChannelHeader *channel = new (this->mapping) ChannelHeader();
+  channel->pids[0].store(getpid(), std::memory_order_relaxed);
+  this->attach(channel, true);
+  channel->magic.store(SHM_MAGIC, std::memory_order_release);
+
+  // Sleep until the peer has mapped the segment; then it no longer needs a
+  // name.
+  while (channel->connected.load(std::memory_order_acquire) == 0) {
+    futex_wait(&channel->connected, 0);
+  }
+  shm_unlink(this->name.c_str());
+}
+
+/**
+ * Attaches to the shared memory object for the given port, retrying until
+ * the listener has created it. The address must be this host.
+ * @param address Ignored; both parties share the host.
+ * @param port Port the segment is named after.
+ */
+void ShmNetworkDriverImpl::connect([[maybe_unused]] std::string address,
+                                   int port) {
+  this->name = "/yaos-" + std::to_string(port);
+  ChannelHeader *channel = nullptr;
+  while (!channel) {
+    int fd = shm_open(this->name.c_str(), O_RDWR, 0600);
+    struct stat st;
+    if (fd >= 0 && fstat(fd, &st) == 0 && (size_t)st.st_size == CHANNEL_SIZE) {
+      this->mapping = mmap(nullptr, CHANNEL_SIZE, PROT_READ | PROT_WRITE,
+                           MAP_SHARED, fd, 0);
+      if (this->mapping != MAP_FAILED) {
+        channel = reinterpret_cast<ChannelHeader *>(this->mapping);
+        if (channel->magic.load(std::memory_order_acquire) != SHM_MAGIC) {
+          munmap(this->mapping, CHANNEL_SIZE);
+          this->mapping = MAP_FAILED;
+          channel = nullptr;
+        }
+      }
+    }
+    if (fd >= 0) {
+      close(fd);
+    }
+    if (!channel) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+  channel->pids[1].store(getpid(), std::memory_order_relaxed);
+  this->attach(channel, false);
+  channel->connected.store(1, std::memory_order_release);
+  futex_wake(&channel->connected);
+}
+
+/**
+ * Closes the channel. The segment stays mapped until destruction, since
+ * other threads may still be blocked on its rings.
+ */
+void ShmNetworkDriverImpl::disconnect() { this->close_channel(); }
+
+/**
+ * Get segment name as string.
+ */
+std::string ShmNetworkDriverImpl::get_remote_info() {
+  return "shm:" + this->name;
+}
+
+// ================================================
+// IN-PROCESS NETWORK DRIVER
+// ================================================
+
+/**
+ * Creates two connected ends of a heap-backed channel.
+ * @return (listener end, connector end).
+ */
+std::pair<std::shared_ptr<InProcessNetworkDriverImpl>,
+          std::shared_ptr<InProcessNetworkDriverImpl>>
+InProcessNetworkDriverImpl::make_pair() {
+  std::shared_ptr<unsigned char[]> storage(
+      new (std::align_val_t(64)) unsigned char[CHANNEL_SIZE],
+      [](unsigned char *p) { operator delete[](p, std::align_val_t(64)); });
+  ChannelHeader *channel = new (storage.get()) ChannelHeader();
+
+  auto listener = std::make_shared<InProcessNetworkDriverImpl>();
+  auto connector = std::make_shared<InProcessNetworkDriverImpl>();
+  listener->storage = storage;
+  connector->storage = storage;
+  listener->attach(channel, true);
+  connector->attach(channel, false);
+  return std::make_pair(listener, connector);
+}
+
+/**
+ * Closes the channel, so a peer blocked on it sees EOF instead of waiting
+ * for an end that is gone.
+ */
+InProcessNetworkDriverImpl::~InProcessNetworkDriverImpl() {
+  this->close_channel();
+}
+
+void InProcessNetworkDriverImpl::listen([[maybe_unused]] int port) {}
+
+void InProcessNetworkDriverImpl::connect([[maybe_unused]] std::string address,
+                                         [[maybe_unused]] int port) {}
+
+/**
+ * Closes the channel; the storage is freed with the last end.
+ */
+void InProcessNetworkDriverImpl::disconnect() { this->close_channel(); }
+
+/**
+ * Get channel info as string.
+ */
+std::string InProcessNetworkDriverImpl::get_remote_info() {
+  return "in-process";
+}
@@ -0,0 +1,247 @@
+#include <stdexcept>
+#include <vector>
+
+#include "../../include/drivers/striped_network_driver.hpp"
+
+using namespace boost::asio;
+using ip::tcp;
+
+/**
+ * Constructor. Sets up IO context; sockets are opened on listen/connect.
+ * @param num_connections Number of parallel connections to stripe over.
+ */
+StripedNetworkDriverImpl::StripedNetworkDriverImpl(int num_connections)
+    : io_context(), send_seq(0), recv_seq(0) {
+  if (num_connections < 1) {
+    throw std::runtime_error("need at least one connection");
+  }
+  this->num_connections = num_connections;
+}
+
+/**
+ * Listen on the given port at localhost and accept num_connections
+ * connections. Each connection announces its index first, so the order in
+ * which they are accepted doesn't matter.
+ * @param port Port to listen on.
+ */
+void StripedNetworkDriverImpl::listen(int port) {
+  tcp::acceptor acceptor(this->io_context, tcp::endpoint(tcp::v4(), port));
+  this->sockets.resize(this->num_connections);
+  for (int i = 0; i < this->num_connections; i++) {
+    auto socket = std::make_shared<tcp::socket>(this->io_context);
+    acceptor.accept(*socket);
+    socket->set_option(tcp::no_delay(true));
+
+    uint32_t index;
+    boost::asio::read(*socket, boost::asio::buffer(&index, sizeof(uint32_t)));
+    index = ntohl(index);
+    if (index >= (uint32_t)this->num_connections || this->sockets[index]) {
+      throw std::runtime_error("unexpected connection index");
+    }
+    this->sockets[index] = socket;
+  }
+}
+
+/**
+ * Open num_connections connections to the given address and port.
+ * @param address Address to connect to.
+ * @param port Port to conect to.
+ */
+void StripedNetworkDriverImpl::connect(std::string address, int port) {
+  if (address == "localhost")
+    address = "127.0.0.1";
+  for (int i = 0; i < this->num_connections; i++) {
+    auto socket = std::make_shared<tcp::socket>(this->io_context);
+    socket->connect(
+        tcp::endpoint(boost::asio::ip::address::from_string(address), port));
+    socket->set_option(tcp::no_delay(true));
+
+    uint32_t index = htonl(i);
+    boost::asio::write(*socket, boost::asio::buffer(&index, sizeof(uint32_t)));
+    this->sockets.push_back(socket);
+  }
+}
+
+/**
+ * Disconnect every connection gracefully.
+ */
+void StripedNetworkDriverImpl::disconnect() {
+  for (auto &socket : this->sockets) {
+    socket->shutdown(boost::asio::ip::tcp::socket::shutdown_both);
+    socket->close();
+  }
+  this->io_context.stop();
+}
+
+/**
+ * Splits data into chunks of NETWORK_CHUNK_SIZE bytes and sends them round
+ * robin over the connections, writing to all connections in parallel.
+ * @param data Bytes of data to send.
+ */
+void StripedNetworkDriverImpl::send(const std::vector<unsigned char> &data) {
+  uint64_t num_chunks =
+      std::max<uint64_t>(1, (data.size() + NETWORK_CHUNK_SIZE - 1) /
+                                NETWORK_CHUNK_SIZE);
+
+  // Gather each connection's chunks into one buffer sequence.
+  std::vector<StripeChunkHeader> headers(num_chunks);
+  std::vector<std::vector<boost::asio::const_buffer>> buffers(
+      this->num_connections);
+  for (uint64_t k = 0; k < num_chunks; k++) {
+    uint64_t offset = k * NETWORK_CHUNK_SIZE;
+    uint64_t chunk_length =
+        std::min<uint64_t>(NETWORK_CHUNK_SIZE, data.size() - offset);
+    headers[k].seq = htobe64(this->send_seq + k);
+    headers[k].message_length = htobe64(data.size());
+    headers[k].chunk_length = htobe64(chunk_length);
+
+    auto &stream = buffers[(this->send_seq + k) % this->num_connections];
+    stream.push_back(
+        boost::asio::buffer(&headers[k], sizeof(StripeChunkHeader)));
+    stream.push_back(boost::asio::buffer(data.data() + offset, chunk_length));
+  }
+  this->send_seq += num_chunks;
+
+  // Small messages fit in one chunk; don't spin up threads for them.
+  if (num_chunks == 1) {
+    for (int i = 0; i < this->num_connections; i++) {
+      if (!buffers[i].empty()) {
+        boost::asio::write(*this->sockets[i], buffers[i]);
+      }
+    }
+    return;
+  }
+
+  std::vector<std::future<void>> writes;
+  for (int i = 0; i < this->num_connections; i++) {
+    if (!buffers[i].empty()) {
+      writes.push_back(std::async(std::launch::async, [this, &buffers, i]() {
+        boost::asio::write(*this->sockets[i], buffers[i]);
+      }));
+    }
+  }
+  for (auto &write : writes) {
+    write.get();
+  }
+}
+
+/**
+ * Receives the next message, reading its chunks from all connections in
+ * parallel and reassembling them in sequence order.
+ * @return std::vector<unsigned char> data read.
+ * @throws error when eof, when chunks arrive out of sequence or when a chunk
+ * header doesn't match the message.
+ */
+std::vector<unsigned char> StripedNetworkDriverImpl::read() {
+  // Reads one chunk header from connection i and checks its sequence number.
+  auto read_header = [this](int i, uint64_t seq) {
+    StripeChunkHeader header;
+    boost::system::error_code error;
+    boost::asio::read(*this->sockets[i],
+                      boost::asio::buffer(&header, sizeof(StripeChunkHeader)),
+                      boost::asio::transfer_exactly(sizeof(StripeChunkHeader)),
+                      error);
+    if (error) {
+      throw std::runtime_error("Received EOF.");
+    }
+    header.seq = be64toh(header.seq);
+    header.message_length = be64toh(header.message_length);
+    header.chunk_length = be64toh(header.chunk_length);
+    if (header.seq != seq) {
+      throw std::runtime_error("Received chunk out of sequence.");
+    }
+    return header;
+  };
+  // Chunk k of a message must carry the message's length and exactly its
+  // share of it, so a corrupt header can't write past the buffer, and the
+  // message must be short enough to allocate.
+  auto check_chunk = [](const StripeChunkHeader &header,
+                        uint64_t message_length, uint64_t k) {
+    uint64_t offset = k * NETWORK_CHUNK_SIZE;
+    if (message_length > MAX_FRAME_LENGTH) {
+      throw std::runtime_error("Frame too long.");
+    }
+    if (header.message_length != message_length ||
+        header.chunk_length !=
+            std::min<uint64_t>(NETWORK_CHUNK_SIZE, message_length - offset)) {
+      throw std::runtime_error("Received malformed chunk.");
+    }
+  };
+  auto read_body = [this](int i, unsigned char *dst, uint64_t length) {
+    boost::system::error_code error;
+    boost::asio::read(*this->sockets[i], boost::asio::buffer(dst, length),
+                      boost::asio::transfer_exactly(length), error);
+    if (error) {
+      throw std::runtime_error("Received EOF.");
+    }
+  };
+
+  // The first chunk tells us how long the message is.
+  uint64_t first_seq = this->recv_seq;
+  StripeChunkHeader first =
+      read_header(first_seq % this->num_connections, first_seq);
+  check_chunk(first, first.message_length, 0);
+  std::vector<unsigned char> data(first.message_length);
+  read_body(first_seq % this->num_connections, data.data(), first.chunk_length);
+
+  uint64_t num_chunks =
+      std::max<uint64_t>(1, (first.message_length + NETWORK_CHUNK_SIZE - 1) /
+                                NETWORK_CHUNK_SIZE);
+  this->recv_seq += num_chunks;
+
+  // Each connection reads its remaining chunks in order, in parallel. If one
+  // fails, the others may wait forever for chunks that never come, so the
+  // failing one shuts every connection down before giving up; the others
+  // then fail too, and the first error is the one reported.
+  std::mutex error_mutex;
+  std::exception_ptr error;
+  std::vector<std::future<void>> reads;
+  for (int i = 0; i < this->num_connections && num_chunks > 1; i++) {
+    reads.push_back(std::async(std::launch::async, [&, i]() {
+      try {
+        for (uint64_t k = 1; k < num_chunks; k++) {
+          if ((first_seq + k) % this->num_connections != (uint64_t)i) {
+            continue;
+          }
+          StripeChunkHeader header = read_header(i, first_seq + k);
+          check_chunk(header, first.message_length, k);
+          read_body(i, data.data() + k * NETWORK_CHUNK_SIZE,
+                    header.chunk_length);
+        }
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(error_mutex);
+        if (!error) {
+          error = std::current_exception();
+          this->shutdown_sockets();
+        }
+      }
+    }));
+  }
+  // Wait for every read before rethrowing; they all write into data.
+  for (auto &read : reads) {
+    read.get();
+  }
+  if (error) {
+    std::rethrow_exception(error);
+  }
+  return data;
+}
+
+/**
+ * Shut down every connection in both directions, waking any blocked reads.
+ */
+void StripedNetworkDriverImpl::shutdown_sockets() {
+  for (auto &socket : this->sockets) {
+    boost::system::error_code error;
+    socket->shutdown(boost::asio::ip::tcp::socket::shutdown_both, error);
+  }
+}
+
+/**
+ * Get socket info as string.
+ */
+std::string StripedNetworkDriverImpl::get_remote_info() {
+  return this->sockets[0]->remote_endpoint().address().to_string() + ":" +
+         std::to_string(this->sockets[0]->remote_endpoint().port()) + " (x" +
+         std::to_string(this->num_connections) + ")";
+}
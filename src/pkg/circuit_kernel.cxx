@@ -0,0 +1,127 @@
+#include <map>
+#include <mutex>
+#include <stdexcept>
+
+#include "../../include/pkg/circuit_kernel.hpp"
+
+namespace {
+// Kernels linked into this binary, by circuit fingerprint. Built on first
+// use, since generated kernels register during static initialization; the
+// lock covers registrations coming and going while other threads garble.
+struct KernelRegistry {
+  std::mutex mutex;
+  std::map<uint64_t, const CircuitKernel *> kernels;
+};
+
+KernelRegistry &kernel_registry() {
+  static KernelRegistry registry;
+  return registry;
+}
+} // namespace
+
+/**
+ * Register `kernel` until this registration is destroyed, shadowing any
+ * kernel registered with the same fingerprint.
+ */
+CircuitKernelRegistration::CircuitKernelRegistration(
+    const CircuitKernel *kernel)
+    : kernel(kernel), shadowed(nullptr) {
+  auto &registry = kernel_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  const CircuitKernel *&registered = registry.kernels[kernel->fingerprint];
+  this->shadowed = registered;
+  registered = kernel;
+}
+
+/**
+ * Unregister the kernel, bringing back the one it shadowed.
+ */
+CircuitKernelRegistration::~CircuitKernelRegistration() {
+  auto &registry = kernel_registry();
+  std::lock_guard<std::mutex> lock(registry.mutex);
+  auto it = registry.kernels.find(this->kernel->fingerprint);
+  if (it == registry.kernels.end() || it->second != this->kernel) {
+    return;
+  }
+  if (this->shadowed) {
+    it->second = this->shadowed;
+  } else {
+    registry.kernels.erase(it);
+  }
+}
+
+/**
+ * Kernel generated for exactly this circuit, or nullptr if none is linked in.
+ * Besides the fingerprint, the kernel must agree on the number of gates,
+ * wires and table entries, since it indexes wires and tables blindly.
+ */
+const CircuitKernel *find_circuit_kernel(const Circuit &circuit) {
+  auto &registry = kernel_registry();
+  const CircuitKernel *kernel;
+  {
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    if (registry.kernels.empty()) {
+      return nullptr;
+    }
+    auto it = registry.kernels.find(circuit_fingerprint(circuit));
+    if (it == registry.kernels.end()) {
+      return nullptr;
+    }
+    kernel = it->second;
+  }
+  if (kernel->num_gate != circuit.num_gate ||
+      kernel->num_wire != circuit.num_wire ||
+      (size_t)kernel->num_table_entries !=
+          count_table_entries<KernelScheme>(circuit)) {
+    return nullptr;
+  }
+  return kernel;
+}
+
+/**
+ * Garble `circuit` with its kernel: random input labels and offset, then
+ * one straight-line pass. The tables stay packed as the kernel wrote them,
+ * for sending as is. Only the input and output wires' labels are returned;
+ * the protocol never needs the rest.
+ */
+GarbledInstance garble_with_kernel(const CircuitKernel &kernel,
+                                   const Circuit &circuit) {
+  auto ctx = KernelScheme::random_context();
+  int num_inputs = circuit.garbler_input_length + circuit.evaluator_input_length;
+  std::vector<KernelLabel> wires(circuit.num_wire);
+  for (int i = 0; i < num_inputs; i++) {
+    wires[i] = KernelScheme::random_label();
+  }
+
+  GarbledInstance instance;
+  PackedTables &tables = instance.packed_tables;
+  tables.entry_length = KernelScheme::entry_width;
+  tables.entries.resize(kernel.num_table_entries * KernelScheme::entry_width);
+  kernel.garble(ctx, wires.data(),
+                reinterpret_cast<KernelLabel *>(tables.entries.data()));
+  tables.sizes.reserve(circuit.num_gate);
+  for (auto &gate : circuit.gates) {
+    tables.sizes.push_back(gate_table_size<KernelScheme>(circuit, gate));
+  }
+  keep_protocol_labels<KernelScheme>(circuit, wires.data(), ctx,
+                                     instance.labels);
+  return instance;
+}
+
+/**
+ * Evaluate `circuit` with its kernel on received tables and input labels.
+ * @return labels of the output wires.
+ * @throws error if the tables don't have the shape the kernel expects.
+ */
+std::vector<GarbledWire>
+evaluate_with_kernel(const CircuitKernel &kernel, const Circuit &circuit,
+                     const std::vector<GarbledGate> &tables,
+                     const std::vector<GarbledWire> &garbler_inputs,
+                     const std::vector<GarbledWire> &evaluator_inputs) {
+  return evaluate_instance<KernelScheme>(
+      circuit, tables, garbler_inputs, evaluator_inputs,
+      [&](const KernelContext &ctx, KernelLabel *wires,
+          const KernelLabel *flat_tables) {
+        kernel.evaluate(ctx, wires, flat_tables);
+      });
+}
@@ -1,4 +1,8 @@
+#include <chrono>
+
+#include "../../include/pkg/circuit_kernel.hpp"
 #include "../../include/pkg/evaluator.hpp"
+#include "../../include/pkg/garbling_scheme.hpp"
 #include "../../include-shared/constants.hpp"
 #include "../../include-shared/util.hpp"
 #include "../../include-shared/logger.hpp"
@@ -16,8 +20,17 @@ namespace {
  * Constructor. Note that the OT_driver is left uninitialized.
  */
 EvaluatorClient::EvaluatorClient(Circuit circuit,
-                           std::shared_ptr<NetworkDriver> network_driver,
-                           std::shared_ptr<CryptoDriver> crypto_driver) {
+                                 std::shared_ptr<NetworkDriver> network_driver,
+                                 std::shared_ptr<CryptoDriver> crypto_driver)
+    : EvaluatorClient(std::make_shared<const Circuit>(std::move(circuit)),
+                      network_driver, crypto_driver) {}
+
+/**
+ * Constructor sharing an already parsed circuit.
+ */
+EvaluatorClient::EvaluatorClient(std::shared_ptr<const Circuit> circuit,
+                                 std::shared_ptr<NetworkDriver> network_driver,
+                                 std::shared_ptr<CryptoDriver> crypto_driver) {
   this->circuit = circuit;
   this->network_driver = network_driver;
   this->crypto_driver = crypto_driver;
@@ -42,7 +55,7 @@ EvaluatorClient::HandleKeyExchange() {
   evaluator_public_value_s.public_value = std::get<2>(dh_values);
   std::vector<unsigned char> evaluator_public_value_data;
   evaluator_public_value_s.serialize(evaluator_public_value_data);
-  network_driver->send(evaluator_public_value_data);
+  network_driver->send(std::move(evaluator_public_value_data));
 
   // Recover g^ab
   CryptoPP::SecByteBlock DH_shared_key = crypto_driver->DH_generate_shared_key(
@@ -76,130 +89,282 @@ std::string EvaluatorClient::run(std::vector<int> input) {
   this->AES_key = keys.first;
   this->HMAC_key = keys.second;
 
-  // TODO: implement me!
-  GarblerToEvaluator_GarbledTables_Message ge_gt_msg;
-  auto ge_gt_msg_data = this->crypto_driver->decrypt_and_verify(AES_key, HMAC_key, this->network_driver->read());
-  if (!ge_gt_msg_data.second) {
-    this->network_driver->disconnect();
-    throw std::runtime_error("oopsie poopsie");
-  }
-  ge_gt_msg.deserialize(ge_gt_msg_data.first);
-  auto garbled_gates = ge_gt_msg.garbled_tables;
+  this->prepare_evaluation();
+  return this->evaluate(input);
+}
 
-  GarblerToEvaluator_GarblerInputs_Message ge_gi_msg;
-  auto ge_gi_msg_data = this->crypto_driver->decrypt_and_verify(AES_key, HMAC_key, this->network_driver->read());
-  if (!ge_gi_msg_data.second) {
-    this->network_driver->disconnect();
-    throw std::runtime_error("oopsie poopsie 2");
+/**
+ * Run a session: one key exchange and one set of base OTs, then one
+ * evaluation per header the garbler sends. Each header must name the
+ * circuit of our next job.
+ * @return output of every evaluation, in order.
+ */
+std::vector<std::string>
+EvaluatorClient::run_session(const std::vector<EvaluationJob> &jobs) {
+  auto keys = this->HandleKeyExchange();
+  this->AES_key = keys.first;
+  this->HMAC_key = keys.second;
+  this->ot_driver->OT_extension_setup_recv();
+
+  std::vector<std::string> outputs;
+  while (true) {
+    GarblerToEvaluator_EvaluationHeader_Message header;
+    auto header_data = this->crypto_driver->decrypt_and_verify(
+        this->AES_key, this->HMAC_key, this->network_driver->read());
+    if (!header_data.second) {
+      this->network_driver->disconnect();
+      throw std::runtime_error("invalid mac");
+    }
+    header.deserialize(header_data.first);
+    if (header.done) {
+      break;
+    }
+
+    if (outputs.size() >= jobs.size() ||
+        header.circuit_name != jobs[outputs.size()].circuit_name) {
+      this->network_driver->disconnect();
+      throw std::runtime_error("garbler sent unexpected circuit " +
+                               header.circuit_name);
+    }
+    const EvaluationJob &job = jobs[outputs.size()];
+    this->set_circuit(job.circuit);
+    this->prepare_evaluation();
+    outputs.push_back(this->evaluate(job.input));
   }
-  ge_gi_msg.deserialize(ge_gi_msg_data.first);
-  auto garbler_inputs = ge_gi_msg.garbler_inputs;
+  if (outputs.size() != jobs.size()) {
+    this->cli_driver->print_warning("Garbler ended the session after " +
+                                    std::to_string(outputs.size()) + " of " +
+                                    std::to_string(jobs.size()) + " jobs");
+  }
+  return outputs;
+}
+
+/**
+ * Replace the circuit evaluated by the next call to evaluate.
+ */
+void EvaluatorClient::set_circuit(std::shared_ptr<const Circuit> circuit) {
+  this->circuit = circuit;
+}
+
+/**
+ * Offline phase of one evaluation: random OTs for our inputs, run while the
+ * garbler is still garbling. Must be matched by
+ * GarblerClient::prepare_evaluation.
+ */
+void EvaluatorClient::prepare_evaluation() {
+  this->ot_driver->OT_precompute_recv(this->circuit->evaluator_input_length);
+}
+
+/**
+ * Evaluate this->circuit once over an established connection; steps 1-6 of
+ * run. Consumes the random OTs from prepare_evaluation, running more only if
+ * there weren't enough.
+ */
+std::string EvaluatorClient::evaluate(std::vector<int> input) {
+  auto garbled_circuit = this->receive_garbled_circuit();
 
+  std::vector<int> choice_bits;
+  for (int i = 0; i < this->circuit->evaluator_input_length; ++i) {
+    choice_bits.push_back(input.at(i));
+  }
   std::vector<GarbledWire> evaluator_inputs;
-  for (int i = 0; i < circuit.evaluator_input_length; ++i) {
-    auto label = this->ot_driver->OT_recv(input.at(i));
+  for (auto label : this->ot_driver->OT_recv_precomputed(choice_bits)) {
     GarbledWire wire;
     wire.value = string_to_byteblock(label);
     evaluator_inputs.push_back(wire);
   }
 
-  std::vector<GarbledWire> garbled_wires(this->circuit.num_wire);
-  // copy the garbler's inputs in
-  for (int i = 0; i < circuit.garbler_input_length; i++) {
-    garbled_wires.at(i) = garbler_inputs.at(i);
-  }
-  // copy the evaluators inputs in
-  for (int i = 0; i < circuit.evaluator_input_length; i++) {
-    garbled_wires.at(circuit.garbler_input_length + i) = evaluator_inputs.at(i);
-  }
-  // evaluate remaining wires
-  for (int i = 0; i < circuit.num_gate; i++) {
-    Gate gate = circuit.gates.at(i);
-    GarbledWire wire;
-    if (gate.type == GateType::NOT_GATE) {
-      GarbledWire dummy_wire;
-      dummy_wire.value = DUMMY_RHS;
-      wire = this->evaluate_gate(
-          garbled_gates.at(i), garbled_wires.at(gate.lhs), dummy_wire);
-    } else if (gate.type == GateType::XOR_GATE) {
-      wire.value = SecByteBlock(garbled_wires.at(gate.lhs).value);
-      CryptoPP::xorbuf(wire.value, garbled_wires.at(gate.rhs).value, LABEL_LENGTH);
-    } else {
-      wire = this->evaluate_gate(
-          garbled_gates.at(i), garbled_wires.at(gate.lhs), garbled_wires.at(gate.rhs));
+  EvaluatorToGarbler_FinalLabels_Message finalLabelsMessage;
+  finalLabelsMessage.final_labels =
+      this->evaluate_circuit(garbled_circuit, evaluator_inputs);
+  this->network_driver->send(this->crypto_driver->encrypt_and_tag(this->AES_key, this->HMAC_key, &finalLabelsMessage));
+
+  // receive final output
+  std::string output = this->receive_output();
+  std::cout << output << std::endl;
+  return output;
+}
+
+/**
+ * Evaluate one instance per input vector over a single handshake. All OT
+ * corrections go out in one message up front; after that the garbler streams
+ * instances while we evaluate them as they arrive, and final outputs come
+ * back together at the end. Reports throughput.
+ * @return output of every instance, in order.
+ */
+std::vector<std::string>
+EvaluatorClient::run_batch(const std::vector<std::vector<int>> &inputs) {
+  auto start = std::chrono::steady_clock::now();
+  auto keys = this->HandleKeyExchange();
+  this->AES_key = keys.first;
+  this->HMAC_key = keys.second;
+  this->ot_driver->OT_extension_setup_recv();
+
+  // One batch of random OTs and one message of corrections for everything.
+  size_t k = this->circuit->evaluator_input_length;
+  this->ot_driver->OT_precompute_recv(inputs.size() * k);
+  std::vector<int> choice_bits;
+  for (auto &input : inputs) {
+    for (size_t i = 0; i < k; i++) {
+      choice_bits.push_back(input.at(i));
     }
-    garbled_wires.at(gate.output) = wire;
   }
+  auto pads = this->ot_driver->OT_send_corrections(choice_bits);
 
-  EvaluatorToGarbler_FinalLabels_Message finalLabelsMessage;
-  for (int i = 0; i < circuit.output_length; i++) {
-    finalLabelsMessage.final_labels.push_back(garbled_wires.at(circuit.num_wire - circuit.output_length + i));
+  for (size_t n = 0; n < inputs.size(); n++) {
+    auto garbled_circuit = this->receive_garbled_circuit();
+    std::vector<int> instance_bits(choice_bits.begin() + n * k,
+                                   choice_bits.begin() + (n + 1) * k);
+    std::vector<CryptoPP::SecByteBlock> instance_pads(
+        pads.begin() + n * k, pads.begin() + (n + 1) * k);
+    std::vector<GarbledWire> evaluator_inputs;
+    for (auto label :
+         this->ot_driver->OT_recv_masked(instance_bits, instance_pads)) {
+      GarbledWire wire;
+      wire.value = string_to_byteblock(label);
+      evaluator_inputs.push_back(wire);
+    }
+
+    EvaluatorToGarbler_FinalLabels_Message finalLabelsMessage;
+    finalLabelsMessage.final_labels =
+        this->evaluate_circuit(garbled_circuit, evaluator_inputs);
+    this->network_driver->send(this->crypto_driver->encrypt_and_tag(
+        this->AES_key, this->HMAC_key, &finalLabelsMessage));
   }
-  this->network_driver->send(this->crypto_driver->encrypt_and_tag(this->AES_key, this->HMAC_key, &finalLabelsMessage));
 
-  // receive final output
-  GarblerToEvaluator_FinalOutput_Message finalOutputMessage;
-  auto finalOutputMessage_data = this->crypto_driver->decrypt_and_verify(AES_key, HMAC_key, this->network_driver->read());
-  if (!finalOutputMessage_data.second) {
-    this->network_driver->disconnect();
-    throw std::runtime_error("oopsie poopsie 2");
+  std::vector<std::string> outputs;
+  for (size_t n = 0; n < inputs.size(); n++) {
+    outputs.push_back(this->receive_output());
+    std::cout << outputs.back() << std::endl;
   }
-  finalOutputMessage.deserialize(finalOutputMessage_data.first);
 
-  std::cout << finalOutputMessage.final_output << std::endl;
-  return finalOutputMessage.final_output;
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  this->cli_driver->print_success(
+      "Evaluated " + std::to_string(inputs.size()) + " instances in " +
+      std::to_string(seconds) + " s (" +
+      std::to_string(inputs.size() / seconds) + " evaluations/s)");
+  return outputs;
 }
 
 /**
- * Evaluate gate.
- * You may find CryptoPP::xorbuf and CryptoDriver::hash_inputs useful.
- * To determine if a decryption is valid, use verify_decryption.
- * To retrieve the label from a decryption, use snip_decryption.
+ * Spill garbled tables to files in spill_dir as they arrive instead of
+ * keeping them in memory; the garbler must spill too. Empty to keep tables
+ * in memory.
  */
-GarbledWire EvaluatorClient::evaluate_gate(GarbledGate gate, GarbledWire lhs,
-                                        GarbledWire rhs) {
-  // DONE: implement me!
-  GarbledWire out;
-  auto lhs_b = first_bit(lhs.value);
-  auto rhs_b = first_bit(rhs.value);
+void EvaluatorClient::set_spill_dir(std::string spill_dir) {
+  this->spill_dir = spill_dir;
+}
 
-  SecByteBlock hashed_val = this->crypto_driver->hash_inputs(lhs.value, rhs.value);
+/**
+ * Evaluate AND and NOT gates with the given scheme; must match the garbler's.
+ */
+void EvaluatorClient::set_scheme(SchemeType::T scheme) { this->scheme = scheme; }
 
-  if (!lhs_b && !rhs_b) {
-    out.value = hashed_val;
-  } else {
-    int idx;
-    if (rhs.value == DUMMY_RHS) {
-      idx = lhs_b;
-    } else {
-      idx = 2 * lhs_b + rhs_b;
-    }
+/**
+ * Check that garbled tables arrived the way this->spill_dir expects them:
+ * in one message when in memory, in chunks when spilling. Both parties must
+ * spill or neither; the message type tells which the garbler does.
+ * @throws error, after disconnecting, if they don't match.
+ */
+void EvaluatorClient::check_spilling(std::vector<unsigned char> &data) {
+  MessageType::T expected =
+      this->spill_dir.empty()
+          ? MessageType::GarblerToEvaluator_GarbledTables_Message
+          : MessageType::GarblerToEvaluator_GarbledTablesChunk_Message;
+  if (data.empty() || get_message_type(data) != expected) {
+    this->network_driver->disconnect();
+    throw std::runtime_error(this->spill_dir.empty()
+                                 ? "garbler spills its tables; pass --spill "
+                                   "to the evaluator too"
+                                 : "garbler doesn't spill its tables; drop "
+                                   "--spill on the evaluator");
+  }
+}
 
-    if (idx > 0) {
-      auto entry = gate.entries[idx-1];
-      CryptoPP::xorbuf(hashed_val, entry, LABEL_LENGTH + LABEL_TAG_LENGTH);
-      out.value = hashed_val;
-    } else {
-      out.value = hashed_val;
+/**
+ * Receive the garbled tables and the garbler's input labels. With a spill
+ * directory the tables arrive in chunks and go straight to a TableStore.
+ */
+ReceivedCircuit EvaluatorClient::receive_garbled_circuit() {
+  ReceivedCircuit garbled_circuit;
+  if (this->spill_dir.empty()) {
+    GarblerToEvaluator_GarbledTables_Message ge_gt_msg;
+    auto ge_gt_msg_data = this->crypto_driver->decrypt_and_verify(AES_key, HMAC_key, this->network_driver->read());
+    if (!ge_gt_msg_data.second) {
+      this->network_driver->disconnect();
+      throw std::runtime_error("oopsie poopsie");
     }
+    this->check_spilling(ge_gt_msg_data.first);
+    ge_gt_msg.deserialize(ge_gt_msg_data.first);
+    garbled_circuit.tables = std::move(ge_gt_msg.garbled_tables);
+  } else {
+    garbled_circuit.spilled_tables = std::make_shared<TableStore>(
+        this->spill_dir, table_entry_length(this->scheme));
+    GarblerToEvaluator_GarbledTablesChunk_Message chunk_msg;
+    do {
+      auto chunk_msg_data = this->crypto_driver->decrypt_and_verify(AES_key, HMAC_key, this->network_driver->read());
+      if (!chunk_msg_data.second) {
+        this->network_driver->disconnect();
+        throw std::runtime_error("invalid mac on garbled tables");
+      }
+      this->check_spilling(chunk_msg_data.first);
+      chunk_msg.deserialize(chunk_msg_data.first);
+      garbled_circuit.spilled_tables->append_bytes(chunk_msg.tables.data(), chunk_msg.tables.size());
+    } while (!chunk_msg.last);
+    garbled_circuit.spilled_tables->finish();
   }
 
-  return out;
+  GarblerToEvaluator_GarblerInputs_Message ge_gi_msg;
+  auto ge_gi_msg_data = this->crypto_driver->decrypt_and_verify(AES_key, HMAC_key, this->network_driver->read());
+  if (!ge_gi_msg_data.second) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("oopsie poopsie 2");
+  }
+  ge_gi_msg.deserialize(ge_gi_msg_data.first);
+  garbled_circuit.garbler_inputs = std::move(ge_gi_msg.garbler_inputs);
+  return garbled_circuit;
 }
 
 /**
- * Verify decryption. A valid dec should end with LABEL_TAG_LENGTH bits of 0s.
+ * Evaluate this->circuit on the given input labels. In-memory tables go to a
+ * generated kernel when one is linked in for this circuit, else to the
+ * scheme's engine; spilled tables are read front to back, one gate at a time.
+ * @return labels of the output wires.
+ * @throws error for tables that don't match the scheme, or spilled branches.
  */
-bool EvaluatorClient::verify_decryption(CryptoPP::SecByteBlock decryption) {
-  CryptoPP::SecByteBlock trail(decryption.data() + LABEL_LENGTH,
-                               LABEL_TAG_LENGTH);
-  return byteblock_to_integer(trail) == CryptoPP::Integer::Zero();
+std::vector<GarbledWire> EvaluatorClient::evaluate_circuit(
+    ReceivedCircuit &garbled_circuit,
+    const std::vector<GarbledWire> &evaluator_inputs) {
+  const std::vector<GarbledWire> &garbler_inputs = garbled_circuit.garbler_inputs;
+  if (garbled_circuit.spilled_tables) {
+    return evaluate_spilled_with_scheme(
+        this->scheme, *this->circuit, *garbled_circuit.spilled_tables,
+        garbler_inputs, evaluator_inputs);
+  }
+  auto kernel = this->scheme == SchemeType::GRR3
+                    ? find_circuit_kernel(*this->circuit)
+                    : nullptr;
+  if (kernel) {
+    return evaluate_with_kernel(*kernel, *this->circuit, garbled_circuit.tables,
+                                garbler_inputs, evaluator_inputs);
+  }
+  return evaluate_with_scheme(this->scheme, *this->circuit,
+                              garbled_circuit.tables, garbler_inputs,
+                              evaluator_inputs);
 }
 
 /**
- * Returns the first LABEL_LENGTH bits of a decryption.
+ * Receive the final output from the garbler.
  */
-CryptoPP::SecByteBlock EvaluatorClient::snip_decryption(CryptoPP::SecByteBlock decryption) {
-  CryptoPP::SecByteBlock head(decryption.data(), LABEL_LENGTH);
-  return head;
+std::string EvaluatorClient::receive_output() {
+  GarblerToEvaluator_FinalOutput_Message finalOutputMessage;
+  auto finalOutputMessage_data = this->crypto_driver->decrypt_and_verify(AES_key, HMAC_key, this->network_driver->read());
+  if (!finalOutputMessage_data.second) {
+    this->network_driver->disconnect();
+    throw std::runtime_error("oopsie poopsie 2");
+  }
+  finalOutputMessage.deserialize(finalOutputMessage_data.first);
+  return finalOutputMessage.final_output;
 }
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include <stdexcept>
+
+#include "../../include-shared/constants.hpp"
+#include "../../include-shared/messages.hpp"
+#include "../../include/pkg/garbled_circuit_pool.hpp"
+#include "../../include/pkg/garbler.hpp"
+
+/**
+ * Constructor. Starts the producers, which fill the pool right away. The
+ * pool holds the smaller of depth and the number of instances that fit in
+ * memory_limit.
+ * @param circuit Circuit to garble.
+ * @param depth Upper bound on instances held at once.
+ * @param memory_limit Memory budget for all instances in bytes, 0 for none.
+ * @param num_producers Number of background garbling threads.
+ * @throws error if a single instance doesn't fit in memory_limit.
+ */
+GarbledCircuitPool::GarbledCircuitPool(std::shared_ptr<const Circuit> circuit,
+                                       size_t depth, size_t memory_limit,
+                                       int num_producers)
+    : circuit(circuit), in_production(0), stopping(false) {
+  if (memory_limit > 0) {
+    size_t per_instance = instance_memory(*circuit);
+    if (per_instance > memory_limit) {
+      throw std::runtime_error("memory limit too small for one instance");
+    }
+    depth = std::min(depth, memory_limit / per_instance);
+  }
+  this->depth = std::max<size_t>(1, depth);
+  num_producers = std::max(1, std::min<int>(num_producers, this->depth));
+  for (int i = 0; i < num_producers; i++) {
+    this->producers.emplace_back([this]() { this->produce(); });
+  }
+}
+
+/**
+ * Destructor. Stops the producers once their current instance is done.
+ */
+GarbledCircuitPool::~GarbledCircuitPool() {
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopping = true;
+  }
+  this->slot_free.notify_all();
+  for (auto &producer : this->producers) {
+    producer.join();
+  }
+}
+
+/**
+ * Circuit this pool garbles.
+ */
+std::shared_ptr<const Circuit> GarbledCircuitPool::get_circuit() {
+  return this->circuit;
+}
+
+/**
+ * Number of instances this pool keeps ready.
+ */
+size_t GarbledCircuitPool::get_depth() { return this->depth; }
+
+/**
+ * Remove one garbled instance from the pool, waiting for a producer if it is
+ * empty. Each instance is returned by exactly one call, and each producer
+ * failure is thrown by exactly one call; the producers then refill the pool.
+ * @throws error if a producer failed.
+ */
+std::unique_ptr<PregarbledInstance> GarbledCircuitPool::take() {
+  std::unique_ptr<PregarbledInstance> instance;
+  {
+    std::unique_lock<std::mutex> lock(this->mutex);
+    this->instance_ready.wait(lock, [this]() {
+      return !this->instances.empty() || this->error;
+    });
+    if (this->instances.empty()) {
+      std::exception_ptr error = this->error;
+      this->error = nullptr;
+      lock.unlock();
+      this->slot_free.notify_all();
+      std::rethrow_exception(error);
+    }
+    instance = std::move(this->instances.front());
+    this->instances.pop_front();
+  }
+  this->slot_free.notify_one();
+  return instance;
+}
+
+/**
+ * Rough upper bound on the memory one instance holds: both labels of every
+ * wire and the serialized tables with their length prefixes.
+ */
+size_t GarbledCircuitPool::instance_memory(const Circuit &circuit) {
+  size_t labels = 2 * (size_t)circuit.num_wire * LABEL_LENGTH;
+  size_t tables = 4 * (size_t)circuit.num_gate * (LABEL_LENGTH + 8);
+  return labels + tables;
+}
+
+/**
+ * Producer loop: garble and serialize an instance whenever there is room.
+ * After a failure, producers wait until take() has reported it before
+ * garbling again, so a persistent failure doesn't spin.
+ */
+void GarbledCircuitPool::produce() {
+  // Garbling only needs labels and tables, never the network.
+  GarblerClient garbler(this->circuit, nullptr,
+                        std::make_shared<CryptoDriver>());
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      this->slot_free.wait(lock, [this]() {
+        return this->stopping ||
+               (!this->error &&
+                this->instances.size() + this->in_production < this->depth);
+      });
+      if (this->stopping) {
+        return;
+      }
+      this->in_production++;
+    }
+
+    auto instance = std::make_unique<PregarbledInstance>();
+    try {
+      GarbledInstance garbled = garbler.garble();
+      instance->labels = std::move(garbled.labels);
+      GarblerToEvaluator_GarbledTables_Message garbledTablesMessage;
+      garbledTablesMessage.garbled_tables = std::move(garbled.tables);
+      garbledTablesMessage.packed_tables = std::move(garbled.packed_tables);
+      garbledTablesMessage.serialize(instance->tables);
+    } catch (...) {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->in_production--;
+      if (!this->error) {
+        this->error = std::current_exception();
+      }
+      this->instance_ready.notify_all();
+      continue;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->in_production--;
+      this->instances.push_back(std::move(instance));
+    }
+    this->instance_ready.notify_one();
+  }
+}
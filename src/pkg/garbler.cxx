@@ -1,10 +1,15 @@
 #include <algorithm>
+#include <chrono>
 #include <crypto++/misc.h>
 #include <set>
 
 #include "../../include-shared/constants.hpp"
+#include "../../include-shared/prg.hpp"
+#include "../../include-shared/table_store.hpp"
 #include "../../include-shared/util.hpp"
+#include "../../include/pkg/circuit_kernel.hpp"
 #include "../../include/pkg/garbler.hpp"
+#include "../../include/pkg/garbling_scheme.hpp"
 #include "../../include-shared/logger.hpp"
 
 /*
@@ -20,6 +25,15 @@ namespace {
  * Constructor. Note that the OT_driver is left uninitialized.
  */
 GarblerClient::GarblerClient(Circuit circuit,
+                             std::shared_ptr<NetworkDriver> network_driver,
+                             std::shared_ptr<CryptoDriver> crypto_driver)
+    : GarblerClient(std::make_shared<const Circuit>(std::move(circuit)),
+                    network_driver, crypto_driver) {}
+
+/**
+ * Constructor sharing an already parsed circuit.
+ */
+GarblerClient::GarblerClient(std::shared_ptr<const Circuit> circuit,
                              std::shared_ptr<NetworkDriver> network_driver,
                              std::shared_ptr<CryptoDriver> crypto_driver) {
   this->circuit = circuit;
@@ -41,7 +55,7 @@ GarblerClient::HandleKeyExchange() {
   garbler_public_value_s.public_value = std::get<2>(dh_values);
   std::vector<unsigned char> garbler_public_value_data;
   garbler_public_value_s.serialize(garbler_public_value_data);
-  network_driver->send(garbler_public_value_data);
+  network_driver->send(std::move(garbler_public_value_data));
 
   // Listen for g^a
   std::vector<unsigned char> evaluator_public_value_data = network_driver->read();
@@ -79,228 +93,366 @@ std::string GarblerClient::run(std::vector<int> input) {
   this->AES_key = keys.first;
   this->HMAC_key = keys.second;
 
-  // DONE: implement me!
-  GarbledLabels labels = this->generate_labels(this->circuit);
+  this->prepare_evaluation();
+  return this->evaluate(input);
+}
 
-  GarblerToEvaluator_GarbledTables_Message garbledTablesMessage;
-  garbledTablesMessage.garbled_tables = this->generate_gates(this->circuit, labels);
-  auto garbledTablesMessage_data = this->crypto_driver->encrypt_and_tag(this->AES_key, this->HMAC_key, &garbledTablesMessage);
-  this->network_driver->send(garbledTablesMessage_data);
+/**
+ * Run a session: one key exchange and one set of base OTs, then one freshly
+ * garbled evaluation per job, each announced with a header naming its
+ * circuit. A final header ends the session.
+ * @return output of every evaluation, in order.
+ */
+std::vector<std::string>
+GarblerClient::run_session(const std::vector<EvaluationJob> &jobs) {
+  auto keys = this->HandleKeyExchange();
+  this->AES_key = keys.first;
+  this->HMAC_key = keys.second;
+  this->ot_driver->OT_extension_setup_send();
+
+  std::vector<std::string> outputs;
+  for (auto &job : jobs) {
+    GarblerToEvaluator_EvaluationHeader_Message header;
+    header.circuit_name = job.circuit_name;
+    header.done = false;
+    this->network_driver->send(this->crypto_driver->encrypt_and_tag(
+        this->AES_key, this->HMAC_key, &header));
+
+    // Keep a circuit already garbling in the background if it's this one.
+    if (job.circuit != this->circuit) {
+      this->set_circuit(job.circuit);
+    }
+    this->prepare_evaluation();
+    outputs.push_back(this->evaluate(job.input));
+  }
+
+  GarblerToEvaluator_EvaluationHeader_Message done;
+  done.done = true;
+  this->network_driver->send(this->crypto_driver->encrypt_and_tag(
+      this->AES_key, this->HMAC_key, &done));
+  return outputs;
+}
+
+/**
+ * Replace the circuit garbled by the next call to evaluate, dropping any
+ * garbling of the old circuit still pending.
+ */
+void GarblerClient::set_circuit(std::shared_ptr<const Circuit> circuit) {
+  this->drop_pending_garbling();
+  this->circuit = circuit;
+}
+
+/**
+ * Offline phase of one evaluation: random OTs for the evaluator's inputs.
+ * Garbling needs no connection, so it's started first and runs underneath the
+ * OT round trips. Must be matched by EvaluatorClient::prepare_evaluation.
+ */
+void GarblerClient::prepare_evaluation() {
+  if (!this->pending_garbling.valid() &&
+      !(this->pool && this->pool->get_circuit() == this->circuit)) {
+    this->start_garbling();
+  }
+  this->ot_driver->OT_precompute_send(this->circuit->evaluator_input_length);
+}
+
+/**
+ * Garble and evaluate this->circuit once over an established connection;
+ * steps 1-5 of run. Consumes the random OTs from prepare_evaluation, running
+ * more only if there weren't enough.
+ */
+std::string GarblerClient::evaluate(std::vector<int> input) {
+  // DONE: implement me!
+  // Take a pregarbled instance from the pool if there is one for this
+  // circuit, else use the circuit garbled in the background if
+  // start_garbling was called.
+  GarbledLabels labels;
+  std::vector<unsigned char> garbledTablesMessage_data;
+  std::shared_ptr<TableStore> spilled_tables;
+  if (this->pool && this->pool->get_circuit() == this->circuit) {
+    std::unique_ptr<PregarbledInstance> pregarbled = this->pool->take();
+    labels = std::move(pregarbled->labels);
+    garbledTablesMessage_data = this->crypto_driver->encrypt_and_tag(this->AES_key, this->HMAC_key, pregarbled->tables);
+  } else {
+    GarbledInstance instance = this->pending_garbling.valid()
+                                   ? this->pending_garbling.get()
+                                   : this->garble();
+    labels = std::move(instance.labels);
+    spilled_tables = instance.spilled_tables;
+
+    if (!spilled_tables) {
+      GarblerToEvaluator_GarbledTables_Message garbledTablesMessage;
+      garbledTablesMessage.garbled_tables = std::move(instance.tables);
+      garbledTablesMessage.packed_tables = std::move(instance.packed_tables);
+      garbledTablesMessage_data = this->crypto_driver->encrypt_and_tag(this->AES_key, this->HMAC_key, &garbledTablesMessage);
+    }
+  }
 
   GarblerToEvaluator_GarblerInputs_Message garblerInputsMessage;
   garblerInputsMessage.garbler_inputs = this->get_garbled_wires(labels, input, 0);
   auto garblerInputsMessage_data = this->crypto_driver->encrypt_and_tag(this->AES_key, this->HMAC_key, &garblerInputsMessage);
-  this->network_driver->send(garblerInputsMessage_data);
 
-  for (int i = 0; i < this->circuit.evaluator_input_length; i++) {
-    this->ot_driver->OT_send(byteblock_to_string(labels.zeros.at(this->circuit.garbler_input_length + i).value),
-                             byteblock_to_string(labels.ones.at(this->circuit.garbler_input_length + i).value));
+  // The tables are large and never touched again, so send them without
+  // copying, coalesced with our inputs into one write.
+  if (spilled_tables) {
+    this->send_spilled_tables(*spilled_tables);
+    this->network_driver->send(std::move(garblerInputsMessage_data));
+  } else {
+    std::vector<std::vector<unsigned char>> frames;
+    frames.push_back(std::move(garbledTablesMessage_data));
+    frames.push_back(std::move(garblerInputsMessage_data));
+    this->network_driver->send_zerocopy(std::move(frames));
   }
 
-  EvaluatorToGarbler_FinalLabels_Message finalLabelsMessage;
-  auto finalLabelsMessage_data = this->crypto_driver->decrypt_and_verify(this->AES_key, this->HMAC_key, this->network_driver->read());
-  if (!finalLabelsMessage_data.second) {
-    throw std::runtime_error("invalid mac");
-  }
-  finalLabelsMessage.deserialize(finalLabelsMessage_data.first);
+  this->ot_driver->OT_send_precomputed(this->evaluator_label_pairs(labels));
 
-  std::string output = "";
-  for (int i = 0; i < circuit.output_length; i++) {
-    GarbledWire label = finalLabelsMessage.final_labels.at(i);
-    if (label.value == labels.zeros.at(circuit.num_wire - circuit.output_length + i).value) {
-      output += "0";
-    } else if (label.value == labels.ones.at(circuit.num_wire - circuit.output_length + i).value) {
-      output += "1";
-    } else {
-      throw std::runtime_error("didn't find a matching label");
-    }
-  }
+  std::string output = this->decode_output(labels);
 
   GarblerToEvaluator_FinalOutput_Message finalOutputMessage;
   finalOutputMessage.final_output = output;
   auto finalOutputMessage_data = this->crypto_driver->encrypt_and_tag(this->AES_key, this->HMAC_key, &finalOutputMessage);
-  this->network_driver->send(finalOutputMessage_data);
+  this->network_driver->send(std::move(finalOutputMessage_data));
 
   return output;
 }
 
 /**
- * Generate the gates for the circuit.
- * You may find `std::random_shuffle` useful
+ * Garble and evaluate one instance per input vector over a single handshake,
+ * pipelined:
+ * 1) One batch of random OTs and one message of corrections for everything
+ * 2) Up to BATCH_PIPELINE_DEPTH instances garble on background threads while
+ *    earlier ones are sent
+ * 3) Final labels are decoded BATCH_PIPELINE_DEPTH instances behind, and all
+ *    final outputs go out together at the end
+ * Reports throughput.
+ * @return output of every instance, in order.
  */
-std::vector<GarbledGate> GarblerClient::generate_gates(Circuit circuit,
-                                                       GarbledLabels labels) {
-  // DONE: implement me!
-  std::vector<GarbledGate> gates;
-  for (auto gate : circuit.gates) {
-    int ne = gate.type == GateType::NOT_GATE ? 2 : 4;
-    std::vector<CryptoPP::SecByteBlock> entries(ne);
-
-    auto w_left_0 = labels.zeros.at(gate.lhs);
-    auto w_left_1 = labels.ones.at(gate.lhs);
-    auto w_right_0 = labels.zeros.at(gate.rhs);
-    auto w_right_1 = labels.ones.at(gate.rhs);
-
-    byte p_left_0 = first_bit(w_left_0.value);
-    byte p_left_1 = first_bit(w_left_1.value);
-    byte p_right_0 = first_bit(w_right_0.value);
-    byte p_right_1 = first_bit(w_right_1.value);
-
-    if (gate.type == GateType::NOT_GATE) {
-      GarbledWire dummy_wire;
-      dummy_wire.value = DUMMY_RHS;
-
-      w_right_0 = dummy_wire;
-      w_right_1 = dummy_wire;
-
-      p_right_0 = first_bit(DUMMY_RHS);
-      p_right_1 = 1-p_right_0;
+std::vector<std::string>
+GarblerClient::run_batch(const std::vector<std::vector<int>> &inputs) {
+  auto start = std::chrono::steady_clock::now();
+  auto keys = this->HandleKeyExchange();
+  this->AES_key = keys.first;
+  this->HMAC_key = keys.second;
+  this->ot_driver->OT_extension_setup_send();
+
+  size_t k = this->circuit->evaluator_input_length;
+  this->ot_driver->OT_precompute_send(inputs.size() * k);
+  std::vector<bool> corrections =
+      this->ot_driver->OT_recv_corrections(inputs.size() * k);
+
+  std::deque<std::future<GarbledInstance>> garbling;
+  if (this->pending_garbling.valid()) {
+    garbling.push_back(std::move(this->pending_garbling));
+  }
+  std::deque<GarbledLabels> awaiting_output;
+  std::vector<std::string> outputs;
+  for (size_t n = 0; n < inputs.size(); n++) {
+    while (garbling.size() < BATCH_PIPELINE_DEPTH &&
+           n + garbling.size() < inputs.size()) {
+      garbling.push_back(std::async(std::launch::async,
+                                    [this]() { return this->garble(); }));
+    }
+    GarbledInstance instance = garbling.front().get();
+    garbling.pop_front();
+
+    if (instance.spilled_tables) {
+      this->send_spilled_tables(*instance.spilled_tables);
+    } else {
+      GarblerToEvaluator_GarbledTables_Message garbledTablesMessage;
+      garbledTablesMessage.garbled_tables = std::move(instance.tables);
+      garbledTablesMessage.packed_tables = std::move(instance.packed_tables);
+      this->network_driver->send(this->crypto_driver->encrypt_and_tag(
+          this->AES_key, this->HMAC_key, &garbledTablesMessage));
     }
 
-    // No longer randomly shuffle, look at the last bit of each label to calculate where to put the correct encryption.
-    // 2p_i + p_j th spot
-    int index_0_0 = 2 * p_left_0 + p_right_0;
-    int index_0_1 = 2 * p_left_0 + p_right_1;
-    int index_1_0 = 2 * p_left_1 + p_right_0;
-    int index_1_1 = 2 * p_left_1 + p_right_1;
-
-    if (gate.type == GateType::AND_GATE) {
-      entries[index_0_0] = encrypt_label(w_left_0, w_right_0, labels.zeros.at(gate.output));
-      entries[index_0_1] = encrypt_label(w_left_0, w_right_1, labels.zeros.at(gate.output));
-      entries[index_1_0] = encrypt_label(w_left_1, w_right_0, labels.zeros.at(gate.output));
-      entries[index_1_1] = encrypt_label(w_left_1, w_right_1, labels.ones.at(gate.output));
-
-      entries.erase(entries.begin());
-    } else if (gate.type == GateType::XOR_GATE) {
-      // entries[index_0_0] = encrypt_label(w_left_0, w_right_0, labels.zeros.at(gate.output));
-      // entries[index_0_1] = encrypt_label(w_left_0, w_right_1, labels.ones.at(gate.output));
-      // entries[index_1_0] = encrypt_label(w_left_1, w_right_0, labels.ones.at(gate.output));
-      // entries[index_1_1] = encrypt_label(w_left_1, w_right_1, labels.zeros.at(gate.output));
-    } else { // NOT_GATE
-      int index_0 = p_left_0;
-      int index_1 = p_left_1;
-      entries[index_0] = encrypt_label(w_left_0, w_right_0, labels.ones.at(gate.output));
-      entries[index_1] = encrypt_label(w_left_1, w_right_0, labels.zeros.at(gate.output));
-    
-      entries.erase(entries.begin());
+    GarblerToEvaluator_GarblerInputs_Message garblerInputsMessage;
+    garblerInputsMessage.garbler_inputs =
+        this->get_garbled_wires(instance.labels, inputs[n], 0);
+    this->network_driver->send(this->crypto_driver->encrypt_and_tag(
+        this->AES_key, this->HMAC_key, &garblerInputsMessage));
+
+    this->ot_driver->OT_send_masked(
+        this->evaluator_label_pairs(instance.labels),
+        std::vector<bool>(corrections.begin() + n * k,
+                          corrections.begin() + (n + 1) * k));
+
+    awaiting_output.push_back(std::move(instance.labels));
+    if (awaiting_output.size() > BATCH_PIPELINE_DEPTH) {
+      outputs.push_back(this->decode_output(awaiting_output.front()));
+      awaiting_output.pop_front();
     }
-    GarbledGate garbledGate;
-    garbledGate.entries = entries;
-    gates.push_back(garbledGate);
+  }
+  while (!awaiting_output.empty()) {
+    outputs.push_back(this->decode_output(awaiting_output.front()));
+    awaiting_output.pop_front();
   }
 
-  return gates;
+  std::vector<std::vector<unsigned char>> frames;
+  for (auto &output : outputs) {
+    GarblerToEvaluator_FinalOutput_Message finalOutputMessage;
+    finalOutputMessage.final_output = output;
+    frames.push_back(this->crypto_driver->encrypt_and_tag(
+        this->AES_key, this->HMAC_key, &finalOutputMessage));
+  }
+  this->network_driver->send_frames(std::move(frames));
+
+  double seconds = std::chrono::duration<double>(
+                       std::chrono::steady_clock::now() - start)
+                       .count();
+  this->cli_driver->print_success(
+      "Garbled " + std::to_string(inputs.size()) + " instances in " +
+      std::to_string(seconds) + " s (" +
+      std::to_string(inputs.size() / seconds) + " evaluations/s)");
+  return outputs;
 }
 
 /**
- * Generate *all* labels for the circuit. 
- * To generate an individual label, use `generate_label`.
+ * Both labels of every evaluator input wire, to send by OT.
  */
-GarbledLabels GarblerClient::generate_labels(Circuit circuit) {
-  // DONE: implement me!
-  GarbledLabels output_labels;
-  output_labels.zeros.resize(circuit.num_wire);
-  output_labels.ones.resize(circuit.num_wire);
-
-  std::set<int> idx_already_set;
-
-  auto r = generate_label(1);
-  for (auto gate : circuit.gates) {
-    bool bit;
-    std::vector<GarbledWire> lhs = {output_labels.zeros.at(gate.lhs), output_labels.ones.at(gate.lhs)};
-    if (idx_already_set.find(gate.lhs) == idx_already_set.end()) {
-      bit = random_bit();
-      lhs[0].value = generate_label((byte) bit);
-      lhs[1].value = CryptoPP::SecByteBlock(lhs[0].value);
-      CryptoPP::xorbuf(lhs[1].value, r, LABEL_LENGTH);
-    }
-
-    std::vector<GarbledWire> rhs = {output_labels.zeros.at(gate.rhs), output_labels.ones.at(gate.rhs)};
-    if (idx_already_set.find(gate.rhs) == idx_already_set.end() && gate.type != GateType::NOT_GATE) {
-      bit = random_bit();
-      rhs[0].value = generate_label((byte) bit);
-      rhs[1].value = CryptoPP::SecByteBlock(rhs[0].value);
-      CryptoPP::xorbuf(rhs[1].value, r, LABEL_LENGTH);
-    }
+std::vector<std::pair<std::string, std::string>>
+GarblerClient::evaluator_label_pairs(const GarbledLabels &labels) {
+  std::vector<std::pair<std::string, std::string>> evaluator_labels;
+  for (int i = 0; i < this->circuit->evaluator_input_length; i++) {
+    evaluator_labels.push_back(std::make_pair(
+        byteblock_to_string(this->get_label(labels, this->circuit->garbler_input_length + i, 0).value),
+        byteblock_to_string(this->get_label(labels, this->circuit->garbler_input_length + i, 1).value)));
+  }
+  return evaluator_labels;
+}
 
-    bit = random_bit();
-    GarbledWire out0;
-    GarbledWire out1;
-    if (gate.type == GateType::XOR_GATE) {
-      out0.value = CryptoPP::SecByteBlock(lhs[0].value);
-      CryptoPP::xorbuf(out0.value, rhs[0].value, LABEL_LENGTH);
+/**
+ * Receive the evaluator's final labels and decode them against `labels`.
+ * @throws error for an invalid mac or a label that matches neither value.
+ */
+std::string GarblerClient::decode_output(const GarbledLabels &labels) {
+  EvaluatorToGarbler_FinalLabels_Message finalLabelsMessage;
+  auto finalLabelsMessage_data = this->crypto_driver->decrypt_and_verify(this->AES_key, this->HMAC_key, this->network_driver->read());
+  if (!finalLabelsMessage_data.second) {
+    throw std::runtime_error("invalid mac");
+  }
+  finalLabelsMessage.deserialize(finalLabelsMessage_data.first);
 
-      out1.value = CryptoPP::SecByteBlock(out0.value);
-      CryptoPP::xorbuf(out1.value, r, LABEL_LENGTH);
+  std::string output = "";
+  for (int i = 0; i < this->circuit->output_length; i++) {
+    GarbledWire label = finalLabelsMessage.final_labels.at(i);
+    int wire = this->circuit->num_wire - this->circuit->output_length + i;
+    if (label.value == this->get_label(labels, wire, 0).value) {
+      output += "0";
+    } else if (label.value == this->get_label(labels, wire, 1).value) {
+      output += "1";
     } else {
-      int lhs_for_idx_0 = first_bit(lhs[0].value);
-
-      if (gate.type == GateType::AND_GATE) {
-        int rhs_for_idx_0 = first_bit(rhs[0].value);
-
-        if (lhs_for_idx_0 && rhs_for_idx_0) {
-          out1.value = this->crypto_driver->hash_inputs(lhs[1].value, rhs[1].value);
-          out0.value = CryptoPP::SecByteBlock(out1.value);
-          CryptoPP::xorbuf(out0.value, r, LABEL_LENGTH);
-        } else {
-          out0.value = this->crypto_driver->hash_inputs(lhs[lhs_for_idx_0].value, rhs[rhs_for_idx_0].value);
-          out1.value = CryptoPP::SecByteBlock(out0.value);
-          CryptoPP::xorbuf(out1.value, r, LABEL_LENGTH);
-        }
-      } else { // NOT_GATE
-        GarbledWire dummy_wire;
-        dummy_wire.value = DUMMY_RHS;
-        if (!lhs_for_idx_0) {
-          out1.value = this->crypto_driver->hash_inputs(lhs[0].value, dummy_wire.value);
-          out0.value = CryptoPP::SecByteBlock(out1.value);
-          CryptoPP::xorbuf(out0.value, r, LABEL_LENGTH);
-        } else {
-          out0.value = this->crypto_driver->hash_inputs(lhs[1].value, dummy_wire.value);
-          out1.value = CryptoPP::SecByteBlock(out0.value);
-          CryptoPP::xorbuf(out1.value, r, LABEL_LENGTH);
-        }
-      }
+      throw std::runtime_error("didn't find a matching label");
     }
+  }
+  return output;
+}
 
-    output_labels.zeros.at(gate.lhs) = lhs[0]; output_labels.zeros.at(gate.output) = out0;
-    output_labels.ones.at(gate.lhs) = lhs[1]; output_labels.ones.at(gate.output) = out1;
-    if (gate.type != GateType::NOT_GATE) {
-      output_labels.zeros.at(gate.rhs) = rhs[0];
-      output_labels.ones.at(gate.rhs) = rhs[1];
-      idx_already_set.insert(gate.rhs);
-    }
+/**
+ * Start garbling this->circuit on a background thread. Garbling doesn't
+ * depend on the evaluator, so this can overlap with listen() and the key
+ * exchange; run() picks up the result.
+ */
+void GarblerClient::start_garbling() {
+  this->pending_garbling =
+      std::async(std::launch::async, [this]() { return this->garble(); });
+}
+
+/**
+ * Take instances of this->circuit from the given pool instead of garbling
+ * them. Any garbling started with start_garbling is dropped.
+ * @param pool Pool garbling this->circuit, or nullptr to stop using one.
+ */
+void GarblerClient::set_pool(std::shared_ptr<GarbledCircuitPool> pool) {
+  this->drop_pending_garbling();
+  this->pool = pool;
+}
 
-    idx_already_set.insert(gate.lhs);
-    idx_already_set.insert(gate.output);
+/**
+ * Wait for garbling started with start_garbling to finish and discard it.
+ * The garbling thread reads this->circuit, so it must be joined before that
+ * changes; a failure there doesn't matter once the result is unused.
+ */
+void GarblerClient::drop_pending_garbling() {
+  if (!this->pending_garbling.valid()) {
+    return;
   }
+  try {
+    this->pending_garbling.get();
+  } catch (const std::exception &) {
+  }
+}
 
-  return output_labels;
+/**
+ * Derive labels from a per-instance seed when garbling, keeping only the
+ * live wires' labels in memory. See garble_seeded_instance.
+ */
+void GarblerClient::set_seeded_labels(bool seeded_labels) {
+  this->seeded_labels = seeded_labels;
 }
 
 /**
- * Generate encrypted label. Tags LABEL_TAG_LENGTH trailing 0s to end before encrypting.
- * You may find CryptoPP::xorbuf and CryptoDriver::hash_inputs useful.
+ * Spill garbled tables to files in spill_dir instead of keeping them in
+ * memory; the evaluator must spill too. Empty to keep tables in memory.
  */
-CryptoPP::SecByteBlock GarblerClient::encrypt_label(GarbledWire lhs,
-                                                    GarbledWire rhs,
-                                                    GarbledWire output) {
-  // DONE: implement me!
-  auto hashed_val = this->crypto_driver->hash_inputs(lhs.value, rhs.value);
-  SecByteBlock expanded_output(output.value);
-  expanded_output.CleanGrow(LABEL_LENGTH + LABEL_TAG_LENGTH);
+void GarblerClient::set_spill_dir(std::string spill_dir) {
+  this->spill_dir = spill_dir;
+}
+
+/**
+ * Garble AND and NOT gates with the given scheme; the evaluator must use the
+ * same one.
+ */
+void GarblerClient::set_scheme(SchemeType::T scheme) { this->scheme = scheme; }
 
-  CryptoPP::xorbuf(hashed_val, expanded_output, LABEL_LENGTH + LABEL_TAG_LENGTH);
-  return hashed_val;
+/**
+ * Generate labels and garbled tables for this->circuit under this->scheme.
+ * With seeded labels or a spill directory the circuit is garbled gate by
+ * gate, the tables going to a TableStore as they are garbled if spilling;
+ * otherwise a generated (GRR3) kernel linked in for this circuit is used if
+ * there is one, else the scheme's engine.
+ * @throws error for branches with seeded labels or spilling.
+ */
+GarbledInstance GarblerClient::garble() {
+  std::shared_ptr<TableStore> spilled_tables;
+  if (!this->spill_dir.empty()) {
+    spilled_tables = std::make_shared<TableStore>(
+        this->spill_dir, table_entry_length(this->scheme));
+  }
+  GarbledInstance instance;
+  if (this->seeded_labels) {
+    instance = garble_seeded_with_scheme(this->scheme, *this->circuit,
+                                         spilled_tables);
+  } else if (spilled_tables) {
+    instance = garble_spilled_with_scheme(this->scheme, *this->circuit,
+                                          spilled_tables);
+  } else if (auto kernel = this->scheme == SchemeType::GRR3
+                                ? find_circuit_kernel(*this->circuit)
+                                : nullptr) {
+    instance = garble_with_kernel(*kernel, *this->circuit);
+  } else {
+    instance = garble_with_scheme(this->scheme, *this->circuit);
+  }
+  if (instance.spilled_tables) {
+    instance.spilled_tables->finish();
+  }
+  return instance;
 }
 
 /**
- * Generate label.
+ * Send spilled tables in chunks of TABLE_CHUNK_SIZE, straight from the
+ * mapped file.
  */
-CryptoPP::SecByteBlock GarblerClient::generate_label(byte select_bit) {
-  CryptoPP::SecByteBlock label(LABEL_LENGTH);
-  CryptoPP::OS_GenerateRandomBlock(false, label, label.size());
-  label.BytePtr()[0] |= (select_bit << 7);
-  return label;
+void GarblerClient::send_spilled_tables(TableStore &tables) {
+  while (true) {
+    auto chunk = tables.next_chunk(TABLE_CHUNK_SIZE);
+    GarblerToEvaluator_GarbledTablesChunk_Message chunkMessage;
+    chunkMessage.tables.assign(chunk.first, chunk.first + chunk.second);
+    chunkMessage.last = chunk.second < TABLE_CHUNK_SIZE;
+    this->network_driver->send(this->crypto_driver->encrypt_and_tag(
+        this->AES_key, this->HMAC_key, &chunkMessage));
+    if (chunkMessage.last) {
+      return;
+    }
+  }
 }
 
 /*
@@ -308,16 +460,14 @@ CryptoPP::SecByteBlock GarblerClient::generate_label(byte select_bit) {
  * labels corresponding to the inputs starting at begin.
  */
 std::vector<GarbledWire>
-GarblerClient::get_garbled_wires(GarbledLabels labels, std::vector<int> input,
-                                 int begin) {
+GarblerClient::get_garbled_wires(const GarbledLabels &labels,
+                                 std::vector<int> input, int begin) {
   std::vector<GarbledWire> res;
   for (int i = 0; i < input.size(); i++) {
     switch (input[i]) {
     case 0:
-      res.push_back(labels.zeros[begin + i]);
-      break;
     case 1:
-      res.push_back(labels.ones[begin + i]);
+      res.push_back(this->get_label(labels, begin + i, input[i]));
       break;
     default:
       std::cerr << "INVALID INPUT CHARACTER" << std::endl;
@@ -325,3 +475,26 @@ GarblerClient::get_garbled_wires(GarbledLabels labels, std::vector<int> input,
   }
   return res;
 }
+
+/*
+ * Label of `wire` for value `bit`. Seeded labels keep only the output wires'
+ * zero labels; other wires are inputs, re-derived from the seed.
+ */
+GarbledWire GarblerClient::get_label(const GarbledLabels &labels, int wire,
+                                     int bit) {
+  if (!labels.prg) {
+    return bit ? labels.ones.at(wire) : labels.zeros.at(wire);
+  }
+  int first_output = this->circuit->num_wire - this->circuit->output_length;
+  GarbledWire label;
+  if (wire >= first_output) {
+    label = labels.zeros.at(wire - first_output);
+  } else {
+    label.value = labels.prg->derive(wire, labels.delta.size());
+  }
+  if (bit) {
+    label.value = CryptoPP::SecByteBlock(label.value);
+    CryptoPP::xorbuf(label.value, labels.delta, labels.delta.size());
+  }
+  return label;
+}
@@ -0,0 +1,162 @@
+#include <stdexcept>
+
+#include "../../include-shared/constants.hpp"
+#include "../../include/pkg/garbler.hpp"
+#include "../../include/pkg/garbler_server.hpp"
+#include "../../include/pkg/garbling_scheme.hpp"
+
+/**
+ * Constructor. Concurrency is the smaller of max_sessions and the number of
+ * sessions that fit in memory_limit.
+ * @param circuit Circuit shared read-only by every session.
+ * @param input Garbler's input for every session.
+ * @param max_sessions Upper bound on concurrent sessions.
+ * @param memory_limit Memory budget for all sessions in bytes, 0 for none.
+ * @param pool_depth Circuits to keep garbled ahead of time, 0 for no pool.
+ * @param pool_memory_limit Memory budget for the pool in bytes, 0 for none.
+ * @param session_timeout Longest a session waits on its evaluator.
+ * @throws error if a single session doesn't fit in memory_limit, or a single
+ * pooled circuit in pool_memory_limit.
+ */
+GarblerServer::GarblerServer(std::shared_ptr<const Circuit> circuit,
+                             std::vector<int> input, int max_sessions,
+                             size_t memory_limit, size_t pool_depth,
+                             size_t pool_memory_limit,
+                             std::chrono::milliseconds session_timeout)
+    : circuit(circuit), input(input), session_timeout(session_timeout),
+      in_flight(0) {
+  this->cli_driver = std::make_shared<CLIDriver>();
+  if (memory_limit > 0) {
+    size_t per_session = session_memory(*circuit);
+    if (per_session > memory_limit) {
+      throw std::runtime_error("memory limit too small for one session");
+    }
+    max_sessions = std::min<size_t>(max_sessions, memory_limit / per_session);
+  }
+  this->max_sessions = std::max(1, max_sessions);
+  if (pool_depth > 0) {
+    this->pool = std::make_shared<GarbledCircuitPool>(
+        circuit, pool_depth, pool_memory_limit,
+        std::max(1u, std::thread::hardware_concurrency()));
+  }
+}
+
+/**
+ * Rough upper bound on the memory one session holds at once: both labels of
+ * every wire and the garbled tables as SecByteBlocks, each costing its bytes
+ * plus the object and its allocation, and the serialized tables. Sending
+ * keeps five serialized copies alive at its peak: the plaintext, its string
+ * copy, the ciphertext, the tagged buffer and the wrapped message.
+ */
+size_t GarblerServer::session_memory(const Circuit &circuit) {
+  size_t block = LABEL_LENGTH + sizeof(CryptoPP::SecByteBlock) + 16;
+  size_t entries = count_table_entries<Grr3Scheme<LABEL_LENGTH>>(circuit);
+  size_t labels = 2 * (size_t)circuit.num_wire * block;
+  size_t tables =
+      entries * block + (size_t)circuit.num_gate * sizeof(GarbledGate);
+  // Each entry is written with a length prefix, each gate with its count.
+  size_t serialized = entries * (sizeof(size_t) + LABEL_LENGTH) +
+                      (size_t)circuit.num_gate * 2 * sizeof(size_t);
+  return labels + tables + 5 * serialized;
+}
+
+/**
+ * Accept evaluators on the given port forever. A connection is only accepted
+ * once a session slot is free; the rest wait in the listen backlog.
+ * @param port Port to listen on.
+ */
+void GarblerServer::serve(int port) {
+  boost::asio::io_context io_context;
+  boost::asio::ip::tcp::acceptor acceptor(
+      io_context,
+      boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port));
+  for (int i = 0; i < this->max_sessions; i++) {
+    this->workers.emplace_back([this]() { this->worker(); });
+  }
+  this->cli_driver->print_info("Serving on port " + std::to_string(port) +
+                               " with up to " +
+                               std::to_string(this->max_sessions) +
+                               " concurrent sessions");
+  if (this->pool) {
+    this->cli_driver->print_info(
+        "Keeping " + std::to_string(this->pool->get_depth()) +
+        " garbled circuits ready");
+  }
+
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      this->slot_free.wait(
+          lock, [this]() { return this->in_flight < this->max_sessions; });
+      this->in_flight++;
+    }
+
+    auto network_driver = std::make_shared<NetworkDriverImpl>();
+    network_driver->set_timeout(this->session_timeout);
+    try {
+      network_driver->accept(acceptor);
+    } catch (std::exception &e) {
+      this->cli_driver->print_warning(std::string("Accept failed: ") +
+                                      e.what());
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->in_flight--;
+      continue;
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->pending_sessions.push_back(network_driver);
+    }
+    this->session_ready.notify_one();
+  }
+}
+
+/**
+ * Worker loop: run accepted sessions one at a time.
+ */
+void GarblerServer::worker() {
+  while (true) {
+    std::shared_ptr<NetworkDriverImpl> network_driver;
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      this->session_ready.wait(
+          lock, [this]() { return !this->pending_sessions.empty(); });
+      network_driver = this->pending_sessions.front();
+      this->pending_sessions.pop_front();
+    }
+
+    this->run_session(network_driver);
+
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      this->in_flight--;
+    }
+    this->slot_free.notify_one();
+  }
+}
+
+/**
+ * Run one garbling session. Failures end the session, not the server.
+ * @param network_driver Connection to the evaluator.
+ */
+void GarblerServer::run_session(
+    std::shared_ptr<NetworkDriverImpl> network_driver) {
+  std::string remote = "unknown peer";
+  try {
+    remote = network_driver->get_remote_info();
+    auto crypto_driver = std::make_shared<CryptoDriver>();
+    GarblerClient garbler(this->circuit, network_driver, crypto_driver);
+    if (this->pool) {
+      garbler.set_pool(this->pool);
+    } else {
+      garbler.start_garbling();
+    }
+    std::string output = garbler.run(this->input);
+    network_driver->disconnect();
+    this->cli_driver->print_success("Session with " + remote +
+                                    " finished: " + output);
+  } catch (std::exception &e) {
+    this->cli_driver->print_warning("Session with " + remote +
+                                    " failed: " + e.what());
+  }
+}
@@ -0,0 +1,106 @@
+#include <stdexcept>
+
+#include "../../include/pkg/garbling_scheme.hpp"
+
+namespace {
+/**
+ * Call f.template operator()<S>() with the scheme policy for `scheme` at the
+ * protocol's label width, LABEL_LENGTH; the engine itself works at any width
+ * a scheme is instantiated with. The only runtime dispatch: everything below
+ * it is specialized for S.
+ */
+template <class F> decltype(auto) dispatch_scheme(SchemeType::T scheme, F &&f) {
+  switch (scheme) {
+  case SchemeType::GRR3:
+    return f.template operator()<Grr3Scheme<LABEL_LENGTH>>();
+  case SchemeType::HALF_GATES:
+    return f.template operator()<HalfGatesScheme<LABEL_LENGTH>>();
+  case SchemeType::CLASSIC:
+    return f.template operator()<ClassicScheme<LABEL_LENGTH>>();
+  case SchemeType::THREE_HALVES:
+    return f.template operator()<ThreeHalvesScheme<LABEL_LENGTH>>();
+  }
+  throw std::runtime_error("unknown garbling scheme");
+}
+} // namespace
+
+/**
+ * Bytes per table entry under `scheme`, for spilling its tables.
+ */
+size_t table_entry_length(SchemeType::T scheme) {
+  return dispatch_scheme(scheme,
+                         [&]<GarblingScheme S>() { return S::entry_width; });
+}
+
+/**
+ * Garble `circuit` in memory under `scheme`.
+ */
+GarbledInstance garble_with_scheme(SchemeType::T scheme,
+                                   const Circuit &circuit) {
+  return dispatch_scheme(scheme, [&]<GarblingScheme S>() {
+    return garble_instance<S>(circuit, [&](auto &ctx, auto *wires,
+                                           auto *tables) {
+      garble_gates<S>(circuit, ctx, wires, tables);
+    });
+  });
+}
+
+/**
+ * Garble `circuit` under `scheme` with random labels, appending the tables to
+ * `tables` gate by gate.
+ */
+GarbledInstance garble_spilled_with_scheme(SchemeType::T scheme,
+                                           const Circuit &circuit,
+                                           std::shared_ptr<TableStore> tables) {
+  return dispatch_scheme(scheme, [&]<GarblingScheme S>() {
+    return garble_spilled_instance<S>(circuit, tables);
+  });
+}
+
+/**
+ * Garble `circuit` under `scheme` with labels derived from a fresh seed; the
+ * tables go to `tables` if given, else into the instance.
+ */
+GarbledInstance garble_seeded_with_scheme(SchemeType::T scheme,
+                                          const Circuit &circuit,
+                                          std::shared_ptr<TableStore> tables) {
+  return dispatch_scheme(scheme, [&]<GarblingScheme S>() {
+    return garble_seeded_instance<S>(circuit, tables);
+  });
+}
+
+/**
+ * Evaluate `circuit` on in-memory tables garbled under `scheme`.
+ * @return labels of the output wires.
+ * @throws error if the tables don't match the scheme.
+ */
+std::vector<GarbledWire>
+evaluate_with_scheme(SchemeType::T scheme, const Circuit &circuit,
+                     const std::vector<GarbledGate> &tables,
+                     const std::vector<GarbledWire> &garbler_inputs,
+                     const std::vector<GarbledWire> &evaluator_inputs) {
+  return dispatch_scheme(scheme, [&]<GarblingScheme S>() {
+    return evaluate_instance<S>(
+        circuit, tables, garbler_inputs, evaluator_inputs,
+        [&](auto &ctx, auto *wires, auto *flat_tables) {
+          evaluate_gates<S>(circuit, ctx, wires, flat_tables);
+        });
+  });
+}
+
+/**
+ * Evaluate `circuit` on spilled tables garbled under `scheme`, reading them
+ * front to back.
+ * @return labels of the output wires.
+ * @throws error if the tables don't match the scheme.
+ */
+std::vector<GarbledWire>
+evaluate_spilled_with_scheme(SchemeType::T scheme, const Circuit &circuit,
+                             TableStore &tables,
+                             const std::vector<GarbledWire> &garbler_inputs,
+                             const std::vector<GarbledWire> &evaluator_inputs) {
+  return dispatch_scheme(scheme, [&]<GarblingScheme S>() {
+    return evaluate_spilled_instance<S>(circuit, tables, garbler_inputs,
+                                        evaluator_inputs);
+  });
+}
@@ -1,4 +1,1098 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest/doctest.h"
 
-TEST_CASE("sample") { CHECK(true); }
\ No newline at end of file
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <thread>
+#include <unistd.h>
+
+#include "../include-shared/constants.hpp"
+#include "../include-shared/prg.hpp"
+#include "../include-shared/table_store.hpp"
+#include "../include-shared/util.hpp"
+#include "drivers/emulated_network_driver.hpp"
+#include "drivers/ot_driver.hpp"
+#include "drivers/shm_network_driver.hpp"
+#include "drivers/striped_network_driver.hpp"
+#include "pkg/circuit_kernel.hpp"
+#include "pkg/evaluator.hpp"
+#include "pkg/garbler.hpp"
+#include "pkg/garbler_server.hpp"
+#include "pkg/garbling_scheme.hpp"
+
+TEST_CASE("sample") { CHECK(true); }
+
+TEST_CASE("in-process transport carries messages larger than the ring") {
+  auto [listener, connector] = InProcessNetworkDriverImpl::make_pair();
+  std::vector<unsigned char> big(3 * SHM_RING_CAPACITY + 7);
+  for (size_t i = 0; i < big.size(); i++) {
+    big[i] = i * 31;
+  }
+
+  std::thread sender([&]() {
+    listener->send(big);
+    listener->send({1, 2, 3});
+    listener->disconnect();
+  });
+  CHECK(connector->read() == big);
+  CHECK((connector->read() == std::vector<unsigned char>{1, 2, 3}));
+  sender.join();
+  CHECK_THROWS(connector->read());
+}
+
+// out = a AND b
+Circuit and_circuit() {
+  Circuit circuit;
+  circuit.num_gate = 1;
+  circuit.num_wire = 3;
+  circuit.garbler_input_length = 1;
+  circuit.evaluator_input_length = 1;
+  circuit.output_length = 1;
+  circuit.gates.push_back(Gate{GateType::AND_GATE, 0, 1, 2});
+  return circuit;
+}
+
+using DriverPair =
+    std::pair<std::shared_ptr<NetworkDriver>, std::shared_ptr<NetworkDriver>>;
+
+// Run the garbler and the evaluator of `circuit` against each other over
+// `networks` once `configure` has set both up. Checks that both sides decode
+// the same output and returns it.
+std::string
+run_pair(std::shared_ptr<const Circuit> circuit,
+         std::vector<int> garbler_input, std::vector<int> evaluator_input,
+         std::function<void(GarblerClient &, EvaluatorClient &)> configure =
+             nullptr,
+         DriverPair networks = InProcessNetworkDriverImpl::make_pair()) {
+  GarblerClient garbler(circuit, networks.first,
+                        std::make_shared<CryptoDriver>());
+  EvaluatorClient evaluator(circuit, networks.second,
+                            std::make_shared<CryptoDriver>());
+  if (configure) {
+    configure(garbler, evaluator);
+  }
+
+  std::string garbler_output;
+  std::thread garbler_thread(
+      [&]() { garbler_output = garbler.run(garbler_input); });
+  std::string evaluator_output = evaluator.run(evaluator_input);
+  garbler_thread.join();
+  CHECK(garbler_output == evaluator_output);
+  return evaluator_output;
+}
+
+// A run_pair configuration garbling and evaluating with `scheme`.
+std::function<void(GarblerClient &, EvaluatorClient &)>
+use_scheme(SchemeType::T scheme) {
+  return [scheme](GarblerClient &garbler, EvaluatorClient &evaluator) {
+    garbler.set_scheme(scheme);
+    evaluator.set_scheme(scheme);
+  };
+}
+
+// A TCP port nothing listens on right now.
+int free_port() {
+  boost::asio::io_context io_context;
+  boost::asio::ip::tcp::acceptor acceptor(
+      io_context,
+      boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), 0));
+  return acceptor.local_endpoint().port();
+}
+
+// A fresh driver from make_driver connected to localhost:port, retrying
+// until something listens there.
+std::shared_ptr<NetworkDriver>
+connect_when_listening(std::function<std::shared_ptr<NetworkDriver>()> make_driver,
+                       int port) {
+  while (true) {
+    auto driver = make_driver();
+    try {
+      driver->connect("localhost", port);
+      return driver;
+    } catch (const std::exception &) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+  }
+}
+
+// Two drivers from make_driver connected to each other over localhost; the
+// first one listened.
+DriverPair
+connect_pair(std::function<std::shared_ptr<NetworkDriver>()> make_driver) {
+  int port = free_port();
+  auto listener = make_driver();
+  std::thread listen_thread([&]() { listener->listen(port); });
+  auto connector = connect_when_listening(make_driver, port);
+  listen_thread.join();
+  return {listener, connector};
+}
+
+TEST_CASE("garbler and evaluator run end to end in one process") {
+  auto circuit = std::make_shared<const Circuit>(and_circuit());
+  for (int a = 0; a < 2; a++) {
+    for (int b = 0; b < 2; b++) {
+      CHECK(run_pair(circuit, {a}, {b}) == std::to_string(a & b));
+    }
+  }
+}
+
+TEST_CASE("precomputed OTs are derandomized to the chosen messages") {
+  auto [sender_network, receiver_network] =
+      InProcessNetworkDriverImpl::make_pair();
+  auto crypto_driver = std::make_shared<CryptoDriver>();
+  SecByteBlock shared_key(LABEL_LENGTH);
+  ThreadRNG::get().GenerateBlock(shared_key, shared_key.size());
+  auto keys = std::make_pair(crypto_driver->AES_generate_key(shared_key),
+                             crypto_driver->HMAC_generate_key(shared_key));
+  OTDriver sender(sender_network, crypto_driver, keys);
+  OTDriver receiver(receiver_network, std::make_shared<CryptoDriver>(), keys);
+
+  std::vector<std::pair<std::string, std::string>> messages;
+  std::vector<int> choice_bits;
+  for (int i = 0; i < 5; i++) {
+    messages.push_back({std::string(LABEL_LENGTH, 'a' + i),
+                        std::string(LABEL_LENGTH, 'A' + i)});
+    choice_bits.push_back(i % 2);
+  }
+  std::thread sender_thread([&]() {
+    sender.OT_precompute_send(3);
+    sender.OT_send_precomputed(messages);
+  });
+  receiver.OT_precompute_recv(3);
+  std::vector<std::string> received = receiver.OT_recv_precomputed(choice_bits);
+  sender_thread.join();
+
+  REQUIRE(received.size() == messages.size());
+  for (size_t i = 0; i < messages.size(); i++) {
+    CHECK(received[i] ==
+          (choice_bits[i] ? messages[i].second : messages[i].first));
+  }
+}
+
+TEST_CASE("precomputed DH keypairs are public keys of their private keys") {
+  CryptoDriver crypto_driver;
+  crypto_driver.DH_precompute(2);
+  auto [DH_obj, private_keys, public_keys] =
+      crypto_driver.DH_initialize_batch(4);
+  REQUIRE(public_keys.size() == 4);
+  for (size_t i = 0; i < public_keys.size(); i++) {
+    Integer expected = a_exp_b_mod_c(
+        DL_G, byteblock_to_integer(private_keys[i]), DL_P);
+    CHECK(byteblock_to_integer(public_keys[i]) == expected);
+  }
+}
+
+TEST_CASE("batched division matches one inversion per element") {
+  CryptoDriver crypto_driver;
+  std::vector<SecByteBlock> numerators, denominators;
+  for (int i = 0; i < 4; i++) {
+    numerators.push_back(integer_to_byteblock(Integer(1000 + i)));
+    denominators.push_back(integer_to_byteblock(Integer(7 + 2 * i)));
+  }
+  auto quotients = crypto_driver.DL_divide_batch(numerators, denominators);
+  REQUIRE(quotients.size() == 4);
+  for (int i = 0; i < 4; i++) {
+    Integer expected = a_times_b_mod_c(
+        Integer(1000 + i), Integer(7 + 2 * i).InverseMod(DL_P), DL_P);
+    CHECK(byteblock_to_integer(quotients[i]) == expected);
+  }
+}
+
+TEST_CASE("garbling started before connecting is used by the next run") {
+  auto circuit = std::make_shared<const Circuit>(and_circuit());
+  CHECK(run_pair(circuit, {1}, {1},
+                 [](GarblerClient &garbler, EvaluatorClient &) {
+                   garbler.start_garbling();
+                 }) == "1");
+}
+
+TEST_CASE("the asynchronous driver runs end to end over TCP") {
+  auto circuit = std::make_shared<const Circuit>(and_circuit());
+  for (int b = 0; b < 2; b++) {
+    auto networks = connect_pair(
+        []() { return std::make_shared<AsyncNetworkDriverImpl>(); });
+    CHECK(run_pair(circuit, {1}, {b}, nullptr, networks) ==
+          std::to_string(b));
+  }
+}
+
+TEST_CASE("gathered, large and zero-copy frames cross TCP intact") {
+  std::vector<unsigned char> big(3 * NETWORK_CHUNK_SIZE + 5);
+  for (size_t i = 0; i < big.size(); i++) {
+    big[i] = i * 7;
+  }
+  std::vector<unsigned char> small = {1, 2, 3};
+  std::vector<std::function<std::shared_ptr<NetworkDriver>()>> drivers = {
+      []() { return std::make_shared<NetworkDriverImpl>(); },
+      []() { return std::make_shared<AsyncNetworkDriverImpl>(); }};
+  for (auto &make_driver : drivers) {
+    auto [sender, receiver] = connect_pair(make_driver);
+    // The messages are larger than the socket buffers, so send while reading.
+    std::thread sender_thread([&, sender = sender]() {
+      sender->send_frames({small, big});
+      sender->send(big);
+      sender->send_zerocopy({big, small});
+    });
+    CHECK(receiver->read() == small);
+    CHECK(receiver->read() == big);
+    CHECK(receiver->read() == big);
+    CHECK(receiver->read() == big);
+    CHECK(receiver->read() == small);
+    sender_thread.join();
+  }
+}
+
+// Connect a plain socket to localhost:port, retrying until something listens
+// there; stands in for a misbehaving peer.
+void connect_raw(boost::asio::ip::tcp::socket &socket, int port) {
+  while (true) {
+    boost::system::error_code error;
+    socket.connect(boost::asio::ip::tcp::endpoint(
+                       boost::asio::ip::address_v4::loopback(), port),
+                   error);
+    if (!error) {
+      return;
+    }
+    socket.close();
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+}
+
+TEST_CASE("TCP drivers refuse frames longer than MAX_FRAME_LENGTH") {
+  std::vector<std::function<std::shared_ptr<NetworkDriver>()>> drivers = {
+      []() { return std::make_shared<NetworkDriverImpl>(); },
+      []() { return std::make_shared<AsyncNetworkDriverImpl>(); }};
+  for (auto &make_driver : drivers) {
+    int port = free_port();
+    auto receiver = make_driver();
+    std::thread listen_thread([&]() { receiver->listen(port); });
+    boost::asio::io_context io_context;
+    boost::asio::ip::tcp::socket peer(io_context);
+    connect_raw(peer, port);
+    listen_thread.join();
+    // A header claiming far more than any real message, and no body.
+    uint64_t length = htobe64(MAX_FRAME_LENGTH + 1);
+    boost::asio::write(peer, boost::asio::buffer(&length, sizeof(length)));
+    CHECK_THROWS(receiver->read());
+  }
+}
+
+TEST_CASE("striped connections reassemble messages and run end to end") {
+  std::vector<unsigned char> big(2 * NETWORK_CHUNK_SIZE + 11);
+  for (size_t i = 0; i < big.size(); i++) {
+    big[i] = i * 13;
+  }
+  auto [sender, receiver] = connect_pair(
+      []() { return std::make_shared<StripedNetworkDriverImpl>(3); });
+  std::thread sender_thread([&, sender = sender]() {
+    sender->send(big);
+    sender->send({4, 5});
+  });
+  CHECK(receiver->read() == big);
+  CHECK((receiver->read() == std::vector<unsigned char>{4, 5}));
+  sender_thread.join();
+
+  auto circuit = std::make_shared<const Circuit>(and_circuit());
+  auto networks = connect_pair(
+      []() { return std::make_shared<StripedNetworkDriverImpl>(2); });
+  CHECK(run_pair(circuit, {1}, {1}, nullptr, networks) == "1");
+}
+
+TEST_CASE("striped reads fail on bad chunks instead of allocating or hanging") {
+  // Connection 0 carries chunks 0 and 2 of a three-chunk message, connection
+  // 1 chunk 1. Connection 0 only sends chunk 0, so its reader blocks while
+  // connection 1's reader finds the broken chunk.
+  uint64_t message_length = 2 * NETWORK_CHUNK_SIZE + 1;
+  std::vector<StripeChunkHeader> first_chunks = {
+      {0, message_length, NETWORK_CHUNK_SIZE},
+      {0, MAX_FRAME_LENGTH + 1, NETWORK_CHUNK_SIZE}};
+  for (auto first : first_chunks) {
+    int port = free_port();
+    auto receiver = std::make_shared<StripedNetworkDriverImpl>(2);
+    std::thread listen_thread([&]() { receiver->listen(port); });
+    boost::asio::io_context io_context;
+    std::vector<boost::asio::ip::tcp::socket> peers;
+    for (uint32_t i = 0; i < 2; i++) {
+      peers.emplace_back(io_context);
+      connect_raw(peers[i], port);
+      uint32_t index = htonl(i);
+      boost::asio::write(peers[i], boost::asio::buffer(&index, sizeof(index)));
+    }
+    listen_thread.join();
+
+    // The oversized header must be refused before its body is read.
+    std::thread sender_thread([&]() {
+      std::vector<unsigned char> body(
+          first.message_length == message_length ? NETWORK_CHUNK_SIZE : 0);
+      StripeChunkHeader header = {htobe64(first.seq),
+                                  htobe64(first.message_length),
+                                  htobe64(first.chunk_length)};
+      boost::system::error_code error;
+      boost::asio::write(peers[0],
+                         std::vector<boost::asio::const_buffer>{
+                             boost::asio::buffer(&header, sizeof(header)),
+                             boost::asio::buffer(body)},
+                         error);
+      StripeChunkHeader broken = {htobe64(1), htobe64(message_length + 1),
+                                  htobe64(NETWORK_CHUNK_SIZE)};
+      boost::asio::write(peers[1], boost::asio::buffer(&broken, sizeof(broken)),
+                         error);
+    });
+    CHECK_THROWS(receiver->read());
+    sender_thread.join();
+  }
+}
+
+TEST_CASE("a Unix domain socket runs end to end") {
+  std::string path = (std::filesystem::temp_directory_path() /
+                      ("yaos_test_" + std::to_string(getpid()) + ".sock"))
+                         .string();
+  auto circuit = std::make_shared<const Circuit>(and_circuit());
+  auto networks = connect_pair(
+      [&]() { return std::make_shared<UnixNetworkDriverImpl>(path); });
+  CHECK(run_pair(circuit, {1}, {0}, nullptr, networks) == "0");
+}
+
+TEST_CASE("ring drivers fail calls after disconnect instead of crashing") {
+  std::vector<std::function<DriverPair()>> make_pairs = {
+      []() -> DriverPair { return InProcessNetworkDriverImpl::make_pair(); },
+      []() {
+        return connect_pair(
+            []() { return std::make_shared<ShmNetworkDriverImpl>(); });
+      }};
+  for (auto &make_pair : make_pairs) {
+    auto [closing, peer] = make_pair();
+    // A read blocked on another thread wakes and fails rather than touching
+    // a channel that is gone.
+    bool reader_threw = false;
+    std::thread reader([&, closing = closing]() {
+      try {
+        closing->read();
+      } catch (const std::exception &) {
+        reader_threw = true;
+      }
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    closing->disconnect();
+    reader.join();
+    CHECK(reader_threw);
+    CHECK_THROWS(closing->send({1}));
+    CHECK_THROWS(closing->read());
+    CHECK_THROWS(peer->read());
+  }
+}
+
+TEST_CASE("the emulated link delays messages by its latency") {
+  NetworkProfile profile = parse_network_profile("30,0");
+  CHECK(profile.latency_ms == 30);
+  auto [inner_sender, inner_receiver] =
+      InProcessNetworkDriverImpl::make_pair();
+  auto sender = std::make_shared<EmulatedNetworkDriver>(inner_sender, profile);
+  auto receiver =
+      std::make_shared<EmulatedNetworkDriver>(inner_receiver, profile);
+
+  auto start = std::chrono::steady_clock::now();
+  sender->send({9});
+  CHECK((receiver->read() == std::vector<unsigned char>{9}));
+  CHECK(std::chrono::steady_clock::now() - start >=
+        std::chrono::milliseconds(30));
+
+  auto circuit = std::make_shared<const Circuit>(and_circuit());
+  auto [garbler_inner, evaluator_inner] =
+      InProcessNetworkDriverImpl::make_pair();
+  NetworkProfile lan = parse_network_profile("1,1000");
+  DriverPair networks = {
+      std::make_shared<EmulatedNetworkDriver>(garbler_inner, lan),
+      std::make_shared<EmulatedNetworkDriver>(evaluator_inner, lan)};
+  CHECK(run_pair(circuit, {1}, {1}, nullptr, networks) == "1");
+}
+
+TEST_CASE("the garbler server serves evaluators one after another") {
+  auto circuit = std::make_shared<const Circuit>(and_circuit());
+  CHECK(GarblerServer::session_memory(*circuit) > 0);
+  CHECK_THROWS(GarblerServer(circuit, {1}, 2, 1));
+
+  // serve never returns, so the server lives until the test binary exits.
+  int port = free_port();
+  auto server = std::make_shared<GarblerServer>(circuit, std::vector<int>{1},
+                                                2, 0);
+  std::thread([server, port]() { server->serve(port); }).detach();
+  for (int b = 0; b < 2; b++) {
+    auto network_driver = connect_when_listening(
+        []() { return std::make_shared<NetworkDriverImpl>(); }, port);
+    EvaluatorClient evaluator(circuit, network_driver,
+                              std::make_shared<CryptoDriver>());
+    CHECK(evaluator.run({b}) == std::to_string(b));
+  }
+}
+
+TEST_CASE("the garbler server drops peers that stall") {
+  auto circuit = std::make_shared<const Circuit>(and_circuit());
+  int port = free_port();
+  auto server = std::make_shared<GarblerServer>(
+      circuit, std::vector<int>{1}, 1, 0, 0, 0,
+      std::chrono::milliseconds(200));
+  std::thread([server, port]() { server->serve(port); }).detach();
+
+  // The only session slot goes to a peer that connects and says nothing; the
+  // evaluator behind it is served once that session times out.
+  boost::asio::io_context io_context;
+  boost::asio::ip::tcp::socket stalled(io_context);
+  connect_raw(stalled, port);
+  auto network_driver = connect_when_listening(
+      []() { return std::make_shared<NetworkDriverImpl>(); }, port);
+  EvaluatorClient evaluator(circuit, network_driver,
+                            std::make_shared<CryptoDriver>());
+  CHECK(evaluator.run({1}) == "1");
+}
+
+TEST_CASE("a session evaluates several jobs over one handshake") {
+  auto circuit = std::make_shared<const Circuit>(and_circuit());
+  std::vector<EvaluationJob> garbler_jobs, evaluator_jobs;
+  for (int a = 0; a < 2; a++) {
+    for (int b = 0; b < 2; b++) {
+      garbler_jobs.push_back(EvaluationJob{"and", circuit, {a}});
+      evaluator_jobs.push_back(EvaluationJob{"and", circuit, {b}});
+    }
+  }
+
+  auto [garbler_network, evaluator_network] =
+      InProcessNetworkDriverImpl::make_pair();
+  GarblerClient garbler(circuit, garbler_network,
+                        std::make_shared<CryptoDriver>());
+  EvaluatorClient evaluator(circuit, evaluator_network,
+                            std::make_shared<CryptoDriver>());
+
+  std::vector<std::string> garbler_outputs;
+  std::thread garbler_thread(
+      [&]() { garbler_outputs = garbler.run_session(garbler_jobs); });
+  std::vector<std::string> evaluator_outputs =
+      evaluator.run_session(evaluator_jobs);
+  garbler_thread.join();
+
+  CHECK((garbler_outputs == std::vector<std::string>{"0", "0", "0", "1"}));
+  CHECK(evaluator_outputs == garbler_outputs);
+}
+
+TEST_CASE("a batch evaluates one circuit on many inputs") {
+  Circuit circuit = and_circuit();
+  std::vector<std::vector<int>> garbler_inputs, evaluator_inputs;
+  for (int i = 0; i < 4 * BATCH_PIPELINE_DEPTH; i++) {
+    garbler_inputs.push_back({i & 1});
+    evaluator_inputs.push_back({(i >> 1) & 1});
+  }
+
+  auto [garbler_network, evaluator_network] =
+      InProcessNetworkDriverImpl::make_pair();
+  GarblerClient garbler(circuit, garbler_network,
+                        std::make_shared<CryptoDriver>());
+  EvaluatorClient evaluator(circuit, evaluator_network,
+                            std::make_shared<CryptoDriver>());
+
+  std::vector<std::string> garbler_outputs;
+  std::thread garbler_thread(
+      [&]() { garbler_outputs = garbler.run_batch(garbler_inputs); });
+  std::vector<std::string> evaluator_outputs =
+      evaluator.run_batch(evaluator_inputs);
+  garbler_thread.join();
+
+  REQUIRE(evaluator_outputs.size() == garbler_inputs.size());
+  for (size_t i = 0; i < garbler_inputs.size(); i++) {
+    CHECK(evaluator_outputs[i] ==
+          std::to_string(garbler_inputs[i][0] & evaluator_inputs[i][0]));
+  }
+  CHECK(garbler_outputs == evaluator_outputs);
+}
+
+TEST_CASE("garblers share a pool of pregarbled circuits") {
+  auto circuit = std::make_shared<const Circuit>(and_circuit());
+  auto pool = std::make_shared<GarbledCircuitPool>(circuit, 2, 0, 2);
+  CHECK(pool->get_depth() == 2);
+
+  for (int a = 0; a < 2; a++) {
+    for (int b = 0; b < 2; b++) {
+      CHECK(run_pair(circuit, {a}, {b},
+                     [&](GarblerClient &garbler, EvaluatorClient &) {
+                       garbler.set_pool(pool);
+                     }) == std::to_string(a & b));
+    }
+  }
+
+  // Every take gets a fresh instance.
+  auto first = pool->take();
+  auto second = pool->take();
+  CHECK(first->labels.zeros[0].value != second->labels.zeros[0].value);
+}
+
+TEST_CASE("seed-derived labels evaluate like stored ones") {
+  auto circuit = std::make_shared<const Circuit>(and_circuit());
+  for (int a = 0; a < 2; a++) {
+    for (int b = 0; b < 2; b++) {
+      CHECK(run_pair(circuit, {a}, {b},
+                     [](GarblerClient &garbler, EvaluatorClient &) {
+                       garbler.set_seeded_labels(true);
+                     }) == std::to_string(a & b));
+    }
+  }
+}
+
+TEST_CASE("PRG derivation is deterministic and the thread RNG is not") {
+  CryptoPP::SecByteBlock seed = PRG::generate_seed();
+  CHECK(PRG(seed).derive(7, LABEL_LENGTH) == PRG(seed).derive(7, LABEL_LENGTH));
+  CHECK(PRG(seed).derive(7, LABEL_LENGTH) != PRG(seed).derive(8, LABEL_LENGTH));
+
+  CryptoPP::SecByteBlock a(LABEL_LENGTH), b(LABEL_LENGTH);
+  ThreadRNG::get().GenerateBlock(a, a.size());
+  ThreadRNG::get().GenerateBlock(b, b.size());
+  CHECK(a != b);
+}
+
+// A fresh directory under the system's temporary directory, removed with
+// everything in it when this goes out of scope.
+struct TempDir {
+  std::string path;
+
+  TempDir() {
+    std::string name =
+        (std::filesystem::temp_directory_path() / "yaos_test_XXXXXX").string();
+    REQUIRE(mkdtemp(name.data()) != nullptr);
+    this->path = name;
+  }
+  ~TempDir() { std::filesystem::remove_all(this->path); }
+};
+
+// A chain of `length` AND gates: out = a AND b AND b AND ...
+Circuit and_chain_circuit(int length) {
+  Circuit circuit;
+  circuit.num_gate = length;
+  circuit.num_wire = length + 2;
+  circuit.garbler_input_length = 1;
+  circuit.evaluator_input_length = 1;
+  circuit.output_length = 1;
+  circuit.gates.push_back(Gate{GateType::AND_GATE, 0, 1, 2});
+  for (int i = 1; i < length; i++) {
+    circuit.gates.push_back(Gate{GateType::AND_GATE, i + 1, 1, i + 2});
+  }
+  return circuit;
+}
+
+TEST_CASE("garbled tables spilled to disk evaluate like in-memory ones") {
+  TempDir spill_dir;
+  auto spill = [&](GarblerClient &garbler, EvaluatorClient &evaluator) {
+    garbler.set_spill_dir(spill_dir.path);
+    evaluator.set_spill_dir(spill_dir.path);
+  };
+  auto circuit = std::make_shared<const Circuit>(and_circuit());
+  for (int a = 0; a < 2; a++) {
+    for (int b = 0; b < 2; b++) {
+      CHECK(run_pair(circuit, {a}, {b}, spill) == std::to_string(a & b));
+    }
+  }
+
+  auto adder = std::make_shared<const Circuit>(
+      parse_circuit(std::string(CIRCUITS_DIR) + "/adder.txt"));
+  std::vector<int> x, y;
+  for (int i = 0; i < adder->garbler_input_length; i++) {
+    x.push_back(random_bit());
+  }
+  for (int i = 0; i < adder->evaluator_input_length; i++) {
+    y.push_back(random_bit());
+  }
+  CHECK(run_pair(adder, x, y, spill) == run_pair(adder, x, y));
+
+  // Enough tables to flush the write buffer and fill several chunks.
+  int length = 2 * TABLE_CHUNK_SIZE / (3 * LABEL_LENGTH);
+  auto chain = std::make_shared<const Circuit>(and_chain_circuit(length));
+  CHECK(TABLE_CHUNK_SIZE > TABLE_STORE_BUFFER_SIZE);
+  CHECK(count_table_entries<Grr3Scheme<LABEL_LENGTH>>(*chain) *
+            LABEL_LENGTH >
+        TABLE_CHUNK_SIZE);
+  CHECK(run_pair(chain, {1}, {1}, spill) == "1");
+  CHECK(run_pair(chain, {1}, {0}, spill) == "0");
+}
+
+TEST_CASE("spilling on only one side is an error, not a crash") {
+  TempDir spill_dir;
+  auto circuit = std::make_shared<const Circuit>(and_circuit());
+  for (bool garbler_spills : {false, true}) {
+    auto [garbler_network, evaluator_network] =
+        InProcessNetworkDriverImpl::make_pair();
+    GarblerClient garbler(circuit, garbler_network,
+                          std::make_shared<CryptoDriver>());
+    EvaluatorClient evaluator(circuit, evaluator_network,
+                              std::make_shared<CryptoDriver>());
+    if (garbler_spills) {
+      garbler.set_spill_dir(spill_dir.path);
+    } else {
+      evaluator.set_spill_dir(spill_dir.path);
+    }
+
+    std::thread garbler_thread([&]() { CHECK_THROWS(garbler.run({1})); });
+    CHECK_THROWS(evaluator.run({1}));
+    garbler_thread.join();
+  }
+}
+
+// out = NOT(a AND b) XOR a
+Circuit nand_xor_circuit() {
+  Circuit circuit;
+  circuit.num_gate = 3;
+  circuit.num_wire = 5;
+  circuit.garbler_input_length = 1;
+  circuit.evaluator_input_length = 1;
+  circuit.output_length = 1;
+  circuit.gates.push_back(Gate{GateType::AND_GATE, 0, 1, 2});
+  circuit.gates.push_back(Gate{GateType::NOT_GATE, 2, 0, 3});
+  circuit.gates.push_back(Gate{GateType::XOR_GATE, 3, 0, 4});
+  return circuit;
+}
+
+TEST_CASE("seed-derived labels evaluate multi-gate circuits") {
+  // NOT(a AND b) XOR a: wire 2 dies after the NOT while wire 0 lives on.
+  auto nand_xor = std::make_shared<const Circuit>(nand_xor_circuit());
+  for (int a = 0; a < 2; a++) {
+    for (int b = 0; b < 2; b++) {
+      CHECK(run_pair(nand_xor, {a}, {b},
+                     [](GarblerClient &garbler, EvaluatorClient &) {
+                       garbler.set_seeded_labels(true);
+                     }) == std::to_string((1 - (a & b)) ^ a));
+    }
+  }
+
+  auto adder = std::make_shared<const Circuit>(
+      parse_circuit(std::string(CIRCUITS_DIR) + "/adder.txt"));
+  for (int round = 0; round < 3; round++) {
+    std::vector<int> x, y;
+    for (int i = 0; i < adder->garbler_input_length; i++) {
+      x.push_back(random_bit());
+    }
+    for (int i = 0; i < adder->evaluator_input_length; i++) {
+      y.push_back(random_bit());
+    }
+    CHECK(run_pair(adder, x, y,
+                   [](GarblerClient &garbler, EvaluatorClient &) {
+                     garbler.set_seeded_labels(true);
+                   }) == run_pair(adder, x, y));
+  }
+}
+
+// Pick each input wire's label for `input` from labels kept in full.
+std::vector<GarbledWire> pick_labels(const GarbledLabels &labels,
+                                     const std::vector<int> &input, int begin) {
+  std::vector<GarbledWire> picked;
+  for (int i = 0; i < input.size(); i++) {
+    picked.push_back(input[i] ? labels.ones.at(begin + i)
+                              : labels.zeros.at(begin + i));
+  }
+  return picked;
+}
+
+TEST_CASE("generated kernels interoperate with the interpreter") {
+  // test/CMakeLists.txt links in the kernel yaos_codegen generates for it.
+  auto adder = std::make_shared<const Circuit>(
+      parse_circuit(std::string(CIRCUITS_DIR) + "/adder.txt"));
+  const CircuitKernel *kernel = find_circuit_kernel(*adder);
+  REQUIRE(kernel != nullptr);
+  CHECK(std::string(kernel->name) == "adder");
+
+  auto seeded = [](GarblerClient &garbler, EvaluatorClient &) {
+    garbler.set_seeded_labels(true);
+  };
+  CHECK(run_pair(adder, std::vector<int>(adder->garbler_input_length, 0),
+                 std::vector<int>(adder->evaluator_input_length, 0)) ==
+        std::string(adder->output_length, '0'));
+  for (int round = 0; round < 3; round++) {
+    std::vector<int> x, y;
+    for (int i = 0; i < adder->garbler_input_length; i++) {
+      x.push_back(random_bit());
+    }
+    for (int i = 0; i < adder->evaluator_input_length; i++) {
+      y.push_back(random_bit());
+    }
+    // Kernels on both sides, an interpreting (seeded) garbler, and
+    // interpreters on both sides.
+    std::string output = run_pair(adder, x, y);
+    CHECK(run_pair(adder, x, y, seeded) == output);
+    CHECK(run_pair(adder, x, y, use_scheme(SchemeType::HALF_GATES)) == output);
+  }
+}
+
+TEST_CASE("kernel tables are sent packed, like per-gate tables") {
+  Circuit adder = parse_circuit(std::string(CIRCUITS_DIR) + "/adder.txt");
+  const CircuitKernel *kernel = find_circuit_kernel(adder);
+  REQUIRE(kernel != nullptr);
+  GarbledInstance instance = garble_with_kernel(*kernel, adder);
+  const PackedTables &packed = instance.packed_tables;
+  CHECK(instance.tables.empty());
+  REQUIRE(packed.sizes.size() == adder.num_gate);
+  REQUIRE(packed.entries.size() ==
+          kernel->num_table_entries * packed.entry_length);
+
+  GarblerToEvaluator_GarbledTables_Message packed_message, gate_message;
+  packed_message.packed_tables = packed;
+  const unsigned char *entry = packed.entries.data();
+  for (size_t size : packed.sizes) {
+    GarbledGate gate;
+    for (size_t j = 0; j < size; j++) {
+      gate.entries.emplace_back(entry, packed.entry_length);
+      entry += packed.entry_length;
+    }
+    gate_message.garbled_tables.push_back(gate);
+  }
+  std::vector<unsigned char> packed_data, gate_data;
+  packed_message.serialize(packed_data);
+  gate_message.serialize(gate_data);
+  CHECK(packed_data == gate_data);
+
+  // The kernel and the interpreter evaluate the received tables alike.
+  GarblerToEvaluator_GarbledTables_Message received;
+  received.deserialize(packed_data);
+  std::vector<int> x(adder.garbler_input_length, 1);
+  std::vector<int> y(adder.evaluator_input_length, 0);
+  auto garbler_inputs = pick_labels(instance.labels, x, 0);
+  auto evaluator_inputs =
+      pick_labels(instance.labels, y, adder.garbler_input_length);
+  auto kernel_outputs =
+      evaluate_with_kernel(*kernel, adder, received.garbled_tables,
+                           garbler_inputs, evaluator_inputs);
+  auto outputs =
+      evaluate_with_scheme(SchemeType::GRR3, adder, received.garbled_tables,
+                           garbler_inputs, evaluator_inputs);
+  REQUIRE(outputs.size() == adder.output_length);
+  for (int i = 0; i < adder.output_length; i++) {
+    CHECK(outputs[i].value == kernel_outputs[i].value);
+  }
+}
+
+TEST_CASE("kernels are found only while registered and for their shape") {
+  Circuit circuit = nand_xor_circuit();
+  CircuitKernel kernel_def = {"nand_xor", circuit_fingerprint(circuit),
+                              circuit.num_gate, circuit.num_wire,
+                              4, nullptr, nullptr};
+  CircuitKernel wrong_size = kernel_def;
+  wrong_size.num_table_entries = 3;
+  REQUIRE(find_circuit_kernel(circuit) == nullptr);
+  {
+    CircuitKernelRegistration registration(&kernel_def);
+    CHECK(find_circuit_kernel(circuit) == &kernel_def);
+    {
+      CircuitKernelRegistration shadowing(&wrong_size);
+      CHECK(find_circuit_kernel(circuit) == nullptr);
+    }
+    CHECK(find_circuit_kernel(circuit) == &kernel_def);
+  }
+  CHECK(find_circuit_kernel(circuit) == nullptr);
+}
+
+TEST_CASE("half gates evaluate like GRR3") {
+  auto circuit = std::make_shared<const Circuit>(nand_xor_circuit());
+  for (bool seeded : {false, true}) {
+    for (int a = 0; a < 2; a++) {
+      for (int b = 0; b < 2; b++) {
+        CHECK(run_pair(circuit, {a}, {b},
+                       [&](GarblerClient &garbler, EvaluatorClient &evaluator) {
+                         garbler.set_seeded_labels(seeded);
+                         garbler.set_scheme(SchemeType::HALF_GATES);
+                         evaluator.set_scheme(SchemeType::HALF_GATES);
+                       }) == std::to_string((1 - (a & b)) ^ a));
+      }
+    }
+  }
+}
+
+// Garble nand_xor_circuit under S, evaluate it on (a, b) and decode.
+template <GarblingScheme S> int run_scheme(int a, int b) {
+  using Label = typename S::Label;
+  Circuit circuit = nand_xor_circuit();
+  auto ctx = S::random_context();
+  std::vector<Label> wires(circuit.num_wire);
+  wires[0] = S::random_label();
+  wires[1] = S::random_label();
+  std::vector<typename S::Entry> tables(count_table_entries<S>(circuit));
+  garble_gates<S>(circuit, ctx, wires.data(), tables.data());
+
+  std::vector<Label> evaluated(circuit.num_wire);
+  evaluated[0] = a ? block::xor_blocks(wires[0], ctx.delta) : wires[0];
+  evaluated[1] = b ? block::xor_blocks(wires[1], ctx.delta) : wires[1];
+  auto evaluator_ctx = make_scheme_context<S::width>();
+  evaluate_gates<S>(circuit, evaluator_ctx, evaluated.data(), tables.data());
+
+  Label out = evaluated[4];
+  Label one = block::xor_blocks(wires[4], ctx.delta);
+  if (std::memcmp(out.bytes, wires[4].bytes, S::width) == 0) {
+    return 0;
+  }
+  return std::memcmp(out.bytes, one.bytes, S::width) == 0 ? 1 : -1;
+}
+
+TEST_CASE("every garbling scheme evaluates correctly at any label width") {
+  for (int a = 0; a < 2; a++) {
+    for (int b = 0; b < 2; b++) {
+      int expected = (1 - (a & b)) ^ a;
+      CHECK(run_scheme<ClassicScheme<16>>(a, b) == expected);
+      CHECK(run_scheme<Grr3Scheme<16>>(a, b) == expected);
+      CHECK(run_scheme<HalfGatesScheme<16>>(a, b) == expected);
+      CHECK(run_scheme<HalfGatesScheme<LABEL_LENGTH>>(a, b) == expected);
+      CHECK(run_scheme<ThreeHalvesScheme<16>>(a, b) == expected);
+      CHECK(run_scheme<ThreeHalvesScheme<LABEL_LENGTH>>(a, b) == expected);
+    }
+  }
+}
+
+TEST_CASE("three halves sends 1.5 labels and a byte per AND") {
+  using ThreeHalves = ThreeHalvesScheme<LABEL_LENGTH>;
+  using HalfGates = HalfGatesScheme<LABEL_LENGTH>;
+  Circuit circuit = nand_xor_circuit();
+  CHECK(count_table_entries<ThreeHalves>(circuit) == 1);
+  CHECK(table_entry_length(SchemeType::THREE_HALVES) ==
+        3 * LABEL_LENGTH / 2 + 1);
+  CHECK(count_table_entries<HalfGates>(circuit) *
+            table_entry_length(SchemeType::HALF_GATES) ==
+        2 * LABEL_LENGTH);
+
+  GarbledInstance instance =
+      garble_with_scheme(SchemeType::THREE_HALVES, circuit);
+  size_t sent = 0;
+  for (auto &table : instance.tables) {
+    for (auto &entry : table.entries) {
+      sent += entry.size();
+    }
+  }
+  CHECK(sent == 3 * LABEL_LENGTH / 2 + 1);
+}
+
+TEST_CASE("instances garble and evaluate at any label width") {
+  using S = Grr3Scheme<16>;
+  Circuit circuit = nand_xor_circuit();
+  TempDir spill_dir;
+  for (int a = 0; a < 2; a++) {
+    for (int b = 0; b < 2; b++) {
+      int expected = (1 - (a & b)) ^ a;
+      GarbledInstance instance =
+          garble_instance<S>(circuit, [&](auto &ctx, auto *wires, auto *tables) {
+            garble_gates<S>(circuit, ctx, wires, tables);
+          });
+      REQUIRE(instance.labels.zeros[0].value.size() == 16);
+      auto outputs = evaluate_instance<S>(
+          circuit, instance.tables, pick_labels(instance.labels, {a}, 0),
+          pick_labels(instance.labels, {b}, 1),
+          [&](auto &ctx, auto *wires, auto *tables) {
+            evaluate_gates<S>(circuit, ctx, wires, tables);
+          });
+      CHECK(outputs[0].value ==
+            pick_labels(instance.labels, {expected}, 4)[0].value);
+
+      auto tables = std::make_shared<TableStore>(spill_dir.path, 16);
+      instance = garble_spilled_instance<S>(circuit, tables);
+      tables->finish();
+      outputs = evaluate_spilled_instance<S>(
+          circuit, *tables, pick_labels(instance.labels, {a}, 0),
+          pick_labels(instance.labels, {b}, 1));
+      CHECK(outputs[0].value ==
+            pick_labels(instance.labels, {expected}, 4)[0].value);
+    }
+  }
+
+  // Protocol-width tables don't evaluate as 16-byte ones.
+  auto tables = std::make_shared<TableStore>(
+      spill_dir.path, table_entry_length(SchemeType::GRR3));
+  garble_spilled_instance<Grr3Scheme<LABEL_LENGTH>>(circuit, tables);
+  tables->finish();
+  CHECK_THROWS(evaluate_spilled_instance<S>(circuit, *tables, {}, {}));
+}
+
+// out = MAJ(a, b, c): a row per input combination, a least significant.
+Circuit majority_circuit() {
+  Circuit circuit;
+  circuit.num_gate = 1;
+  circuit.num_wire = 4;
+  circuit.garbler_input_length = 1;
+  circuit.evaluator_input_length = 2;
+  circuit.output_length = 1;
+  circuit.lookup_tables.push_back(LookupTable{{0, 1, 2}, 0xe8});
+  circuit.gates.push_back(Gate{GateType::LUT_GATE, 0, 0, 3});
+  return circuit;
+}
+
+TEST_CASE("every scheme garbles with seeded labels and spilled tables") {
+  TempDir spill_dir;
+  auto nand_xor = std::make_shared<const Circuit>(nand_xor_circuit());
+  auto majority = std::make_shared<const Circuit>(majority_circuit());
+  for (auto scheme : {SchemeType::GRR3, SchemeType::HALF_GATES,
+                      SchemeType::CLASSIC, SchemeType::THREE_HALVES}) {
+    for (int mode = 0; mode < 4; mode++) {
+      bool seeded = mode & 1;
+      bool spilled = mode & 2;
+      auto configure = [&](GarblerClient &garbler, EvaluatorClient &evaluator) {
+        use_scheme(scheme)(garbler, evaluator);
+        garbler.set_seeded_labels(seeded);
+        if (spilled) {
+          garbler.set_spill_dir(spill_dir.path);
+          evaluator.set_spill_dir(spill_dir.path);
+        }
+      };
+      for (int a = 0; a < 2; a++) {
+        for (int b = 0; b < 2; b++) {
+          CHECK(run_pair(nand_xor, {a}, {b}, configure) ==
+                std::to_string((1 - (a & b)) ^ a));
+          CHECK(run_pair(majority, {a}, {b, 1}, configure) ==
+                std::to_string(a | b));
+        }
+      }
+    }
+  }
+}
+
+TEST_CASE("lookup table gates parse from circuit files") {
+  Circuit circuit = parse_circuit(std::string(CIRCUITS_DIR) + "/majority.txt");
+  REQUIRE(circuit.lookup_tables.size() == 1);
+  CHECK(circuit.lookup_tables[0].inputs == std::vector<int>({0, 1, 2}));
+  CHECK(circuit.lookup_tables[0].truth_table == 0xe8);
+  CHECK(circuit_fingerprint(circuit) == circuit_fingerprint(majority_circuit()));
+
+  // Two outputs, too many inputs, no truth table, a cut-off gate.
+  TempDir dir;
+  for (std::string gate : {"3 2 0 1 2 3 LUT e8", "7 1 0 1 2 0 1 2 0 3 LUT e8",
+                           "3 1 0 1 2 3 LUT", "3 1 0 1"}) {
+    std::string path = dir.path + "/bad.txt";
+    std::ofstream(path) << "1 4\n1 2 1\n\n" << gate << "\n";
+    CHECK_THROWS(parse_circuit(path));
+  }
+}
+
+TEST_CASE("generated kernels garble lookup table gates") {
+  // test/CMakeLists.txt generates this kernel from circuits/majority.txt.
+  auto majority = std::make_shared<const Circuit>(
+      parse_circuit(std::string(CIRCUITS_DIR) + "/majority.txt"));
+  const CircuitKernel *kernel = find_circuit_kernel(*majority);
+  REQUIRE(kernel != nullptr);
+  CHECK(std::string(kernel->name) == "majority");
+  CHECK(kernel->num_table_entries == 7);
+
+  auto seeded = [](GarblerClient &garbler, EvaluatorClient &) {
+    garbler.set_seeded_labels(true);
+  };
+  for (int a = 0; a < 2; a++) {
+    for (int b = 0; b < 2; b++) {
+      for (int c = 0; c < 2; c++) {
+        std::string expected = std::to_string(a + b + c >= 2);
+        CHECK(run_pair(majority, {a}, {b, c}) == expected);
+        CHECK(run_pair(majority, {a}, {b, c}, seeded) == expected);
+      }
+    }
+  }
+}
+
+// out = c ? NOT(a XOR b) : a AND b, as one branch on the evaluator's c.
+Circuit branch_circuit() {
+  Circuit and_branch;
+  and_branch.num_gate = 1;
+  and_branch.num_wire = 3;
+  and_branch.garbler_input_length = 2;
+  and_branch.evaluator_input_length = 0;
+  and_branch.output_length = 1;
+  and_branch.gates.push_back(Gate{GateType::AND_GATE, 0, 1, 2});
+
+  Circuit xnor_branch;
+  xnor_branch.num_gate = 2;
+  xnor_branch.num_wire = 4;
+  xnor_branch.garbler_input_length = 2;
+  xnor_branch.evaluator_input_length = 0;
+  xnor_branch.output_length = 1;
+  xnor_branch.gates.push_back(Gate{GateType::XOR_GATE, 0, 1, 2});
+  xnor_branch.gates.push_back(Gate{GateType::NOT_GATE, 2, 0, 3});
+
+  Circuit circuit;
+  circuit.num_gate = 1;
+  circuit.num_wire = 4;
+  circuit.garbler_input_length = 1;
+  circuit.evaluator_input_length = 2;
+  circuit.output_length = 1;
+  circuit.branches.push_back(
+      Branch{{1}, {0, 2}, {3}, {and_branch, xnor_branch}});
+  circuit.gates.push_back(Gate{GateType::BRANCH_GATE, 0, 0, 0});
+  return circuit;
+}
+
+TEST_CASE("stacked branches evaluate the selected sub-circuit") {
+  auto circuit = std::make_shared<const Circuit>(branch_circuit());
+  for (auto scheme : {SchemeType::GRR3, SchemeType::HALF_GATES}) {
+    for (int a = 0; a < 2; a++) {
+      for (int b = 0; b < 2; b++) {
+        for (int c = 0; c < 2; c++) {
+          int expected = c ? 1 - (a ^ b) : a & b;
+          CHECK(run_pair(circuit, {a}, {c, b}, use_scheme(scheme)) ==
+                std::to_string(expected));
+        }
+      }
+    }
+  }
+  // Seeds and keys don't fit three halves' table entries.
+  CHECK_THROWS(garble_with_scheme(SchemeType::THREE_HALVES, *circuit));
+}
+
+TEST_CASE("stacked branches send the largest alternative's tables") {
+  Circuit circuit = branch_circuit();
+  const Branch &branch = circuit.branches[0];
+  // Under GRR3 the AND alternative takes 3 entries, the XNOR one 1.
+  size_t largest = 3;
+  CHECK(count_table_entries<Grr3Scheme<LABEL_LENGTH>>(branch.circuits[0]) ==
+        largest);
+  CHECK(count_table_entries<Grr3Scheme<LABEL_LENGTH>>(branch.circuits[1]) ==
+        1);
+  auto layout = stacking::layout<Grr3Scheme<LABEL_LENGTH>>(branch);
+  CHECK(layout.size - layout.material == largest);
+
+  GarbledInstance instance = garble_with_scheme(SchemeType::GRR3, circuit);
+  REQUIRE(instance.tables.size() == 1);
+  CHECK(instance.tables[0].entries.size() == layout.size);
+  CHECK(instance.tables[0].entries.size() ==
+        branch_table_size<Grr3Scheme<LABEL_LENGTH>>(branch));
+}
+
+TEST_CASE("branches parse from circuit files and bad ones are rejected") {
+  std::string header = "1 4\n1 2 1\n\n";
+  std::string and_branch = "1 3\n2 0 1\n\n2 1 0 1 2 AND\n";
+  std::string xnor_branch = "2 4\n2 0 1\n\n2 1 0 1 2 XOR\n1 1 2 3 INV\n";
+  TempDir dir;
+  std::string path = dir.path + "/branch.txt";
+  std::ofstream(path) << header << "BRANCH 2 1 1 2 0 2 1 3\n"
+                      << and_branch << xnor_branch;
+  CHECK(circuit_fingerprint(parse_circuit(path)) ==
+        circuit_fingerprint(branch_circuit()));
+
+  // A cut-off branch line, a sub-circuit gate past its wires, a sub-circuit
+  // too small for its inputs and outputs, an absurd wire list.
+  for (std::string body : std::vector<std::string>{
+           "BRANCH 2 1 1 2 0\n",
+           "BRANCH 2 1 1 2 0 2 1 3\n1 3\n2 0 1\n\n2 1 0 1 7 AND\n" + xnor_branch,
+           "BRANCH 2 1 1 2 0 2 1 3\n1 2\n2 0 1\n\n2 1 0 1 2 AND\n" + xnor_branch,
+           "BRANCH 2 1 1 1000000000 0\n"}) {
+    std::ofstream(path) << header << body;
+    CHECK_THROWS(parse_circuit(path));
+  }
+}
+
+TEST_CASE("lookup table gates garble as one table in every scheme") {
+  Circuit circuit = majority_circuit();
+  CHECK(count_table_entries<Grr3Scheme<LABEL_LENGTH>>(circuit) == 7);
+  CHECK(count_table_entries<ClassicScheme<LABEL_LENGTH>>(circuit) == 8);
+  // Three halves packs the 7 rows into entries of 1.5 labels and a byte.
+  CHECK(count_table_entries<ThreeHalvesScheme<LABEL_LENGTH>>(circuit) ==
+        (7 * LABEL_LENGTH + 3 * LABEL_LENGTH / 2) / (3 * LABEL_LENGTH / 2 + 1));
+  auto shared_circuit = std::make_shared<const Circuit>(circuit);
+
+  for (auto scheme : {SchemeType::GRR3, SchemeType::HALF_GATES,
+                      SchemeType::CLASSIC, SchemeType::THREE_HALVES}) {
+    for (int a = 0; a < 2; a++) {
+      for (int b = 0; b < 2; b++) {
+        for (int c = 0; c < 2; c++) {
+          int expected = a + b + c >= 2;
+          CHECK(run_pair(shared_circuit, {a}, {b, c}, use_scheme(scheme)) ==
+                std::to_string(expected));
+        }
+      }
+    }
+  }
+}